@@ -0,0 +1,159 @@
+#ifndef BENCH_H
+#define	BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// small throughput harness shared by the benchmark translation units
+// every operation is timed over a buffer sized for one cache level, repeated
+// until a minimum run time is reached, and the best of several rounds is kept
+
+/*****************************************************/
+/*                 Optimizer Barriers                */
+/*****************************************************/
+// keeps the compiler from discarding a computed value
+template <class T>
+inline void doNotOptimize(const T& v)
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(v) : "memory");
+#else
+    static volatile const T* sink;
+    sink = &v;
+#endif
+}
+
+// forces memory written so far to be treated as observed
+inline void clobberMemory()
+{
+#if defined(__GNUC__)
+    asm volatile("" : : : "memory");
+#endif
+}
+
+/*****************************************************/
+/*                   Bench Types                     */
+/*****************************************************/
+// working-set sizes, one per level of the memory hierarchy
+struct BenchLevel
+{
+    const char* name;
+    size_t bytes;
+};
+
+struct BenchResult
+{
+    std::string impl; // implementation under test, e.g. "Vector3<float,int>"
+    std::string op; // operation name
+    std::string level; // L1, L2, L3 or DRAM
+    size_t elements; // elements processed per pass
+    size_t workingSet; // bytes touched per pass
+    double nsPerOp; // nanoseconds per element
+    double gbPerSec; // bytes read and written per second, in GB/s
+};
+
+class BenchSuite
+{
+private:
+    std::vector<BenchResult> results;
+    double minSeconds; // minimum time per round
+    int rounds; // rounds per measurement (best is kept)
+
+public:
+    inline BenchSuite(double minSeconds = 0.05, int rounds = 3):
+    minSeconds(minSeconds), rounds(rounds)
+    {
+    }
+
+    // times pass() (which processes n elements once) and records ns per element
+    // and the bandwidth implied by bytesPerOp bytes read and written per element
+    template <class Pass>
+    inline void time(const std::string& impl, const std::string& op, const BenchLevel& level,
+                     size_t n, size_t bytesPerOp, Pass pass)
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        // warm up and find how many passes fill one round
+        pass();
+        size_t passes = 1;
+        for(;;)
+        {
+            Clock::time_point t0 = Clock::now();
+            for(size_t p = 0; p < passes; ++p)
+                pass();
+            clobberMemory();
+            double s = std::chrono::duration<double>(Clock::now() - t0).count();
+            if(s >= minSeconds / 4 || passes >= (size_t(1) << 30))
+                break;
+            passes *= 2;
+        }
+
+        double best = 1e300;
+        for(int r = 0; r < rounds; ++r)
+        {
+            size_t done = 0;
+            Clock::time_point t0 = Clock::now();
+            double s = 0;
+            do
+            {
+                for(size_t p = 0; p < passes; ++p)
+                    pass();
+                clobberMemory();
+                done += passes;
+                s = std::chrono::duration<double>(Clock::now() - t0).count();
+            } while(s < minSeconds);
+            best = std::min(best, s / double(done));
+        }
+
+        BenchResult res;
+        res.impl = impl;
+        res.op = op;
+        res.level = level.name;
+        res.elements = n;
+        res.workingSet = n * bytesPerOp;
+        res.nsPerOp = best * 1e9 / double(n);
+        res.gbPerSec = double(n * bytesPerOp) / best / 1e9;
+        results.push_back(res);
+        std::fprintf(stderr, "%-22s %-18s %-4s %10.3f ns/op %8.2f GB/s\n",
+                     impl.c_str(), op.c_str(), level.name, res.nsPerOp, res.gbPerSec);
+    }
+
+    inline const std::vector<BenchResult>& getResults() const
+    {
+        return results;
+    }
+
+    // writes all results as a JSON document
+    inline void writeJSON(FILE* out, const char* name, int floatLanes, int doubleLanes) const
+    {
+        std::fprintf(out, "{\n  \"benchmark\": \"%s\",\n  \"format_version\": 1,\n", name);
+        std::fprintf(out, "  \"simd\": {\"float_lanes\": %d, \"double_lanes\": %d},\n", floatLanes, doubleLanes);
+        std::fprintf(out, "  \"results\": [\n");
+        for(size_t i = 0; i < results.size(); ++i)
+        {
+            const BenchResult& r = results[i];
+            std::fprintf(out, "    {\"impl\": \"%s\", \"op\": \"%s\", \"level\": \"%s\", "
+                              "\"elements\": %zu, \"working_set_bytes\": %zu, "
+                              "\"ns_per_op\": %.4f, \"gb_per_s\": %.4f}%s\n",
+                         r.impl.c_str(), r.op.c_str(), r.level.c_str(),
+                         r.elements, r.workingSet, r.nsPerOp, r.gbPerSec,
+                         i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+};
+
+// per-suite entry points (one translation unit per Vector3 implementation,
+// since both are named Vector3 and cannot share a translation unit)
+void benchTemplateVector3(BenchSuite& suite, const std::vector<BenchLevel>& levels);
+void benchDoubleVector3(BenchSuite& suite, const std::vector<BenchLevel>& levels);
+
+// writes the max ulp and relative error of each precision policy as JSON
+void benchAccuracy(FILE* out, size_t samples);
+
+#endif	/* BENCH_H */
+
@@ -0,0 +1,151 @@
+//
+//  BenchAccuracy.cpp
+//  error of the Exact, Fast and Approx policies (see math/Precision.h) for
+//  normalize, mag and angle, measured against long double references
+//
+
+#include "Bench.h"
+#include "math/Vector3.h"
+#include "math/Vector3Array.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// xorshift64 so every run measures the same inputs
+static uint64_t accuracyState = 0x9e3779b97f4a7c15ull;
+
+static double uniform()
+{
+    accuracyState ^= accuracyState << 13;
+    accuracyState ^= accuracyState >> 7;
+    accuracyState ^= accuracyState << 17;
+    return double(accuracyState >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// components in [-1, 1] scaled by 10^e with e uniform in [-range, range],
+// so the magnitudes cover the range the policies promise to handle
+template <class T>
+static Vector3<T> randomVector(double range)
+{
+    double s = std::pow(10.0, (2*uniform() - 1) * range);
+    return Vector3<T>(T((2*uniform() - 1) * s), T((2*uniform() - 1) * s), T((2*uniform() - 1) * s));
+}
+
+// size of one unit in the last place at x
+template <class T>
+static long double ulp(long double x)
+{
+    int e;
+    std::frexp(double(x), &e);
+    return std::ldexp((long double)1, e - std::numeric_limits<T>::digits);
+}
+
+struct AccuracyError
+{
+    long double maxUlp;
+    long double maxRel;
+    long double maxAbs;
+
+    AccuracyError() : maxUlp(0), maxRel(0), maxAbs(0) {}
+
+    inline void add(long double got, long double ref, long double unit)
+    {
+        long double err = std::fabs(got - ref);
+        if(err / unit > maxUlp)
+            maxUlp = err / unit;
+        if(err > maxAbs)
+            maxAbs = err;
+        if(ref != 0 && err / std::fabs(ref) > maxRel)
+            maxRel = err / std::fabs(ref);
+    }
+};
+
+struct AccuracyRow
+{
+    const char* type;
+    const char* policy;
+    AccuracyError mag, normalize, normalizeBatch, angle;
+};
+
+template <class T, class P>
+static AccuracyRow measure(const char* type, const char* policy, size_t n, double range)
+{
+    AccuracyRow row;
+    row.type = type;
+    row.policy = policy;
+
+    Vector3Array<T> batch(n);
+    std::vector<Vector3<T> > vs(n);
+    for(size_t i = 0; i < n; ++i)
+    {
+        vs[i] = randomVector<T>(range);
+        batch.set(i, vs[i]);
+    }
+    batch.template normalize<P>();
+
+    for(size_t i = 0; i < n; ++i)
+    {
+        const Vector3<T>& a = vs[i];
+        const Vector3<T>& b = vs[(i + 1) % n];
+        long double ax = a.getX(), ay = a.getY(), az = a.getZ();
+        long double bx = b.getX(), by = b.getY(), bz = b.getZ();
+        long double am = std::sqrt(ax*ax + ay*ay + az*az);
+        long double bm = std::sqrt(bx*bx + by*by + bz*bz);
+
+        row.mag.add(a.template mag<P>(), am, ulp<T>(am));
+
+        // normalized components are measured in ulps of 1, the result's magnitude
+        Vector3<T> u = a;
+        u.template normalize<P>();
+        Vector3<T> w = batch.get(i);
+        long double one = ulp<T>(1);
+        row.normalize.add(u.getX(), ax / am, one);
+        row.normalize.add(u.getY(), ay / am, one);
+        row.normalize.add(u.getZ(), az / am, one);
+        row.normalizeBatch.add(w.getX(), ax / am, one);
+        row.normalizeBatch.add(w.getY(), ay / am, one);
+        row.normalizeBatch.add(w.getZ(), az / am, one);
+
+        // angles are measured in ulps of pi, the largest result; near 0 and pi
+        // acos is ill-conditioned, so max_abs is the figure to compare there
+        long double c = (ax*bx + ay*by + az*bz) / (am*bm);
+        c = c > 1 ? 1 : (c < -1 ? -1 : c);
+        long double ang = std::acos(c);
+        row.angle.add(a.template angle<P>(b), ang, ulp<T>(3.14159265358979323846L));
+    }
+    return row;
+}
+
+static void writeError(FILE* out, const char* name, const AccuracyError& e, bool last)
+{
+    std::fprintf(out, "\"%s\": {\"max_ulp\": %.2Lf, \"max_rel\": %.3Le, \"max_abs\": %.3Le}%s",
+                 name, e.maxUlp, e.maxRel, e.maxAbs, last ? "" : ", ");
+}
+
+void benchAccuracy(FILE* out, size_t n)
+{
+    // |v|^2 stays within about 1e-30 .. 1e30 for both types: the double
+    // Fast/Approx paths take their estimate through float (see Precision.h)
+    std::vector<AccuracyRow> rows;
+    rows.push_back(measure<float, Exact>("float", "Exact", n, 15));
+    rows.push_back(measure<float, Fast>("float", "Fast", n, 15));
+    rows.push_back(measure<float, Approx>("float", "Approx", n, 15));
+    rows.push_back(measure<double, Exact>("double", "Exact", n, 15));
+    rows.push_back(measure<double, Fast>("double", "Fast", n, 15));
+    rows.push_back(measure<double, Approx>("double", "Approx", n, 15));
+
+    std::fprintf(out, "{\n  \"suite\": \"vector_accuracy\",\n  \"samples\": %zu,\n  \"results\": [\n", n);
+    for(size_t i = 0; i < rows.size(); ++i)
+    {
+        const AccuracyRow& r = rows[i];
+        std::fprintf(out, "    {\"type\": \"%s\", \"policy\": \"%s\", ", r.type, r.policy);
+        writeError(out, "mag", r.mag, false);
+        writeError(out, "normalize", r.normalize, false);
+        writeError(out, "normalize_batch", r.normalizeBatch, false);
+        writeError(out, "angle", r.angle, true);
+        std::fprintf(out, "}%s\n", i + 1 < rows.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+}
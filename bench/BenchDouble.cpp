@@ -0,0 +1,197 @@
+//
+//  BenchDouble.cpp
+//  throughput of the double-precision Vector3 in includes/math/Vector3.h
+//
+
+#include "Bench.h"
+#include "../includes/math/Vector3.h"
+#include "../src/geom/MeshNormals.h"
+#include <cstdlib>
+#include <vector>
+
+static const char* IMPL = "Vector3(double)";
+
+static double randomDouble()
+{
+    return double(std::rand()) / double(RAND_MAX) * 2.0 - 1.0;
+}
+
+void benchDoubleVector3(BenchSuite& suite, const std::vector<BenchLevel>& levels)
+{
+    // read at run time so the compiler cannot fold the identity scale away
+    volatile double oneSource = 1.0;
+    const double one = oneSource;
+    const double theta = 0.001;
+    const Vector3 axis(0.0, 0.0, 1.0);
+    const Vector3 ones(one, one, one);
+
+    for(size_t l = 0; l < levels.size(); ++l)
+    {
+        const BenchLevel& level = levels[l];
+        // three vector buffers (two inputs and one output) fill the level
+        const size_t n = level.bytes / (3*sizeof(Vector3));
+        const size_t sv = sizeof(Vector3), sd = sizeof(double);
+
+        std::vector<Vector3> a(n), b(n), c(n);
+        std::vector<double> s(n), out(n);
+        for(size_t i = 0; i < n; ++i)
+        {
+            a[i] = Vector3(randomDouble(), randomDouble(), randomDouble());
+            b[i] = Vector3(randomDouble(), randomDouble(), randomDouble());
+            s[i] = randomDouble();
+        }
+
+        /*****************************************************/
+        /*                  Construction                     */
+        /*****************************************************/
+        suite.time(IMPL, "construct", level, n, sd + sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = Vector3(s[i], s[i], s[i]);
+        });
+        suite.time(IMPL, "copy", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i];
+        });
+
+        /*****************************************************/
+        /*                    Operators                      */
+        /*****************************************************/
+        suite.time(IMPL, "operator+=", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] += b[i];
+        });
+        suite.time(IMPL, "operator-=", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] -= b[i];
+        });
+        suite.time(IMPL, "operator*=", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] *= one;
+        });
+        suite.time(IMPL, "operator*= vector", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] *= ones;
+        });
+        suite.time(IMPL, "operator/=", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] /= one;
+        });
+        suite.time(IMPL, "operator/= vector", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] /= ones;
+        });
+        suite.time(IMPL, "operator+", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i] + b[i];
+        });
+        suite.time(IMPL, "operator-", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i] - b[i];
+        });
+        suite.time(IMPL, "operator*", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i] * ones;
+        });
+        suite.time(IMPL, "operator/", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i] / ones;
+        });
+        suite.time(IMPL, "operator==", level, n, 2*sv + sd, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i] == b[i] ? 1.0 : 0.0;
+        });
+
+        /*****************************************************/
+        /*                 Member Functions                  */
+        /*****************************************************/
+        suite.time(IMPL, "dot", level, n, 2*sv + sd, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].dot(b[i]);
+        });
+        suite.time(IMPL, "cross", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i].cross(b[i]);
+        });
+        suite.time(IMPL, "mag", level, n, sv + sd, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].mag();
+        });
+        suite.time(IMPL, "normalize", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                a[i].normalize();
+        });
+        suite.time(IMPL, "dist", level, n, 2*sv + sd, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].dist(b[i]);
+        });
+        suite.time(IMPL, "angle", level, n, 2*sv + sd, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].angle(b[i]);
+        });
+        suite.time(IMPL, "rotate", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i].rotate(theta, axis);
+        });
+
+        /*****************************************************/
+        /*                 Batch Functions                   */
+        /*****************************************************/
+        suite.time(IMPL, "dot batch", level, n, 2*sv + sd, [&]()
+        {
+            dot(a.data(), b.data(), out.data(), n);
+        });
+        suite.time(IMPL, "cross batch", level, n, 3*sv, [&]()
+        {
+            cross(a.data(), b.data(), c.data(), n);
+        });
+        suite.time(IMPL, "normalize batch", level, n, 2*sv, [&]()
+        {
+            normalize(a.data(), n);
+        });
+        suite.time(IMPL, "dist batch", level, n, 2*sv + sd, [&]()
+        {
+            dist(a.data(), b.data(), out.data(), n);
+        });
+
+        // a's points joined as a side x side grid, two triangles per cell
+        const size_t side = size_t(std::sqrt(double(n)));
+        std::vector<uint32_t> grid;
+        for(size_t r = 0; r + 1 < side; ++r)
+            for(size_t k = 0; k + 1 < side; ++k)
+            {
+                uint32_t v0 = uint32_t(r*side + k), v1 = v0 + 1, v2 = v0 + uint32_t(side), v3 = v2 + 1;
+                uint32_t quad[6] = { v0, v2, v1, v1, v2, v3 };
+                grid.insert(grid.end(), quad, quad + 6);
+            }
+        MeshNormals<double> topology(grid.data(), grid.size()/3, side*side);
+        suite.time(IMPL, "vertex normals", level, side*side, sv + 2*12, [&]()
+        {
+            computeNormals(a.data(), side*side, topology);
+        });
+        suite.time(IMPL, "vertex normals angle", level, side*side, sv + 2*12, [&]()
+        {
+            computeNormals(a.data(), side*side, topology, true);
+        });
+    }
+}
+
@@ -0,0 +1,82 @@
+//
+//  BenchMain.cpp
+//  vector_bench: throughput of both Vector3 implementations and Quat at
+//  L1, L2, L3 and DRAM sized working sets, written as JSON
+//
+//  build from the repository root, e.g.
+//    g++ -std=c++14 -O3 -march=native -pthread -Isrc bench/BenchMain.cpp
+//        bench/BenchTemplate.cpp bench/BenchDouble.cpp bench/BenchAccuracy.cpp
+//        src/math/Vector3.cpp -o vector_bench
+//
+//  usage: vector_bench [--quick] [--accuracy] [--out results.json]
+//    --quick     shorter rounds and a smaller DRAM set, for smoke runs
+//    --accuracy  report the error of each precision policy instead of timings
+//    --out       write the JSON there instead of stdout (progress goes to stderr)
+//
+
+#include "Bench.h"
+#include "math/Simd.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+    bool quick = false;
+    bool accuracy = false;
+    const char* outPath = 0;
+    for(int i = 1; i < argc; ++i)
+    {
+        if(std::strcmp(argv[i], "--quick") == 0)
+            quick = true;
+        else if(std::strcmp(argv[i], "--accuracy") == 0)
+            accuracy = true;
+        else if(std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            outPath = argv[++i];
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--quick] [--accuracy] [--out results.json]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    FILE* out = stdout;
+    if(outPath)
+    {
+        out = std::fopen(outPath, "w");
+        if(!out)
+        {
+            std::perror(outPath);
+            return 1;
+        }
+    }
+
+    if(accuracy)
+    {
+        benchAccuracy(out, quick ? 100000 : 4000000);
+        if(out != stdout)
+            std::fclose(out);
+        return 0;
+    }
+
+    // sizes chosen to sit well inside each level on current desktop parts
+    std::vector<BenchLevel> levels;
+    BenchLevel l1 = {"L1", 16 << 10};
+    BenchLevel l2 = {"L2", 256 << 10};
+    BenchLevel l3 = {"L3", 4 << 20};
+    BenchLevel dram = {"DRAM", size_t(quick ? 64 : 512) << 20};
+    levels.push_back(l1);
+    levels.push_back(l2);
+    levels.push_back(l3);
+    levels.push_back(dram);
+
+    BenchSuite suite(quick ? 0.005 : 0.05, quick ? 1 : 3);
+    benchTemplateVector3(suite, levels);
+    benchDoubleVector3(suite, levels);
+
+    suite.writeJSON(out, "vector_bench", int(Pack<float>::width), int(Pack<double>::width));
+    if(out != stdout)
+        std::fclose(out);
+    return 0;
+}
+
@@ -0,0 +1,558 @@
+//
+//  BenchTemplate.cpp
+//  throughput of the templated Vector3<float, int> and Quat<float>
+//
+
+#include "Bench.h"
+#include "math/Vector3.h"
+#include "math/Vector3Array.h"
+#include "math/VectorExpr.h"
+#include "math/Quat.h"
+#include "math/Skinning.h"
+#include "math/Point3.h"
+#include "math/VectorCodec.h"
+#include "math/VectorReduce.h"
+#include "geom/Bvh.h"
+#include "geom/Frustum.h"
+#include "geom/KdTree.h"
+#include "geom/SpaceFillingCurve.h"
+#include "geom/SpatialHash.h"
+#include "geom/VertexWeld.h"
+#include "scene/TransformHierarchy.h"
+#include "util/Parallel.h"
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+typedef Vector3<> V;
+typedef Quat<> Q;
+
+static const char* IMPL = "Vector3<float,int>";
+static const char* QUAT_IMPL = "Quat<float>";
+
+static float randomFloat()
+{
+    return float(std::rand()) / float(RAND_MAX) * 2.0f - 1.0f;
+}
+
+void benchTemplateVector3(BenchSuite& suite, const std::vector<BenchLevel>& levels)
+{
+    // read at run time so the compiler cannot fold the identity scale away
+    volatile float oneSource = 1.0f;
+    const float one = oneSource;
+    const float theta = 0.001f;
+    const V axis(0.0f, 0.0f, 1.0f);
+
+    for(size_t l = 0; l < levels.size(); ++l)
+    {
+        const BenchLevel& level = levels[l];
+        // three vector buffers (two inputs and one output) fill the level
+        const size_t n = level.bytes / (3*sizeof(V));
+        const size_t sv = sizeof(V), sf = sizeof(float);
+
+        std::vector<V> a(n), b(n), c(n);
+        std::vector<float> s(n), out(n);
+        for(size_t i = 0; i < n; ++i)
+        {
+            a[i] = V(randomFloat(), randomFloat(), randomFloat());
+            b[i] = V(randomFloat(), randomFloat(), randomFloat());
+            s[i] = randomFloat();
+        }
+
+        /*****************************************************/
+        /*                  Construction                     */
+        /*****************************************************/
+        suite.time(IMPL, "construct", level, n, sf + sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = V(s[i], s[i], s[i]);
+        });
+        suite.time(IMPL, "copy", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i];
+        });
+
+        /*****************************************************/
+        /*                    Operators                      */
+        /*****************************************************/
+        suite.time(IMPL, "operator+=", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] += b[i];
+        });
+        suite.time(IMPL, "operator-=", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] -= b[i];
+        });
+        suite.time(IMPL, "operator*=", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] *= one;
+        });
+        suite.time(IMPL, "operator/=", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] /= one;
+        });
+        suite.time(IMPL, "operator+", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i] + b[i];
+        });
+        suite.time(IMPL, "operator-", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i] - b[i];
+        });
+        suite.time(IMPL, "operator*", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i] * one;
+        });
+        suite.time(IMPL, "operator==", level, n, 2*sv + sf, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i] == b[i] ? 1.0f : 0.0f;
+        });
+        suite.time(IMPL, "chain a+b*s-c eager", level, n, 4*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i] + b[i]*one - c[i];
+        });
+        suite.time(IMPL, "chain a+b*s-c lazy", level, n, 4*sv, [&]()
+        {
+            lazy(c) = lazy(a) + lazy(b)*one - lazy(c);
+        });
+        suite.time(IMPL, "copy lazy", level, n, 2*sv, [&]()
+        {
+            lazy(c) = lazy(a);
+        });
+
+        /*****************************************************/
+        /*                 Member Functions                  */
+        /*****************************************************/
+        suite.time(IMPL, "dot", level, n, 2*sv + sf, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].dot(b[i]);
+        });
+        suite.time(IMPL, "cross", level, n, 3*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = a[i].cross(b[i]);
+        });
+        suite.time(IMPL, "mag", level, n, sv + sf, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].mag();
+        });
+        suite.time(IMPL, "mag Fast", level, n, sv + sf, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].mag<Fast>();
+        });
+        suite.time(IMPL, "squaredMag", level, n, sv + sf, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].squaredMag();
+        });
+        suite.time(IMPL, "normalize", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                a[i].normalize();
+        });
+        suite.time(IMPL, "normalize Fast", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                a[i].normalize<Fast>();
+        });
+        suite.time(IMPL, "dist", level, n, 2*sv + sf, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].dist(b[i]);
+        });
+        suite.time(IMPL, "squaredDist", level, n, 2*sv + sf, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].squaredDist(b[i]);
+        });
+        suite.time(IMPL, "angle", level, n, 2*sv + sf, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].angle(b[i]);
+        });
+        suite.time(IMPL, "angle Approx", level, n, 2*sv + sf, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = a[i].angle<Approx>(b[i]);
+        });
+        suite.time(IMPL, "rotate", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i].rotate(theta, axis);
+        });
+
+        /*****************************************************/
+        /*                Vector3Array Batches               */
+        /*****************************************************/
+        Vector3Array<> A(a), B(b);
+        const size_t st = 3*sf;
+        suite.time("Vector3Array<float>", "dot", level, n, 2*st + sf, [&]()
+        {
+            A.dot(B, out.data());
+        });
+        suite.time("Vector3Array<float>", "cross", level, n, 3*st, [&]()
+        {
+            Vector3Array<> C = A.cross(B);
+            doNotOptimize(C.getXStream()[0]);
+        });
+        suite.time("Vector3Array<float>", "normalize", level, n, 2*st, [&]()
+        {
+            A.normalize();
+        });
+        suite.time("Vector3Array<float>", "normalize Fast", level, n, 2*st, [&]()
+        {
+            A.normalize<Fast>();
+        });
+        suite.time("Vector3Array<float>", "dist", level, n, 2*st + sf, [&]()
+        {
+            A.dist(B, out.data());
+        });
+        suite.time("Vector3Array<float>", "rotate", level, n, 2*st, [&]()
+        {
+            A.rotate(theta, axis);
+        });
+        suite.time("Vector3Array<float>", "copy lazy", level, n, 2*st, [&]()
+        {
+            lazy(B) = lazy(A);
+        });
+
+        /*****************************************************/
+        /*                    Parallel                       */
+        /*****************************************************/
+        suite.time(IMPL, "normalize parallel", level, n, 2*sv, [&]()
+        {
+            parallelTransform(a.data(), n, [](V& v) { v.normalize(); });
+        });
+        suite.time(IMPL, "centroid parallelReduce", level, n, sv, [&]()
+        {
+            V sum = parallelReduce(n, parallelGrain<V>(), V(0.0f, 0.0f, 0.0f),
+                                   [&](size_t begin, size_t end)
+                                   {
+                                       V acc(0.0f, 0.0f, 0.0f);
+                                       for(size_t i = begin; i < end; ++i)
+                                           acc += a[i];
+                                       return acc;
+                                   },
+                                   [](const V& x, const V& y) { return x + y; });
+            doNotOptimize(sum);
+        });
+        suite.time("Vector3Array<float>", "bounds reduce", level, n, st, [&]()
+        {
+            BoundingBox<float> box = computeBounds(A);
+            doNotOptimize(box);
+        });
+        suite.time("Vector3Array<float>", "centroid reduce", level, n, st, [&]()
+        {
+            V c = computeCentroid(A);
+            doNotOptimize(c);
+        });
+        suite.time("Vector3Array<float>", "covariance reduce", level, n, 2*st, [&]()
+        {
+            Mat3<float> m = computeCovariance(A);
+            doNotOptimize(m);
+        });
+        suite.time("Vector3Array<float>", "bounding sphere", level, n, 2*st, [&]()
+        {
+            BoundingSphere<float> s = computeBoundingSphere(A);
+            doNotOptimize(s);
+        });
+
+        /*****************************************************/
+        /*                     Point3                        */
+        /*****************************************************/
+        std::vector<Point3<> > pa(n), pb(n);
+        const size_t sp = sizeof(Point3<>);
+        for(size_t i = 0; i < n; ++i)
+        {
+            pa[i] = Point3<>(a[i]);
+            pb[i] = Point3<>(b[i]);
+        }
+        suite.time("Point3<float>", "dot", level, n, 2*sp + sf, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                out[i] = pa[i].dot(pb[i]);
+        });
+        suite.time("Point3<float>", "normalize", level, n, 2*sp, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                pa[i].normalize();
+        });
+        suite.time("Point3<float>", "normalize batch", level, n, 2*sp, [&]()
+        {
+            Point3<>::normalize(pa.data(), n);
+        });
+
+        /*****************************************************/
+        /*                      KdTree                       */
+        /*****************************************************/
+        KdTree<float> tree;
+        suite.time("KdTree<float>", "build", level, n, 2*st + 4, [&]()
+        {
+            tree.build(A.getXStream(), A.getYStream(), A.getZStream(), n);
+        });
+        // A lies on the unit sphere by now, so the queries are its own points;
+        // each costs far more than a pass over memory, so a fixed number is timed
+        const size_t nk = n < 4096 ? n : 4096;
+        std::vector<uint32_t> nearest(8*nk);
+        suite.time("KdTree<float>", "knn batch k=8", level, nk, st + 8*4, [&]()
+        {
+            tree.knnBatch(A.getXStream(), A.getYStream(), A.getZStream(), nk, 8, nearest.data());
+        });
+
+        // cells sized to hold about 8 of the sphere's points each
+        SpatialHash<float> grid(std::sqrt(4.0f*3.14159265f*8.0f / float(n)));
+        suite.time("SpatialHash<float>", "update", level, n, 2*st + 16, [&]()
+        {
+            grid.update(A);
+        });
+        std::vector<uint32_t> near;
+        std::vector<size_t> offsets;
+        suite.time("SpatialHash<float>", "radius batch", level, nk, st + 8*4, [&]()
+        {
+            grid.radiusBatch(A.getXStream(), A.getYStream(), A.getZStream(), nk,
+                             grid.getCellSize(), near, offsets);
+        });
+
+        /*****************************************************/
+        /*                   Compression                     */
+        /*****************************************************/
+        // A doubles as a set of unit normals for the octahedral encoding
+        HalfVector3Array<> halves(A);
+        QuantizedVector3Array<> fixed(A);
+        OctahedralNormalArray<> octs;
+        Vector3Array<> decoded(n);
+        suite.time("VectorCodec<float>", "half decode", level, n, 6 + st, [&]()
+        {
+            halves.decode(decoded.getXStream(), decoded.getYStream(), decoded.getZStream());
+        });
+        suite.time("VectorCodec<float>", "fixed16 decode", level, n, 6 + st, [&]()
+        {
+            fixed.decode(decoded.getXStream(), decoded.getYStream(), decoded.getZStream());
+        });
+        suite.time("VectorCodec<float>", "octahedral encode", level, n, st + 4, [&]()
+        {
+            octs.encode(A.getXStream(), A.getYStream(), A.getZStream(), n);
+        });
+        suite.time("VectorCodec<float>", "octahedral decode", level, n, 4 + st, [&]()
+        {
+            octs.decode(decoded.getXStream(), decoded.getYStream(), decoded.getZStream());
+        });
+
+        /*****************************************************/
+        /*                     Frustum                       */
+        /*****************************************************/
+        // a 90 degree camera at the origin looking down -z sees about a
+        // sixth of the sphere; boxes are A's points grown by the radius
+        Frustum<float> frustum(Mat4<float>(1, 0, 0, 0,
+                                           0, 1, 0, 0,
+                                           0, 0, -1.002f, -0.2002f,
+                                           0, 0, -1, 0));
+        std::vector<float> radius(n, 0.01f);
+        Vector3Array<> boxHi(A);
+        boxHi += 0.01f;
+        std::vector<uint32_t> visible;
+        suite.time("Frustum<float>", "cull spheres", level, n, st + sf + 4, [&]()
+        {
+            frustum.cullSpheres(A.getXStream(), A.getYStream(), A.getZStream(), radius.data(), n, visible);
+        });
+        suite.time("Frustum<float>", "cull boxes", level, n, 2*st + 4, [&]()
+        {
+            frustum.cullBoxes(A.getXStream(), A.getYStream(), A.getZStream(),
+                              boxHi.getXStream(), boxHi.getYStream(), boxHi.getZStream(), n, visible);
+        });
+
+        /*****************************************************/
+        /*                        Bvh                        */
+        /*****************************************************/
+        // a latitude-longitude sphere of radius 2 with about n/4 triangles,
+        // hit from the origin by rays along A (every ray hits); A's random
+        // order makes every packet incoherent, the worst case for packets
+        const size_t rings = std::max<size_t>(4, size_t(std::sqrt(float(n)/16)));
+        Vector3Array<> mesh;
+        std::vector<uint32_t> triangles;
+        for(size_t r = 0; r <= rings; ++r)
+            for(size_t c = 0; c < 2*rings; ++c)
+            {
+                float theta = 3.14159265f*float(r)/float(rings), phi = 3.14159265f*float(c)/float(rings);
+                mesh.push_back(V(2*std::sin(theta)*std::cos(phi), 2*std::sin(theta)*std::sin(phi), 2*std::cos(theta)));
+            }
+        for(size_t r = 0; r < rings; ++r)
+            for(size_t c = 0; c < 2*rings; ++c)
+            {
+                uint32_t a = uint32_t(r*2*rings + c), b = uint32_t(r*2*rings + (c + 1) % (2*rings));
+                uint32_t d = a + uint32_t(2*rings), e = b + uint32_t(2*rings);
+                uint32_t quad[6] = { a, d, b, b, d, e };
+                triangles.insert(triangles.end(), quad, quad + 6);
+            }
+        Bvh<float> bvh;
+        suite.time("Bvh<float>", "build", level, triangles.size()/3, 12 + 3*4, [&]()
+        {
+            bvh.build(mesh.getXStream(), mesh.getYStream(), mesh.getZStream(), triangles.data(), triangles.size()/3);
+        });
+        std::vector<float> origin(n, 0.0f), hitT(n);
+        std::vector<uint32_t> hitTriangle(n);
+        std::vector<uint8_t> blocked(n);
+        suite.time("Bvh<float>", "intersect packets", level, n, 6*sf + sf + 4, [&]()
+        {
+            bvh.intersectBatch(origin.data(), origin.data(), origin.data(),
+                               A.getXStream(), A.getYStream(), A.getZStream(), n, 10.0f,
+                               hitT.data(), hitTriangle.data());
+        });
+        suite.time("Bvh<float>", "occluded packets", level, n, 6*sf + 1, [&]()
+        {
+            bvh.occludedBatch(origin.data(), origin.data(), origin.data(),
+                              A.getXStream(), A.getYStream(), A.getZStream(), n, 10.0f, blocked.data());
+        });
+
+        /*****************************************************/
+        /*                    Vertex Weld                    */
+        /*****************************************************/
+        // exact welding keeps all of A; an epsilon of 0.001 merges the closest pairs
+        std::vector<uint32_t> remap(n);
+        suite.time("VertexWeld<float>", "weld exact", level, n, st + 4 + 16, [&]()
+        {
+            doNotOptimize(weldVertices(A.getXStream(), A.getYStream(), A.getZStream(), n, 0.0f, remap.data()));
+        });
+        suite.time("VertexWeld<float>", "weld epsilon", level, n, st + 4 + 16, [&]()
+        {
+            doNotOptimize(weldVertices(A.getXStream(), A.getYStream(), A.getZStream(), n, 0.001f, remap.data()));
+        });
+
+        /*****************************************************/
+        /*                Space-Filling Curves               */
+        /*****************************************************/
+        std::vector<uint32_t> curveOrder;
+        suite.time("SpaceFillingCurve<float>", "morton order", level, n, st + 8 + 4, [&]()
+        {
+            spatialOrder(A.getXStream(), A.getYStream(), A.getZStream(), n, MORTON_CURVE, curveOrder);
+        });
+        suite.time("SpaceFillingCurve<float>", "hilbert order", level, n, st + 8 + 4, [&]()
+        {
+            spatialOrder(A.getXStream(), A.getYStream(), A.getZStream(), n, HILBERT_CURVE, curveOrder);
+        });
+
+        /*****************************************************/
+        /*                       Quat                        */
+        /*****************************************************/
+        const size_t nq = level.bytes / (3*sizeof(Q));
+        const size_t sq = sizeof(Q);
+        std::vector<Q> qa(nq), qb(nq), qc(nq);
+        for(size_t i = 0; i < nq; ++i)
+        {
+            qa[i] = Q(V(randomFloat(), randomFloat(), randomFloat()), randomFloat());
+            qb[i] = Q(V(randomFloat(), randomFloat(), randomFloat()), randomFloat());
+        }
+        suite.time(QUAT_IMPL, "mult", level, nq, 3*sq, [&]()
+        {
+            for(size_t i = 0; i < nq; ++i)
+                qc[i] = qa[i].mult(qb[i]);
+        });
+        std::vector<float> ts(nq);
+        for(size_t i = 0; i < nq; ++i)
+            ts[i] = 0.5f + 0.5f*randomFloat();
+        suite.time(QUAT_IMPL, "slerp", level, nq, 3*sq + sf, [&]()
+        {
+            for(size_t i = 0; i < nq; ++i)
+                qc[i] = qa[i].slerp(qb[i], ts[i]);
+        });
+        suite.time(QUAT_IMPL, "nlerp", level, nq, 3*sq + sf, [&]()
+        {
+            for(size_t i = 0; i < nq; ++i)
+                qc[i] = qa[i].nlerp(qb[i], ts[i]);
+        });
+        suite.time(QUAT_IMPL, "slerp batch", level, nq, 3*sq + sf, [&]()
+        {
+            Q::slerp(qa.data(), qb.data(), ts.data(), qc.data(), nq);
+        });
+        suite.time(QUAT_IMPL, "nlerp batch", level, nq, 3*sq + sf, [&]()
+        {
+            Q::nlerp(qa.data(), qb.data(), ts.data(), qc.data(), nq);
+        });
+        suite.time(QUAT_IMPL, "normalize", level, nq, 2*sq, [&]()
+        {
+            for(size_t i = 0; i < nq; ++i)
+                qa[i].normalize();
+        });
+        suite.time(QUAT_IMPL, "getRotateXYZ", level, n, 2*sv, [&]()
+        {
+            for(size_t i = 0; i < n; ++i)
+                c[i] = qa[i % nq].getRotateXYZ(a[i]);
+        });
+        std::vector<float> flat(3*n);
+        for(size_t i = 0; i < 3*n; ++i)
+            flat[i] = randomFloat();
+        suite.time(QUAT_IMPL, "rotate batch", level, n, 2*st, [&]()
+        {
+            qa[0].rotate(flat.data(), flat.data(), n);
+        });
+        suite.time(QUAT_IMPL, "rotate batch parallel", level, n, 2*st, [&]()
+        {
+            parallelFor(n, parallelGrain<V>(), [&](size_t begin, size_t end)
+            {
+                qa[0].rotate(flat.data() + 3*begin, flat.data() + 3*begin, end - begin);
+            });
+        });
+
+        /*****************************************************/
+        /*                    Skinning                       */
+        /*****************************************************/
+        // 64 bones and four influences per vertex over the Vector3Array streams
+        std::vector<DualQuat<> > bones(64);
+        for(size_t k = 0; k < bones.size(); ++k)
+            bones[k] = DualQuat<>(qa[k % nq], randomFloat(), randomFloat(), randomFloat());
+        std::vector<uint16_t> boneIndices(SKIN_INFLUENCES*n);
+        std::vector<float> boneWeights(SKIN_INFLUENCES*n);
+        for(size_t i = 0; i < SKIN_INFLUENCES*n; ++i)
+        {
+            boneIndices[i] = uint16_t(std::rand() % bones.size());
+            boneWeights[i] = 0.25f;
+        }
+        Vector3Array<> N(b);
+        suite.time("DualQuat<float>", "skin 4 bones", level, n, 4*st + 4*(2 + sf), [&]()
+        {
+            dualQuatSkin(bones.data(), boneIndices.data(), boneWeights.data(),
+                         A.getXStream(), A.getYStream(), A.getZStream(),
+                         N.getXStream(), N.getYStream(), N.getZStream(),
+                         A.getXStream(), A.getYStream(), A.getZStream(),
+                         N.getXStream(), N.getYStream(), N.getZStream(), n);
+        });
+
+        /*****************************************************/
+        /*                Transform Hierarchy                */
+        /*****************************************************/
+        // a random tree over nq nodes, every node moved or only 16 of them
+        TransformHierarchy<> scene;
+        for(size_t i = 0; i < nq; ++i)
+        {
+            TransformNode node = scene.add(i < 8 ? TRANSFORM_NONE : TransformNode(std::rand() % i));
+            scene.setLocal(node, qa[i], randomFloat(), randomFloat(), randomFloat());
+        }
+        scene.update();
+        suite.time("TransformHierarchy<float>", "update all", level, nq, 2*(sq + st + sf), [&]()
+        {
+            for(size_t i = 0; i < nq; ++i)
+                scene.setRotation(TransformNode(i), qa[i]);
+            scene.update();
+        });
+        suite.time("TransformHierarchy<float>", "update 16 dirty", level, nq, 2*(sq + st + sf), [&]()
+        {
+            for(size_t k = 0; k < 16; ++k)
+                scene.setRotation(TransformNode(nq - 1 - (k*7919) % nq), qa[k]);
+            scene.update();
+        });
+    }
+}
+
@@ -19,6 +19,8 @@
 #define Protobyte_Library_V01_Vector3_h
 
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <iostream>
 #include <math.h>
 
@@ -29,6 +31,7 @@
     /*            Non-Member Ops & Functions             */
     /*****************************************************/
     class Vector3; // forward declare class for non-member prototypes
+    template <class T> class MeshNormals; // src/geom/MeshNormals.h
     
     Vector3 operator+(const Vector3& lhs, const Vector3& rhs);
     Vector3 operator-(const Vector3& lhs, const Vector3& rhs);
@@ -40,6 +43,24 @@
     Vector3 rotate(double theta, const Vector3& axis, const Vector3& v);
     double angle(const Vector3& lhs, const Vector3& rhs);
     
+    // batch versions over n vectors, run through the SIMD kernels in
+    // src/math/VectorKernels.h (see there for the tolerance against the
+    // scalar functions); batch cross only writes the xyz of out
+    void dot(const Vector3* lhs, const Vector3* rhs, double* out, size_t n);
+    void cross(const Vector3* lhs, const Vector3* rhs, Vector3* out, size_t n);
+    void normalize(Vector3* v, size_t n);
+    void dist(const Vector3* lhs, const Vector3* rhs, double* out, size_t n);
+    
+    // smooth vertex normals of the n vertices v indexed by triangles
+    // (indices[3t], indices[3t + 1], indices[3t + 2]), area weighted or angle
+    // weighted, written to the normal fields of v; the second form reuses the
+    // adjacency of a MeshNormals built for the same indices, for meshes whose
+    // positions change every frame
+    void computeNormals(Vector3* v, size_t n, const uint32_t* indices, size_t triangles,
+                        bool angleWeighted = false);
+    void computeNormals(Vector3* v, size_t n, MeshNormals<double>& topology,
+                        bool angleWeighted = false);
+    
     
     class Vector3 {
         
@@ -49,9 +70,6 @@
         // declared friend function to allow access to private data fields
         friend std::ostream& operator<<(std::ostream& output, const Vector3& vec);
         
-        // track total number of vertices
-        static int totolVector3Count;
-        
         // vertex coords
         double x, y, z;
         
@@ -106,6 +124,16 @@
         double dist(const Vector3& v);
         Vector3& rotate(double theta, const Vector3& axis);
         
+        /*****************************************************/
+        /*                 Getters & Setters                 */
+        /*****************************************************/
+        // the vertex normal is not set by the constructors; it holds whatever
+        // was last given to setNormal() or computeNormals()
+        void setNormal(double nx, double ny, double nz);
+        void setNormal(const Vector3& n);
+        Vector3 getNormal() const;
+        const double* getNormalArray() const;
+        
     private:
         // vertex normal
         double nx, ny, nz;
@@ -0,0 +1,599 @@
+#ifndef BVH_H
+#define	BVH_H
+
+#include "../math/Simd.h"
+#include "../math/Vector3.h"
+#include "../math/Vector3Array.h"
+#include "../util/Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// bounding volume hierarchy over a triangle mesh for ray casting
+//
+// the build bins triangle centroids into BVH_BINS slabs per axis and splits
+// each node where the surface area heuristic is cheapest (Wald, "On fast
+// Construction of SAH-based Bounding Volume Hierarchies", 2007), making a
+// leaf when no split beats intersecting every triangle. subtrees of large
+// ranges are built as TaskScheduler tasks. the result does not depend on the
+// thread count: every subtree is written to its own fixed range of a scratch
+// array, which is then compacted into depth-first order
+//
+// nodes are 32 bytes for float (two per cache line): a box, and either the
+// right child (the left one is the next node) or the first triangle of a
+// leaf. triangles are stored in leaf order as SoA streams of v0 and the two
+// edges e1 = v1 - v0, e2 = v2 - v0, the terms Moller-Trumbore uses
+//
+// rays are traced in packets of Pack<T>::width (4, 8 or 16) through one
+// shared traversal: a node is entered when its box is hit by any live ray of
+// the packet, children are visited nearer-first by the packet's dominant
+// direction, and every triangle of a leaf is tested against all lanes at
+// once. packets work best when their rays are coherent (neighbouring pixels,
+// rays around one sample point); leftover rays go through alone. the batch
+// calls split the rays across the scheduler in packets, so results do not
+// depend on the thread count
+
+const uint32_t BVH_NONE = 0xffffffffu;
+
+template <class T = float>
+struct BvhNode
+{
+    T lo[3];
+    uint32_t offset;    // right child (interior) or first triangle (leaf)
+    T hi[3];
+    uint16_t count;     // triangles of a leaf, 0 for an interior node
+    uint16_t axis;      // split axis of an interior node
+};
+
+template <class T = float>
+struct BvhHit
+{
+    T t, u, v;          // distance and barycentrics of v1 and v2
+    uint32_t triangle;  // BVH_NONE on a miss
+};
+
+template <class T = float>
+class Bvh
+{
+private:
+    enum { BVH_BINS = 16, MAX_LEAF = 8, MAX_SAH_DEPTH = 64, STACK = 128 };
+
+    std::vector<BvhNode<T> > nodes;
+    std::vector<T> tri[9];          // v0 xyz, e1 xyz, e2 xyz in leaf order
+    std::vector<uint32_t> ids;      // original index of each triangle in leaf order
+
+    // build scratch: one record per triangle, partitioned in place so every
+    // pass over a node reads memory in order
+    struct BuildPrim
+    {
+        T lo[3], hi[3], c[3];
+        uint32_t id;
+    };
+
+    struct BuildData
+    {
+        std::vector<BuildPrim> prims;
+        std::vector<BvhNode<T> > slots;
+    };
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    Bvh()
+    {
+    }
+
+    // triangle i has corners indices[3i], indices[3i + 1], indices[3i + 2]
+    Bvh(const T* x, const T* y, const T* z, const uint32_t* indices, size_t triangles,
+        TaskScheduler& scheduler = TaskScheduler::instance())
+    {
+        build(x, y, z, indices, triangles, scheduler);
+    }
+
+    template <class U>
+    Bvh(const Vector3Array<T, U>& vertices, const std::vector<uint32_t>& indices,
+        TaskScheduler& scheduler = TaskScheduler::instance())
+    {
+        build(vertices.getXStream(), vertices.getYStream(), vertices.getZStream(),
+              indices.data(), indices.size() / 3, scheduler);
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    inline void build(const T* x, const T* y, const T* z, const uint32_t* indices, size_t triangles,
+                      TaskScheduler& scheduler = TaskScheduler::instance())
+    {
+        nodes.clear();
+        ids.clear();
+        for(int k = 0; k < 9; ++k)
+            tri[k].clear();
+        if(triangles == 0)
+            return;
+
+        BuildData b;
+        b.prims.resize(triangles);
+        b.slots.resize(2*triangles);
+        const T* v[3] = { x, y, z };
+        parallelFor(triangles, parallelGrain<T>(), [&](size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; ++i)
+            {
+                const uint32_t* t = indices + 3*i;
+                BuildPrim& prim = b.prims[i];
+                for(int a = 0; a < 3; ++a)
+                {
+                    T p0 = v[a][t[0]], p1 = v[a][t[1]], p2 = v[a][t[2]];
+                    prim.lo[a] = std::min(p0, std::min(p1, p2));
+                    prim.hi[a] = std::max(p0, std::max(p1, p2));
+                    prim.c[a] = (prim.lo[a] + prim.hi[a])/2;
+                }
+                prim.id = uint32_t(i);
+            }
+        }, scheduler);
+
+        std::atomic<size_t> pending(0);
+        buildNode(b, 0, 0, triangles, 0, pending, scheduler);
+        scheduler.wait(pending);
+        flatten(b.slots);
+
+        for(int k = 0; k < 9; ++k)
+            tri[k].resize(triangles);
+        ids.resize(triangles);
+        parallelFor(triangles, parallelGrain<T>(), [&](size_t begin, size_t end)
+        {
+            for(size_t j = begin; j < end; ++j)
+            {
+                ids[j] = b.prims[j].id;
+                const uint32_t* t = indices + 3*size_t(ids[j]);
+                for(int a = 0; a < 3; ++a)
+                {
+                    T p0 = v[a][t[0]];
+                    tri[a][j] = p0;
+                    tri[3 + a][j] = v[a][t[1]] - p0;
+                    tri[6 + a][j] = v[a][t[2]] - p0;
+                }
+            }
+        }, scheduler);
+    }
+
+    // closest hit of the ray o + t d for t in (0, tMax); returns whether
+    // there is one
+    template <class U>
+    inline bool intersect(const Vector3<T, U>& o, const Vector3<T, U>& d, T tMax, BvhHit<T>& hit) const
+    {
+        const T ox = o.getX(), oy = o.getY(), oz = o.getZ();
+        const T dx = d.getX(), dy = d.getY(), dz = d.getZ();
+        trace<ScalarPack<T> >(&ox, &oy, &oz, &dx, &dy, &dz, 0, tMax, false,
+                              &hit.t, &hit.triangle, &hit.u, &hit.v);
+        return hit.triangle != BVH_NONE;
+    }
+
+    // whether anything lies on the ray within (0, tMax); stops at the first hit
+    template <class U>
+    inline bool occluded(const Vector3<T, U>& o, const Vector3<T, U>& d, T tMax) const
+    {
+        const T ox = o.getX(), oy = o.getY(), oz = o.getZ();
+        const T dx = d.getX(), dy = d.getY(), dz = d.getZ();
+        T t;
+        uint32_t triangle;
+        trace<ScalarPack<T> >(&ox, &oy, &oz, &dx, &dy, &dz, 0, tMax, true, &t, &triangle, 0, 0);
+        return triangle != BVH_NONE;
+    }
+
+    // closest hits of rays [0, n) given as SoA origins and directions: t[i]
+    // is the distance (tMax on a miss) and triangle[i] the input index of the
+    // triangle hit (BVH_NONE on a miss); u and v may be 0
+    inline void intersectBatch(const T* ox, const T* oy, const T* oz,
+                               const T* dx, const T* dy, const T* dz, size_t n, T tMax,
+                               T* t, uint32_t* triangle, T* u = 0, T* v = 0,
+                               TaskScheduler& scheduler = TaskScheduler::instance()) const
+    {
+        traceBatch(ox, oy, oz, dx, dy, dz, n, tMax, false, t, triangle, u, v, scheduler);
+    }
+
+    // occlusion of rays [0, n): occluded[i] is 1 when anything lies within
+    // (0, tMax) along ray i
+    inline void occludedBatch(const T* ox, const T* oy, const T* oz,
+                              const T* dx, const T* dy, const T* dz, size_t n, T tMax,
+                              uint8_t* occluded, TaskScheduler& scheduler = TaskScheduler::instance()) const
+    {
+        parallelFor(n, 256, [&](size_t begin, size_t end)
+        {
+            T t[256];
+            uint32_t triangle[256];
+            traceRange(ox + begin, oy + begin, oz + begin, dx + begin, dy + begin, dz + begin,
+                       end - begin, tMax, true, t, triangle, 0, 0);
+            for(size_t i = begin; i < end; ++i)
+                occluded[i] = triangle[i - begin] != BVH_NONE;
+        }, scheduler);
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline size_t size() const
+    {
+        return ids.size();
+    }
+
+    inline bool empty() const
+    {
+        return ids.empty();
+    }
+
+    inline size_t getNodeCount() const
+    {
+        return nodes.size();
+    }
+
+    inline const BvhNode<T>* getNodes() const
+    {
+        return nodes.data();
+    }
+
+private:
+    /*****************************************************/
+    /*                      Build                        */
+    /*****************************************************/
+    static inline T halfArea(const T* lo, const T* hi)
+    {
+        T ex = hi[0] - lo[0], ey = hi[1] - lo[1], ez = hi[2] - lo[2];
+        return ex*ey + ey*ez + ez*ex;
+    }
+
+    static inline int binOf(T c, T lo, T scale, int bins)
+    {
+        int k = int((c - lo)*scale);
+        return k < 0 ? 0 : (k >= bins ? bins - 1 : k);
+    }
+
+    // builds the subtree of prims[begin, end) from slot; a subtree of k
+    // triangles takes at most 2k - 1 slots, so the left child goes to
+    // slot + 1 and the right one to slot + 2 (mid - begin). large right
+    // halves become scheduler tasks
+    inline void buildNode(BuildData& b, size_t slot, size_t begin, size_t end, size_t level,
+                          std::atomic<size_t>& pending, TaskScheduler& scheduler) const
+    {
+        BvhNode<T>& node = b.slots[slot];
+        T clo[3], chi[3];
+        for(int a = 0; a < 3; ++a)
+        {
+            node.lo[a] = clo[a] = std::numeric_limits<T>::max();
+            node.hi[a] = chi[a] = -std::numeric_limits<T>::max();
+        }
+        for(size_t j = begin; j < end; ++j)
+        {
+            const BuildPrim& prim = b.prims[j];
+            for(int a = 0; a < 3; ++a)
+            {
+                node.lo[a] = std::min(node.lo[a], prim.lo[a]);
+                node.hi[a] = std::max(node.hi[a], prim.hi[a]);
+                clo[a] = std::min(clo[a], prim.c[a]);
+                chi[a] = std::max(chi[a], prim.c[a]);
+            }
+        }
+
+        size_t n = end - begin;
+        size_t mid = begin;
+        int axis = 0;
+        if(n <= 1)
+        {
+            makeLeaf(node, begin, n);
+            return;
+        }
+        if(level < MAX_SAH_DEPTH)
+        {
+            // small nodes get fewer bins: their binning cost is per bin
+            int bins = n < size_t(BVH_BINS) ? int(n) : int(BVH_BINS);
+            int bin = -1;
+            T cost = T(n);
+            findSplit(b, begin, end, bins, node, clo, chi, axis, bin, cost);
+            if(bin < 0 && n <= MAX_LEAF)
+            {
+                makeLeaf(node, begin, n);
+                return;
+            }
+            if(bin >= 0)
+            {
+                T lo = clo[axis], scale = T(bins) / (chi[axis] - clo[axis]);
+                mid = size_t(std::partition(b.prims.begin() + begin, b.prims.begin() + end,
+                                            [&](const BuildPrim& prim)
+                {
+                    return binOf(prim.c[axis], lo, scale, bins) <= bin;
+                }) - b.prims.begin());
+            }
+        }
+        if(mid == begin || mid == end)
+        {
+            // identical centroids, or past the depth cap: split at the median
+            // centroid of the widest axis, which bounds the depth
+            mid = begin + n/2;
+            axis = widestAxis(chi, clo);
+            std::nth_element(b.prims.begin() + begin, b.prims.begin() + mid, b.prims.begin() + end,
+                             [&](const BuildPrim& i, const BuildPrim& j)
+            {
+                return i.c[axis] < j.c[axis] || (i.c[axis] == j.c[axis] && i.id < j.id);
+            });
+        }
+
+        size_t right = slot + 2*(mid - begin);
+        node.count = 0;
+        node.axis = uint16_t(axis);
+        node.offset = uint32_t(right);
+        if(end - mid > 4096)
+        {
+            pending.fetch_add(1, std::memory_order_relaxed);
+            scheduler.spawn([this, &b, right, mid, end, level, &pending, &scheduler]()
+            {
+                buildNode(b, right, mid, end, level + 1, pending, scheduler);
+                pending.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        else
+            buildNode(b, right, mid, end, level + 1, pending, scheduler);
+        buildNode(b, slot + 1, begin, mid, level + 1, pending, scheduler);
+    }
+
+    static inline int widestAxis(const T* hi, const T* lo)
+    {
+        int a = hi[1] - lo[1] > hi[0] - lo[0] ? 1 : 0;
+        return hi[2] - lo[2] > hi[a] - lo[a] ? 2 : a;
+    }
+
+    static inline void makeLeaf(BvhNode<T>& node, size_t begin, size_t n)
+    {
+        node.offset = uint32_t(begin);
+        node.count = uint16_t(n);
+        node.axis = 0;
+    }
+
+    // cheapest binned SAH split of prims[begin, end), binning all three axes
+    // in one pass; bin stays -1 when no split costs less than cost (a leaf)
+    inline void findSplit(const BuildData& b, size_t begin, size_t end, int bins, const BvhNode<T>& node,
+                          const T* clo, const T* chi, int& axis, int& bin, T& cost) const
+    {
+        const T big = std::numeric_limits<T>::max();
+        T scale[3];
+        size_t count[3][BVH_BINS] = {};
+        T lo[3][BVH_BINS][3], hi[3][BVH_BINS][3];
+        for(int a = 0; a < 3; ++a)
+        {
+            scale[a] = chi[a] > clo[a] ? T(bins) / (chi[a] - clo[a]) : T(0);
+            for(int k = 0; k < bins; ++k)
+                for(int c = 0; c < 3; ++c)
+                {
+                    lo[a][k][c] = big;
+                    hi[a][k][c] = -big;
+                }
+        }
+        for(size_t j = begin; j < end; ++j)
+        {
+            const BuildPrim& prim = b.prims[j];
+            for(int a = 0; a < 3; ++a)
+            {
+                int k = binOf(prim.c[a], clo[a], scale[a], bins);
+                ++count[a][k];
+                for(int c = 0; c < 3; ++c)
+                {
+                    lo[a][k][c] = std::min(lo[a][k][c], prim.lo[c]);
+                    hi[a][k][c] = std::max(hi[a][k][c], prim.hi[c]);
+                }
+            }
+        }
+
+        T invParent = T(1) / halfArea(node.lo, node.hi);
+        for(int a = 0; a < 3; ++a)
+        {
+            if(!(chi[a] > clo[a]))
+                continue;
+
+            // right-to-left sweep for the areas of the upper sides
+            T rightArea[BVH_BINS];
+            size_t rightCount[BVH_BINS];
+            T rlo[3] = { big, big, big }, rhi[3] = { -big, -big, -big };
+            size_t rc = 0;
+            for(int k = bins - 1; k > 0; --k)
+            {
+                for(int c = 0; c < 3; ++c)
+                {
+                    rlo[c] = std::min(rlo[c], lo[a][k][c]);
+                    rhi[c] = std::max(rhi[c], hi[a][k][c]);
+                }
+                rc += count[a][k];
+                rightCount[k] = rc;
+                rightArea[k] = rc ? halfArea(rlo, rhi) : T(0);
+            }
+
+            T llo[3] = { big, big, big }, lhi[3] = { -big, -big, -big };
+            size_t lc = 0;
+            for(int k = 0; k + 1 < bins; ++k)
+            {
+                for(int c = 0; c < 3; ++c)
+                {
+                    llo[c] = std::min(llo[c], lo[a][k][c]);
+                    lhi[c] = std::max(lhi[c], hi[a][k][c]);
+                }
+                lc += count[a][k];
+                if(lc == 0 || rightCount[k + 1] == 0)
+                    continue;
+                // a traversal step costs one triangle test
+                T c = T(1) + (halfArea(llo, lhi)*T(lc) + rightArea[k + 1]*T(rightCount[k + 1]))*invParent;
+                if(c < cost)
+                {
+                    cost = c;
+                    axis = a;
+                    bin = k;
+                }
+            }
+        }
+    }
+
+    // renumbers the scratch slots in depth-first order
+    inline void flatten(const std::vector<BvhNode<T> >& slots)
+    {
+        nodes.reserve(slots.size());
+        std::vector<uint32_t> stack;
+        std::vector<std::pair<uint32_t, uint32_t> > fix; // (node, slot of its right child)
+        stack.push_back(0);
+        std::vector<uint32_t> remap(slots.size(), BVH_NONE);
+        while(!stack.empty())
+        {
+            uint32_t s = stack.back();
+            stack.pop_back();
+            remap[s] = uint32_t(nodes.size());
+            nodes.push_back(slots[s]);
+            if(slots[s].count == 0)
+            {
+                fix.push_back(std::make_pair(uint32_t(nodes.size() - 1), slots[s].offset));
+                stack.push_back(slots[s].offset);
+                stack.push_back(s + 1);
+            }
+        }
+        for(size_t i = 0; i < fix.size(); ++i)
+            nodes[fix[i].first].offset = remap[fix[i].second];
+    }
+
+    /*****************************************************/
+    /*                    Traversal                      */
+    /*****************************************************/
+    inline void traceBatch(const T* ox, const T* oy, const T* oz,
+                           const T* dx, const T* dy, const T* dz, size_t n, T tMax, bool anyHit,
+                           T* t, uint32_t* triangle, T* u, T* v, TaskScheduler& scheduler) const
+    {
+        parallelFor(n, 256, [&](size_t begin, size_t end)
+        {
+            traceRange(ox + begin, oy + begin, oz + begin, dx + begin, dy + begin, dz + begin,
+                       end - begin, tMax, anyHit, t + begin, triangle + begin,
+                       u ? u + begin : u, v ? v + begin : v);
+        }, scheduler);
+    }
+
+    inline void traceRange(const T* ox, const T* oy, const T* oz,
+                           const T* dx, const T* dy, const T* dz, size_t n, T tMax, bool anyHit,
+                           T* t, uint32_t* triangle, T* u, T* v) const
+    {
+        typedef Pack<T> P;
+        size_t i = 0;
+        for(; i + P::width <= n; i += P::width)
+            trace<P>(ox, oy, oz, dx, dy, dz, i, tMax, anyHit, t, triangle, u, v);
+        for(; i < n; ++i)
+            trace<ScalarPack<T> >(ox, oy, oz, dx, dy, dz, i, tMax, anyHit, t, triangle, u, v);
+    }
+
+    // traces the packet of rays [i, i + P::width)
+    template <class P>
+    inline void trace(const T* ox, const T* oy, const T* oz,
+                      const T* dx, const T* dy, const T* dz, size_t i, T tMax, bool anyHit,
+                      T* tOut, uint32_t* triangleOut, T* uOut, T* vOut) const
+    {
+        typedef typename P::Mask M;
+        const int all = (1 << P::width) - 1;
+        uint32_t hitTriangle[P::width];
+        for(int k = 0; k < P::width; ++k)
+            hitTriangle[k] = BVH_NONE;
+        P o[3] = { P::load(ox + i), P::load(oy + i), P::load(oz + i) };
+        P d[3] = { P::load(dx + i), P::load(dy + i), P::load(dz + i) };
+        P inv[3] = { P(1) / d[0], P(1) / d[1], P(1) / d[2] };
+        P tFar(tMax), hu(0), hv(0);
+        P zero(0), one(1), tiny(std::numeric_limits<T>::min());
+        int live = all;
+
+        // nearer child first along the packet's summed direction
+        bool negative[3];
+        for(int a = 0; a < 3; ++a)
+        {
+            T lanes[P::width], s = 0;
+            d[a].store(lanes);
+            for(int k = 0; k < P::width; ++k)
+                s += lanes[k];
+            negative[a] = s < 0;
+        }
+
+        uint32_t stack[STACK];
+        size_t top = 0;
+        if(!nodes.empty())
+            stack[top++] = 0;
+        while(top > 0 && live)
+        {
+            const BvhNode<T>& node = nodes[stack[--top]];
+            P tNear = zero, tExit = tFar;
+            for(int a = 0; a < 3; ++a)
+            {
+                P t0 = (P(node.lo[a]) - o[a])*inv[a];
+                P t1 = (P(node.hi[a]) - o[a])*inv[a];
+                tNear = max(tNear, min(t0, t1));
+                tExit = min(tExit, max(t0, t1));
+            }
+            if((bits(tNear <= tExit) & live) == 0)
+                continue;
+
+            if(node.count == 0)
+            {
+                uint32_t left = uint32_t(&node - nodes.data()) + 1;
+                if(negative[node.axis])
+                {
+                    stack[top++] = left;
+                    stack[top++] = node.offset;
+                }
+                else
+                {
+                    stack[top++] = node.offset;
+                    stack[top++] = left;
+                }
+                continue;
+            }
+
+            for(uint32_t j = node.offset; j < node.offset + node.count; ++j)
+            {
+                P e1[3] = { P(tri[3][j]), P(tri[4][j]), P(tri[5][j]) };
+                P e2[3] = { P(tri[6][j]), P(tri[7][j]), P(tri[8][j]) };
+                P p[3] = { fmsub(d[1], e2[2], d[2]*e2[1]),
+                           fmsub(d[2], e2[0], d[0]*e2[2]),
+                           fmsub(d[0], e2[1], d[1]*e2[0]) };
+                P det = fmadd(e1[0], p[0], fmadd(e1[1], p[1], e1[2]*p[2]));
+                P invDet = one / det;
+                P s[3] = { o[0] - P(tri[0][j]), o[1] - P(tri[1][j]), o[2] - P(tri[2][j]) };
+                P bu = fmadd(s[0], p[0], fmadd(s[1], p[1], s[2]*p[2]))*invDet;
+                P q[3] = { fmsub(s[1], e1[2], s[2]*e1[1]),
+                           fmsub(s[2], e1[0], s[0]*e1[2]),
+                           fmsub(s[0], e1[1], s[1]*e1[0]) };
+                P bv = fmadd(d[0], q[0], fmadd(d[1], q[1], d[2]*q[2]))*invDet;
+                P t = fmadd(e2[0], q[0], fmadd(e2[1], q[1], e2[2]*q[2]))*invDet;
+                M hit = (abs(det) > tiny) & (bu >= zero) & (bv >= zero) & (bu + bv <= one)
+                      & (t > zero) & (t < tFar);
+                int h = bits(hit) & live;
+                if(h == 0)
+                    continue;
+                tFar = select(hit, t, tFar);
+                hu = select(hit, bu, hu);
+                hv = select(hit, bv, hv);
+                for(int k = 0; k < P::width; ++k)
+                    if(h & (1 << k))
+                        hitTriangle[k] = ids[j];
+                if(anyHit)
+                {
+                    live &= ~h;
+                    if(!live)
+                        break;
+                }
+            }
+        }
+
+        tFar.store(tOut + i);
+        for(int k = 0; k < P::width; ++k)
+            triangleOut[i + k] = hitTriangle[k];
+        if(uOut)
+        {
+            hu.store(uOut + i);
+            hv.store(vOut + i);
+        }
+    }
+};
+
+#endif	/* BVH_H */
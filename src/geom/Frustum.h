@@ -0,0 +1,335 @@
+#ifndef FRUSTUM_H
+#define	FRUSTUM_H
+
+#include "../math/Mat4.h"
+#include "../math/Simd.h"
+#include "../math/Vector3.h"
+#include "../util/Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// view frustum culling of bounding spheres and axis-aligned boxes
+//
+// the six planes are read off a row-major view-projection matrix (column
+// vectors, clip = M * (x, y, z, 1); Gribb and Hartmann, "Fast Extraction of
+// Viewing Frustum Planes from the World-View-Projection Matrix", 2001) and
+// normalized, with the normals pointing inward. an object is culled only when
+// it lies entirely outside one plane, so the test is conservative: a few
+// objects near the frustum corners are kept although they are not visible.
+// infinite far projections and reverse-Z infinite projections are supported:
+// the plane at infinity comes out with a zero normal and is stored as one
+// every point is inside
+//
+// the batch tests read SoA bounds (sphere centers and radii, or box min and
+// max corners) Pack<T>::width objects at a time against all six planes and
+// append the indices of the survivors to a compact list, in index order. the
+// parallel versions let each chunk write its survivors in place and then
+// close the gaps in chunk order, so the list is the same for any thread count
+
+enum FrustumPlane
+{
+    FRUSTUM_LEFT,
+    FRUSTUM_RIGHT,
+    FRUSTUM_BOTTOM,
+    FRUSTUM_TOP,
+    FRUSTUM_NEAR,
+    FRUSTUM_FAR,
+    FRUSTUM_PLANES
+};
+
+// one step of each test at offset i: bit k of the result is set when object
+// i + k is at least partly inside
+template <class P, class T>
+inline int sphereVisibleStep(const P (*plane)[4], const T* x, const T* y, const T* z, const T* r, size_t i)
+{
+    P cx = P::load(x + i), cy = P::load(y + i), cz = P::load(z + i), nr = -P::load(r + i);
+    typename P::Mask in = fmadd(plane[0][0], cx, fmadd(plane[0][1], cy, fmadd(plane[0][2], cz, plane[0][3]))) >= nr;
+    for(int p = 1; p < FRUSTUM_PLANES; ++p)
+        in = in & (fmadd(plane[p][0], cx, fmadd(plane[p][1], cy, fmadd(plane[p][2], cz, plane[p][3]))) >= nr);
+    return bits(in);
+}
+
+// boxes are tested through their center c and half extent e: the box is
+// outside plane (n, w) when n.c + w < -|n|.e
+template <class P, class T>
+inline int boxVisibleStep(const P (*plane)[4], const P (*absNormal)[3],
+                          const T* lox, const T* loy, const T* loz,
+                          const T* hix, const T* hiy, const T* hiz, size_t i)
+{
+    P half(T(0.5));
+    P lx = P::load(lox + i), ly = P::load(loy + i), lz = P::load(loz + i);
+    P hx = P::load(hix + i), hy = P::load(hiy + i), hz = P::load(hiz + i);
+    P cx = (lx + hx)*half, cy = (ly + hy)*half, cz = (lz + hz)*half;
+    P ex = (hx - lx)*half, ey = (hy - ly)*half, ez = (hz - lz)*half;
+    typename P::Mask in = fmadd(plane[0][0], cx, fmadd(plane[0][1], cy, fmadd(plane[0][2], cz, plane[0][3])))
+                       >= -fmadd(absNormal[0][0], ex, fmadd(absNormal[0][1], ey, absNormal[0][2]*ez));
+    for(int p = 1; p < FRUSTUM_PLANES; ++p)
+        in = in & (fmadd(plane[p][0], cx, fmadd(plane[p][1], cy, fmadd(plane[p][2], cz, plane[p][3])))
+                   >= -fmadd(absNormal[p][0], ex, fmadd(absNormal[p][1], ey, absNormal[p][2]*ez)));
+    return bits(in);
+}
+
+// appends base + k for every set bit k of the Width-bit mask, in increasing
+// k. four objects at a time go through a table of set-bit positions with no
+// branches, writing four slots and advancing by the bit count, so out needs
+// room for one index per object (slots past the last survivor get overwritten)
+template <int Width>
+inline size_t appendVisible(int mask, size_t base, uint32_t* out, size_t count)
+{
+    static const uint8_t position[16][4] =
+    {
+        { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 1, 0, 0, 0 }, { 0, 1, 0, 0 },
+        { 2, 0, 0, 0 }, { 0, 2, 0, 0 }, { 1, 2, 0, 0 }, { 0, 1, 2, 0 },
+        { 3, 0, 0, 0 }, { 0, 3, 0, 0 }, { 1, 3, 0, 0 }, { 0, 1, 3, 0 },
+        { 2, 3, 0, 0 }, { 0, 2, 3, 0 }, { 1, 2, 3, 0 }, { 0, 1, 2, 3 }
+    };
+    static const uint8_t population[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+    if(mask == 0)
+        return count;
+    if(Width < 4)
+    {
+        for(int k = 0; k < Width; ++k)
+        {
+            out[count] = uint32_t(base + k);
+            count += (mask >> k) & 1;
+        }
+        return count;
+    }
+    for(int j = 0; j < Width; j += 4)
+    {
+        int m = (mask >> j) & 15;
+        uint32_t b = uint32_t(base + j);
+        out[count] = b + position[m][0];
+        out[count + 1] = b + position[m][1];
+        out[count + 2] = b + position[m][2];
+        out[count + 3] = b + position[m][3];
+        count += population[m];
+    }
+    return count;
+}
+
+template <class T = float>
+class Frustum
+{
+private:
+    T planes[FRUSTUM_PLANES][4]; // a, b, c, d with a x + b y + c z + d >= 0 inside
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    // default constructor (the clip cube of an identity view-projection)
+    Frustum()
+    {
+        setViewProjection(Mat4<T>().getData());
+    }
+
+    // zeroToOneDepth selects clip z in 0..1 (Direct3D, Vulkan, Metal) instead
+    // of -1..1 (OpenGL)
+    explicit Frustum(const Mat4<T>& viewProjection, bool zeroToOneDepth = false)
+    {
+        setViewProjection(viewProjection.getData(), zeroToOneDepth);
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // reads the planes off a row-major view-projection matrix
+    inline void setViewProjection(const T* m, bool zeroToOneDepth = false)
+    {
+        const T* w = m + 12;
+        for(int k = 0; k < 4; ++k)
+        {
+            planes[FRUSTUM_LEFT][k] = w[k] + m[k];
+            planes[FRUSTUM_RIGHT][k] = w[k] - m[k];
+            planes[FRUSTUM_BOTTOM][k] = w[k] + m[4 + k];
+            planes[FRUSTUM_TOP][k] = w[k] - m[4 + k];
+            planes[FRUSTUM_NEAR][k] = zeroToOneDepth ? m[8 + k] : w[k] + m[8 + k];
+            planes[FRUSTUM_FAR][k] = w[k] - m[8 + k];
+        }
+        for(int p = 0; p < FRUSTUM_PLANES; ++p)
+        {
+            T* q = planes[p];
+            T n2 = q[0]*q[0] + q[1]*q[1] + q[2]*q[2];
+            if(!(n2 > T(0)))
+            {
+                // a plane at infinity (infinite far, or the near plane of a
+                // reverse-Z infinite projection) never culls
+                q[0] = q[1] = q[2] = T(0);
+                q[3] = std::numeric_limits<T>::max();
+                continue;
+            }
+            T inv = T(1) / std::sqrt(n2);
+            for(int k = 0; k < 4; ++k)
+                q[k] *= inv;
+        }
+    }
+
+    // signed distance of (x, y, z) to plane p, positive inside
+    inline T distance(int p, T x, T y, T z) const
+    {
+        return planes[p][0]*x + planes[p][1]*y + planes[p][2]*z + planes[p][3];
+    }
+
+    template <class U>
+    inline bool containsPoint(const Vector3<T, U>& v) const
+    {
+        return intersectsSphere(v.getX(), v.getY(), v.getZ(), T(0));
+    }
+
+    inline bool intersectsSphere(T x, T y, T z, T r) const
+    {
+        for(int p = 0; p < FRUSTUM_PLANES; ++p)
+            if(distance(p, x, y, z) < -r)
+                return false;
+        return true;
+    }
+
+    inline bool intersectsBox(const T lo[3], const T hi[3]) const
+    {
+        for(int p = 0; p < FRUSTUM_PLANES; ++p)
+        {
+            const T* q = planes[p];
+            T e = std::fabs(q[0])*(hi[0] - lo[0]) + std::fabs(q[1])*(hi[1] - lo[1]) + std::fabs(q[2])*(hi[2] - lo[2]);
+            if(distance(p, (lo[0] + hi[0])/2, (lo[1] + hi[1])/2, (lo[2] + hi[2])/2) < -e/2)
+                return false;
+        }
+        return true;
+    }
+
+    // writes the indices of the spheres (x, y, z, r)[0, n) that are at least
+    // partly inside to visible (room for n indices) and returns their count
+    inline size_t cullSpheres(const T* x, const T* y, const T* z, const T* r, size_t n,
+                              uint32_t* visible) const
+    {
+        return cullSpheres(x, y, z, r, 0, n, visible);
+    }
+
+    // the same for boxes given by their min and max corners
+    inline size_t cullBoxes(const T* lox, const T* loy, const T* loz,
+                            const T* hix, const T* hiy, const T* hiz, size_t n,
+                            uint32_t* visible) const
+    {
+        return cullBoxes(lox, loy, loz, hix, hiy, hiz, 0, n, visible);
+    }
+
+    // cullSpheres with the objects split across the scheduler; visible is
+    // resized to the survivors (keep it between frames to reuse its storage)
+    inline void cullSpheres(const T* x, const T* y, const T* z, const T* r, size_t n,
+                            std::vector<uint32_t>& visible,
+                            TaskScheduler& scheduler = TaskScheduler::instance()) const
+    {
+        cullParallel(n, visible, scheduler, [&](size_t begin, size_t end, uint32_t* out)
+        {
+            return cullSpheres(x, y, z, r, begin, end, out);
+        });
+    }
+
+    inline void cullBoxes(const T* lox, const T* loy, const T* loz,
+                          const T* hix, const T* hiy, const T* hiz, size_t n,
+                          std::vector<uint32_t>& visible,
+                          TaskScheduler& scheduler = TaskScheduler::instance()) const
+    {
+        cullParallel(n, visible, scheduler, [&](size_t begin, size_t end, uint32_t* out)
+        {
+            return cullBoxes(lox, loy, loz, hix, hiy, hiz, begin, end, out);
+        });
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    // plane p as (a, b, c, d) with a unit inward normal
+    inline const T* getPlane(int p) const
+    {
+        return planes[p];
+    }
+
+private:
+    // objects [begin, end); the indices written are absolute
+    inline size_t cullSpheres(const T* x, const T* y, const T* z, const T* r,
+                              size_t begin, size_t end, uint32_t* visible) const
+    {
+        typedef Pack<T> P;
+        typedef ScalarPack<T> S;
+        P plane[FRUSTUM_PLANES][4];
+        S planeS[FRUSTUM_PLANES][4];
+        broadcast(plane, planeS);
+        size_t count = 0;
+        size_t i = begin;
+        for(; i + P::width <= end; i += P::width)
+            count = appendVisible<P::width>(sphereVisibleStep<P>(plane, x, y, z, r, i), i, visible, count);
+        for(; i < end; ++i)
+            count = appendVisible<1>(sphereVisibleStep<S>(planeS, x, y, z, r, i), i, visible, count);
+        return count;
+    }
+
+    inline size_t cullBoxes(const T* lox, const T* loy, const T* loz,
+                            const T* hix, const T* hiy, const T* hiz,
+                            size_t begin, size_t end, uint32_t* visible) const
+    {
+        typedef Pack<T> P;
+        typedef ScalarPack<T> S;
+        P plane[FRUSTUM_PLANES][4], absNormal[FRUSTUM_PLANES][3];
+        S planeS[FRUSTUM_PLANES][4], absNormalS[FRUSTUM_PLANES][3];
+        broadcast(plane, planeS);
+        for(int p = 0; p < FRUSTUM_PLANES; ++p)
+            for(int k = 0; k < 3; ++k)
+            {
+                absNormal[p][k] = P(std::fabs(planes[p][k]));
+                absNormalS[p][k] = S(std::fabs(planes[p][k]));
+            }
+        size_t count = 0;
+        size_t i = begin;
+        for(; i + P::width <= end; i += P::width)
+            count = appendVisible<P::width>(boxVisibleStep<P>(plane, absNormal, lox, loy, loz, hix, hiy, hiz, i),
+                                            i, visible, count);
+        for(; i < end; ++i)
+            count = appendVisible<1>(boxVisibleStep<S>(planeS, absNormalS, lox, loy, loz, hix, hiy, hiz, i),
+                                     i, visible, count);
+        return count;
+    }
+
+    template <class P, class S>
+    inline void broadcast(P (*plane)[4], S (*planeS)[4]) const
+    {
+        for(int p = 0; p < FRUSTUM_PLANES; ++p)
+            for(int k = 0; k < 4; ++k)
+            {
+                plane[p][k] = P(planes[p][k]);
+                planeS[p][k] = S(planes[p][k]);
+            }
+    }
+
+    // each chunk writes its survivors at its own offset in visible, then the
+    // runs are moved down in chunk order
+    template <class Cull>
+    static inline void cullParallel(size_t n, std::vector<uint32_t>& visible,
+                                    TaskScheduler& scheduler, const Cull& cull)
+    {
+        const size_t grain = parallelGrain<T>();
+        size_t chunks = (n + grain - 1) / grain;
+        std::vector<size_t> counts(chunks);
+        visible.resize(n);
+        uint32_t* out = visible.data();
+        parallelFor(n, grain, [&](size_t begin, size_t end)
+        {
+            counts[begin / grain] = cull(begin, end, out + begin);
+        }, scheduler);
+
+        size_t total = 0;
+        for(size_t c = 0; c < chunks; ++c)
+        {
+            if(total != c*grain)
+                std::copy(out + c*grain, out + c*grain + counts[c], out + total);
+            total += counts[c];
+        }
+        visible.resize(total);
+    }
+};
+
+#endif	/* FRUSTUM_H */
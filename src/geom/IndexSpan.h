@@ -0,0 +1,51 @@
+#ifndef INDEXSPAN_H
+#define	INDEXSPAN_H
+
+#include <cstddef>
+#include <cstdint>
+
+// non-owning view of a run of point indices, returned by the spatial queries
+// it points into a buffer owned by the caller (a query result or the index
+// itself), so it stays valid until that buffer is reused or freed
+struct IndexSpan
+{
+    const uint32_t* first;
+    size_t count;
+
+    inline constexpr IndexSpan() noexcept:
+    first(0), count(0)
+    {
+    }
+
+    inline constexpr IndexSpan(const uint32_t* first, size_t count) noexcept:
+    first(first), count(count)
+    {
+    }
+
+    inline constexpr const uint32_t* begin() const noexcept
+    {
+        return first;
+    }
+
+    inline constexpr const uint32_t* end() const noexcept
+    {
+        return first + count;
+    }
+
+    inline constexpr size_t size() const noexcept
+    {
+        return count;
+    }
+
+    inline constexpr bool empty() const noexcept
+    {
+        return count == 0;
+    }
+
+    inline constexpr uint32_t operator[](size_t i) const noexcept
+    {
+        return first[i];
+    }
+};
+
+#endif	/* INDEXSPAN_H */
@@ -0,0 +1,413 @@
+#ifndef KDTREE_H
+#define	KDTREE_H
+
+#include "IndexSpan.h"
+#include "../math/Vector3.h"
+#include "../math/Vector3Array.h"
+#include "../math/Vector3View.h"
+#include "../math/VectorKernels.h"
+#include "../util/Parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// k-d tree over a point buffer for k-nearest, radius and box queries
+//
+// the tree is balanced and implicit: every internal node splits its range at
+// the median of its widest axis, node i has children 2i+1 and 2i+2, and all
+// leaves sit at the same depth with at most leafSize points. the build
+// partitions an index array with nth_element, handing the upper half of
+// every large range to the TaskScheduler, then copies the points into leaf
+// order as x, y and z streams so each leaf is scanned with the SIMD
+// squaredDistToBatch kernel
+//
+// queries fill a caller-owned KdQueryResult and return an IndexSpan into it;
+// a result reused across queries only allocates while it grows, so steady-
+// state queries allocate nothing. spans hold indices into the original buffer.
+// ties in distance are broken by index, so results do not depend on the
+// thread count used for the build
+
+// reusable buffers for one query at a time
+template <class T = float>
+struct KdQueryResult
+{
+    std::vector<uint32_t> indices;
+    std::vector<T> dist2;                       // squared distances (knn and radius)
+    std::vector<std::pair<T, uint32_t> > heap;  // knn scratch
+
+    inline IndexSpan span() const
+    {
+        return IndexSpan(indices.data(), indices.size());
+    }
+};
+
+// index written by knnBatch when the tree has fewer than k points
+const uint32_t KD_NONE = 0xffffffffu;
+
+template <class T = float>
+class KdTree
+{
+private:
+    enum { MAX_LEAF = 64 };
+
+    std::vector<T> xs, ys, zs;      // points in leaf order
+    std::vector<uint32_t> ids;      // original index of each point in leaf order
+    std::vector<T> splits;          // split value of each internal node
+    std::vector<uint8_t> axes;      // split axis (0, 1, 2) of each internal node
+    size_t depth;
+    size_t leafSize;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    explicit KdTree(size_t leafSize = 16):
+    depth(0), leafSize(clampLeaf(leafSize))
+    {
+    }
+
+    KdTree(const T* x, const T* y, const T* z, size_t n, size_t leafSize = 16,
+           TaskScheduler& scheduler = TaskScheduler::instance()):
+    depth(0), leafSize(clampLeaf(leafSize))
+    {
+        build(x, y, z, n, scheduler);
+    }
+
+    template <class U>
+    KdTree(const Vector3Array<T, U>& points, size_t leafSize = 16,
+           TaskScheduler& scheduler = TaskScheduler::instance()):
+    depth(0), leafSize(clampLeaf(leafSize))
+    {
+        build(points.getXStream(), points.getYStream(), points.getZStream(), points.size(), scheduler);
+    }
+
+    template <class U>
+    KdTree(const Vector3View<T, U>& points, size_t leafSize = 16,
+           TaskScheduler& scheduler = TaskScheduler::instance()):
+    depth(0), leafSize(clampLeaf(leafSize))
+    {
+        build(points.getXStream(), points.getYStream(), points.getZStream(), points.size(), scheduler);
+    }
+
+    template <class U>
+    KdTree(const std::vector<Vector3<T, U> >& points, size_t leafSize = 16,
+           TaskScheduler& scheduler = TaskScheduler::instance()):
+    depth(0), leafSize(clampLeaf(leafSize))
+    {
+        Vector3Array<T, U> soa(points);
+        build(soa.getXStream(), soa.getYStream(), soa.getZStream(), soa.size(), scheduler);
+    }
+
+    /*****************************************************/
+    /*                      Build                        */
+    /*****************************************************/
+    // (re)builds the tree over n points (n < 2^32); the streams are copied
+    inline void build(const T* x, const T* y, const T* z, size_t n,
+                      TaskScheduler& scheduler = TaskScheduler::instance())
+    {
+        ids.resize(n);
+        for(size_t i = 0; i < n; ++i)
+            ids[i] = uint32_t(i);
+
+        depth = 0;
+        while(((n + (size_t(1) << depth) - 1) >> depth) > leafSize)
+            ++depth;
+        size_t internal = (size_t(1) << depth) - 1;
+        splits.assign(internal, T(0));
+        axes.assign(internal, 0);
+
+        const T* c[3] = { x, y, z };
+        std::atomic<size_t> pending(0);
+        buildNode(c, 0, 0, n, 0, pending, scheduler);
+        scheduler.wait(pending);
+
+        xs.resize(n);
+        ys.resize(n);
+        zs.resize(n);
+        parallelFor(n, parallelGrain<T>(), [&](size_t begin, size_t end)
+        {
+            for(size_t j = begin; j < end; ++j)
+            {
+                xs[j] = x[ids[j]];
+                ys[j] = y[ids[j]];
+                zs[j] = z[ids[j]];
+            }
+        }, scheduler);
+    }
+
+    /*****************************************************/
+    /*                     Queries                       */
+    /*****************************************************/
+    // the k points closest to q, nearest first (fewer when the tree is smaller);
+    // result.dist2 holds the matching squared distances
+    inline IndexSpan knn(const Vector3<T>& q, size_t k, KdQueryResult<T>& result) const
+    {
+        result.indices.clear();
+        result.dist2.clear();
+        result.heap.clear();
+        if(k == 0 || ids.empty())
+            return result.span();
+        if(result.heap.capacity() < k)
+            result.heap.reserve(k);
+
+        const T p[3] = { q.getX(), q.getY(), q.getZ() };
+        knnNode(p, k, 0, 0, ids.size(), 0, result.heap);
+
+        std::sort_heap(result.heap.begin(), result.heap.end());
+        for(size_t i = 0; i < result.heap.size(); ++i)
+        {
+            result.indices.push_back(result.heap[i].second);
+            result.dist2.push_back(result.heap[i].first);
+        }
+        return result.span();
+    }
+
+    // every point within distance r of q (inclusive), in tree order;
+    // result.dist2 holds the matching squared distances
+    inline IndexSpan radius(const Vector3<T>& q, T r, KdQueryResult<T>& result) const
+    {
+        result.indices.clear();
+        result.dist2.clear();
+        if(!ids.empty() && r >= 0)
+        {
+            const T p[3] = { q.getX(), q.getY(), q.getZ() };
+            radiusNode(p, r*r, 0, 0, ids.size(), 0, result);
+        }
+        return result.span();
+    }
+
+    // every point inside the axis-aligned box [lo, hi] (inclusive), in tree order
+    inline IndexSpan box(const Vector3<T>& lo, const Vector3<T>& hi, KdQueryResult<T>& result) const
+    {
+        result.indices.clear();
+        result.dist2.clear();
+        if(!ids.empty())
+        {
+            const T l[3] = { lo.getX(), lo.getY(), lo.getZ() };
+            const T h[3] = { hi.getX(), hi.getY(), hi.getZ() };
+            boxNode(l, h, 0, 0, ids.size(), 0, result);
+        }
+        return result.span();
+    }
+
+    /*****************************************************/
+    /*                  Batch Queries                    */
+    /*****************************************************/
+    // k nearest neighbors of m query points, in parallel: query i writes
+    // outIndices[i*k .. i*k + k) nearest first (padded with KD_NONE) and, when
+    // outDist2 is given, the squared distances (padded with infinity)
+    inline void knnBatch(const T* qx, const T* qy, const T* qz, size_t m, size_t k,
+                         uint32_t* outIndices, T* outDist2 = 0,
+                         TaskScheduler& scheduler = TaskScheduler::instance()) const
+    {
+        parallelFor(m, 256, [&](size_t begin, size_t end)
+        {
+            KdQueryResult<T> result;
+            for(size_t i = begin; i < end; ++i)
+            {
+                IndexSpan s = knn(Vector3<T>(qx[i], qy[i], qz[i]), k, result);
+                for(size_t j = 0; j < k; ++j)
+                {
+                    outIndices[i*k + j] = j < s.size() ? s[j] : KD_NONE;
+                    if(outDist2)
+                        outDist2[i*k + j] = j < s.size() ? result.dist2[j] : std::numeric_limits<T>::infinity();
+                }
+            }
+        }, scheduler);
+    }
+
+    // radius query for m points, in parallel; the neighbors of query i are
+    // indices[offsets[i] .. offsets[i + 1]) (offsets gets m + 1 entries)
+    inline void radiusBatch(const T* qx, const T* qy, const T* qz, size_t m, T r,
+                            std::vector<uint32_t>& indices, std::vector<size_t>& offsets,
+                            TaskScheduler& scheduler = TaskScheduler::instance()) const
+    {
+        parallelGather<KdQueryResult<T> >(m, 256, indices, offsets,
+            [&](size_t i, KdQueryResult<T>& result, std::vector<uint32_t>& out)
+            {
+                IndexSpan s = radius(Vector3<T>(qx[i], qy[i], qz[i]), r, result);
+                out.insert(out.end(), s.begin(), s.end());
+            }, scheduler);
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline size_t size() const
+    {
+        return ids.size();
+    }
+
+    inline bool empty() const
+    {
+        return ids.empty();
+    }
+
+    inline size_t getDepth() const
+    {
+        return depth;
+    }
+
+    inline size_t getLeafSize() const
+    {
+        return leafSize;
+    }
+
+private:
+    static inline size_t clampLeaf(size_t n)
+    {
+        return n < 1 ? 1 : (n > MAX_LEAF ? size_t(MAX_LEAF) : n);
+    }
+
+    // partitions ids[begin, end) around the median of its widest axis and
+    // recurses; large upper halves are built as scheduler tasks
+    inline void buildNode(const T* const* c, size_t node, size_t begin, size_t end, size_t level,
+                          std::atomic<size_t>& pending, TaskScheduler& scheduler)
+    {
+        while(level < depth)
+        {
+            T lo[3], hi[3];
+            for(int a = 0; a < 3; ++a)
+                lo[a] = hi[a] = begin < end ? c[a][ids[begin]] : T(0);
+            for(size_t j = begin; j < end; ++j)
+                for(int a = 0; a < 3; ++a)
+                {
+                    T v = c[a][ids[j]];
+                    lo[a] = v < lo[a] ? v : lo[a];
+                    hi[a] = v > hi[a] ? v : hi[a];
+                }
+            int axis = 0;
+            for(int a = 1; a < 3; ++a)
+                if(hi[a] - lo[a] > hi[axis] - lo[axis])
+                    axis = a;
+
+            size_t mid = begin + (end - begin)/2;
+            const T* v = c[axis];
+            if(begin < end)
+            {
+                std::nth_element(ids.begin() + begin, ids.begin() + mid, ids.begin() + end,
+                                 [v](uint32_t a, uint32_t b)
+                                 {
+                                     return v[a] < v[b] || (v[a] == v[b] && a < b);
+                                 });
+            }
+            splits[node] = mid < end ? v[ids[mid]] : hi[axis];
+            axes[node] = uint8_t(axis);
+
+            size_t right = 2*node + 2;
+            if(end - mid > 16384)
+            {
+                pending.fetch_add(1, std::memory_order_relaxed);
+                scheduler.spawn([this, c, right, mid, end, level, &pending, &scheduler]()
+                {
+                    buildNode(c, right, mid, end, level + 1, pending, scheduler);
+                    pending.fetch_sub(1, std::memory_order_release);
+                });
+            }
+            else
+                buildNode(c, right, mid, end, level + 1, pending, scheduler);
+
+            node = 2*node + 1;
+            end = mid;
+            ++level;
+        }
+    }
+
+    // squared distances from p to the points of leaf range [begin, end)
+    inline void leafDistances(const T* p, size_t begin, size_t end, T* d) const
+    {
+        squaredDistToBatch(xs.data() + begin, ys.data() + begin, zs.data() + begin,
+                           p[0], p[1], p[2], d, end - begin);
+    }
+
+    inline void knnNode(const T* p, size_t k, size_t node, size_t begin, size_t end, size_t level,
+                        std::vector<std::pair<T, uint32_t> >& heap) const
+    {
+        if(level == depth)
+        {
+            T d[MAX_LEAF];
+            leafDistances(p, begin, end, d);
+            for(size_t j = begin; j < end; ++j)
+            {
+                std::pair<T, uint32_t> e(d[j - begin], ids[j]);
+                if(heap.size() < k)
+                {
+                    heap.push_back(e);
+                    std::push_heap(heap.begin(), heap.end());
+                }
+                else if(e < heap.front())
+                {
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.back() = e;
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+            return;
+        }
+
+        size_t mid = begin + (end - begin)/2;
+        T diff = p[axes[node]] - splits[node];
+        bool left = diff < 0;
+        if(left)
+            knnNode(p, k, 2*node + 1, begin, mid, level + 1, heap);
+        else
+            knnNode(p, k, 2*node + 2, mid, end, level + 1, heap);
+        if(heap.size() < k || diff*diff <= heap.front().first)
+        {
+            if(left)
+                knnNode(p, k, 2*node + 2, mid, end, level + 1, heap);
+            else
+                knnNode(p, k, 2*node + 1, begin, mid, level + 1, heap);
+        }
+    }
+
+    inline void radiusNode(const T* p, T r2, size_t node, size_t begin, size_t end, size_t level,
+                           KdQueryResult<T>& result) const
+    {
+        if(level == depth)
+        {
+            T d[MAX_LEAF];
+            leafDistances(p, begin, end, d);
+            for(size_t j = begin; j < end; ++j)
+                if(d[j - begin] <= r2)
+                {
+                    result.indices.push_back(ids[j]);
+                    result.dist2.push_back(d[j - begin]);
+                }
+            return;
+        }
+
+        size_t mid = begin + (end - begin)/2;
+        T diff = p[axes[node]] - splits[node];
+        if(diff <= 0 || diff*diff <= r2)
+            radiusNode(p, r2, 2*node + 1, begin, mid, level + 1, result);
+        if(diff >= 0 || diff*diff <= r2)
+            radiusNode(p, r2, 2*node + 2, mid, end, level + 1, result);
+    }
+
+    inline void boxNode(const T* lo, const T* hi, size_t node, size_t begin, size_t end, size_t level,
+                        KdQueryResult<T>& result) const
+    {
+        if(level == depth)
+        {
+            for(size_t j = begin; j < end; ++j)
+                if(xs[j] >= lo[0] && xs[j] <= hi[0] &&
+                   ys[j] >= lo[1] && ys[j] <= hi[1] &&
+                   zs[j] >= lo[2] && zs[j] <= hi[2])
+                    result.indices.push_back(ids[j]);
+            return;
+        }
+
+        size_t mid = begin + (end - begin)/2;
+        int axis = axes[node];
+        if(lo[axis] <= splits[node])
+            boxNode(lo, hi, 2*node + 1, begin, mid, level + 1, result);
+        if(hi[axis] >= splits[node])
+            boxNode(lo, hi, 2*node + 2, mid, end, level + 1, result);
+    }
+};
+
+#endif	/* KDTREE_H */
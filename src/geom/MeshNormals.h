@@ -0,0 +1,246 @@
+#ifndef MESHNORMALS_H
+#define	MESHNORMALS_H
+
+#include "../math/Simd.h"
+#include "../math/VectorKernels.h"
+#include "../util/Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// smooth vertex normals of an indexed triangle mesh
+//
+// setTopology() builds a CSR adjacency once per index buffer: the corners
+// (3 t + c for corner c of triangle t) that reference vertex v are
+// corners[offsets[v], offsets[v + 1]), in triangle order. compute() then runs
+// two parallel passes per frame:
+//   faces:    the unnormalized cross product e1 x e2 of every triangle, staged
+//             in blocks of MESH_BLOCK and run through crossBatch; its length
+//             is twice the triangle's area, so summing these is area weighting
+//   vertices: every vertex sums the face normals of its own corners and is
+//             normalized in place
+// each vertex is written by exactly one task and sums its corners in a fixed
+// order, so there are no atomics and the result does not depend on the thread
+// count. with angleWeighted, every corner is weighted by its angle instead
+// (Thurmer and Wuthrich, 1998), which keeps normals from leaning toward
+// finely tessellated sides; the angles cost one atan2 per corner
+//
+// vertices no triangle references, or only degenerate ones, get a zero
+// normal. indices must be below the vertex count given to setTopology()
+
+const size_t MESH_BLOCK = 256;
+
+template <class P, class T>
+inline void normalizeOrZeroStep(T* x, T* y, T* z, size_t i)
+{
+    P vx = P::load(x + i), vy = P::load(y + i), vz = P::load(z + i);
+    P m2 = fmadd(vx, vx, fmadd(vy, vy, vz*vz));
+    typename P::Mask nonzero = m2 > P(0);
+    P inv = select(nonzero, P(1) / sqrt(select(nonzero, m2, P(1))), P(0));
+    (vx*inv).store(x + i);
+    (vy*inv).store(y + i);
+    (vz*inv).store(z + i);
+}
+
+// v[i] /= |v[i]|, leaving zero vectors at zero
+template <class T>
+inline void normalizeOrZeroBatch(T* x, T* y, T* z, size_t n)
+{
+    typedef Pack<T> P;
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+        normalizeOrZeroStep<P>(x, y, z, i);
+    for(; i < n; ++i)
+        normalizeOrZeroStep<ScalarPack<T> >(x, y, z, i);
+}
+
+template <class T = float>
+class MeshNormals
+{
+private:
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> offsets;      // vertices + 1 entries
+    std::vector<uint32_t> corners;
+    std::vector<T> fx, fy, fz;          // face normals of the last compute()
+    std::vector<T> weights;             // corner angles over |e1 x e2|
+    size_t vertices;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    MeshNormals():
+    vertices(0)
+    {
+    }
+
+    // triangle t has corners indices[3t], indices[3t + 1], indices[3t + 2]
+    MeshNormals(const uint32_t* indices, size_t triangles, size_t vertices):
+    vertices(0)
+    {
+        setTopology(indices, triangles, vertices);
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // copies the index buffer and builds the vertex-to-corner adjacency with a
+    // counting sort; only needed again when the indices change
+    inline void setTopology(const uint32_t* index, size_t triangles, size_t vertexCount)
+    {
+        vertices = vertexCount;
+        indices.assign(index, index + 3*triangles);
+        offsets.assign(vertices + 1, 0);
+        for(size_t k = 0; k < indices.size(); ++k)
+            ++offsets[indices[k] + 1];
+        for(size_t v = 0; v < vertices; ++v)
+            offsets[v + 1] += offsets[v];
+        corners.resize(indices.size());
+        std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+        for(size_t k = 0; k < indices.size(); ++k)
+            corners[cursor[indices[k]]++] = uint32_t(k);
+        fx.resize(triangles);
+        fy.resize(triangles);
+        fz.resize(triangles);
+    }
+
+    // unit normals of the vertices at (x, y, z) into (nx, ny, nz); both sets
+    // of streams hold getVertexCount() entries and must not overlap
+    inline void compute(const T* x, const T* y, const T* z, T* nx, T* ny, T* nz,
+                        bool angleWeighted = false,
+                        TaskScheduler& scheduler = TaskScheduler::instance())
+    {
+        const size_t triangles = getTriangleCount();
+        if(angleWeighted)
+            weights.resize(indices.size());
+        parallelFor(triangles, 16*MESH_BLOCK, [&](size_t begin, size_t end)
+        {
+            for(size_t t = begin; t < end; t += MESH_BLOCK)
+                faceBlock(x, y, z, t, std::min(end - t, MESH_BLOCK), angleWeighted);
+        }, scheduler);
+
+        const T* w = angleWeighted ? weights.data() : 0;
+        parallelFor(vertices, 16*MESH_BLOCK, [&](size_t begin, size_t end)
+        {
+            for(size_t v = begin; v < end; ++v)
+            {
+                T sx = 0, sy = 0, sz = 0;
+                for(uint32_t k = offsets[v]; k < offsets[v + 1]; ++k)
+                {
+                    uint32_t c = corners[k], t = c / 3;
+                    T s = w ? w[c] : T(1);
+                    sx += s*fx[t];
+                    sy += s*fy[t];
+                    sz += s*fz[t];
+                }
+                nx[v] = sx;
+                ny[v] = sy;
+                nz[v] = sz;
+            }
+            normalizeOrZeroBatch(nx + begin, ny + begin, nz + begin, end - begin);
+        }, scheduler);
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline size_t getVertexCount() const
+    {
+        return vertices;
+    }
+
+    inline size_t getTriangleCount() const
+    {
+        return indices.size() / 3;
+    }
+
+    // the corners of vertex v are getCorners()[getOffsets()[v] ..
+    // getOffsets()[v + 1]), each 3 t + c for corner c of triangle t
+    inline const uint32_t* getOffsets() const
+    {
+        return offsets.data();
+    }
+
+    inline const uint32_t* getCorners() const
+    {
+        return corners.data();
+    }
+
+    // e1 x e2 of each triangle as of the last compute(), twice its area long
+    inline const T* getFaceXStream() const
+    {
+        return fx.data();
+    }
+
+    inline const T* getFaceYStream() const
+    {
+        return fy.data();
+    }
+
+    inline const T* getFaceZStream() const
+    {
+        return fz.data();
+    }
+
+private:
+    // face normals (and corner weights) of triangles [t, t + n)
+    inline void faceBlock(const T* x, const T* y, const T* z, size_t t, size_t n, bool angleWeighted)
+    {
+        T ax[MESH_BLOCK], ay[MESH_BLOCK], az[MESH_BLOCK];
+        T bx[MESH_BLOCK], by[MESH_BLOCK], bz[MESH_BLOCK];
+        const uint32_t* tri = indices.data() + 3*t;
+        for(size_t i = 0; i < n; ++i)
+        {
+            uint32_t i0 = tri[3*i], i1 = tri[3*i + 1], i2 = tri[3*i + 2];
+            ax[i] = x[i1] - x[i0];
+            ay[i] = y[i1] - y[i0];
+            az[i] = z[i1] - z[i0];
+            bx[i] = x[i2] - x[i0];
+            by[i] = y[i2] - y[i0];
+            bz[i] = z[i2] - z[i0];
+        }
+        T* ox = fx.data() + t;
+        T* oy = fy.data() + t;
+        T* oz = fz.data() + t;
+        crossBatch(ax, ay, az, bx, by, bz, ox, oy, oz, n);
+        if(!angleWeighted)
+            return;
+
+        // the angle at each corner is atan2(|e x f|, e . f) for its two edges
+        // e and f; |e x f| is the same for all three corners
+        T* w = weights.data() + 3*t;
+        for(size_t i = 0; i < n; ++i)
+        {
+            T area2 = std::sqrt(ox[i]*ox[i] + oy[i]*oy[i] + oz[i]*oz[i]);
+            if(!(area2 > T(0)))
+            {
+                w[3*i] = w[3*i + 1] = w[3*i + 2] = T(0);
+                continue;
+            }
+            // e1 = v1 - v0, e2 = v2 - v0, e3 = v2 - v1
+            T cx = bx[i] - ax[i], cy = by[i] - ay[i], cz = bz[i] - az[i];
+            T d0 = ax[i]*bx[i] + ay[i]*by[i] + az[i]*bz[i];
+            T d1 = -(ax[i]*cx + ay[i]*cy + az[i]*cz);
+            T d2 = bx[i]*cx + by[i]*cy + bz[i]*cz;
+            w[3*i] = std::atan2(area2, d0) / area2;
+            w[3*i + 1] = std::atan2(area2, d1) / area2;
+            w[3*i + 2] = std::atan2(area2, d2) / area2;
+        }
+    }
+};
+
+// one-shot form: builds the adjacency and computes the normals; meshes whose
+// positions change every frame should keep a MeshNormals instead
+template <class T>
+inline void computeVertexNormals(const T* x, const T* y, const T* z, size_t vertices,
+                                 const uint32_t* indices, size_t triangles,
+                                 T* nx, T* ny, T* nz, bool angleWeighted = false,
+                                 TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    MeshNormals<T> normals(indices, triangles, vertices);
+    normals.compute(x, y, z, nx, ny, nz, angleWeighted, scheduler);
+}
+
+#endif	/* MESHNORMALS_H */
@@ -0,0 +1,258 @@
+#ifndef SPATIALHASH_H
+#define	SPATIALHASH_H
+
+#include "../math/Vector3.h"
+#include "../math/Vector3Array.h"
+#include "../math/VectorKernels.h"
+#include "../util/Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// uniform-grid spatial hash for points that move every frame
+//
+// space is cut into cubes of cellSize and every point is keyed on its
+// quantized cell, hashed into a power-of-two bucket table. the layout is a
+// counting sort: bucketStart[b] .. bucketStart[b + 1] is the run of bucket b
+// in the sorted index and position streams, so a cell is scanned as one
+// contiguous SoA block with squaredDistToBatch
+//
+// update() recomputes the keys in parallel and only re-sorts when some point
+// changed bucket; otherwise it just refreshes the sorted positions. the sort
+// is stable, so the layout and every query result depend only on the input.
+// buffers are reused between frames and grow only with the point count
+//
+// neighbor iteration visits the cells within a cell radius of the query cell;
+// each sorted point keeps its cell, so points of other cells sharing a bucket
+// are skipped and every point is reported exactly once. coordinates must
+// stay within 2^31 cells of the origin
+template <class T = float>
+class SpatialHash
+{
+private:
+    struct Cell
+    {
+        int32_t x, y, z;
+    };
+
+    enum { BLOCK = 256 };
+
+    T cellSize;
+    T invCell;
+    size_t fixedBuckets;            // 0 sizes the table from the point count
+    size_t mask;
+    std::vector<uint32_t> bucketStart;
+    std::vector<uint32_t> ids;      // original index of each sorted point
+    std::vector<T> xs, ys, zs;      // positions in sorted order
+    std::vector<Cell> cells;        // cell of each sorted point
+    std::vector<uint32_t> keys;     // bucket of each point in input order
+    std::vector<Cell> inputCells;   // cell of each point in input order
+    bool sorted;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    // buckets is rounded up to a power of two; 0 uses about 2 per point
+    explicit SpatialHash(T cellSize = T(1), size_t buckets = 0):
+    cellSize(cellSize), invCell(T(1) / cellSize), fixedBuckets(buckets), mask(0), sorted(false)
+    {
+    }
+
+    /*****************************************************/
+    /*                      Build                        */
+    /*****************************************************/
+    // rehashes n points (n < 2^32), re-sorting only when a point changed bucket;
+    // returns true when the layout was rebuilt
+    inline bool update(const T* x, const T* y, const T* z, size_t n,
+                       TaskScheduler& scheduler = TaskScheduler::instance())
+    {
+        size_t buckets = tableSize(n);
+        bool rebuild = !sorted || n != ids.size() || buckets != mask + 1;
+        mask = buckets - 1;
+        keys.resize(n);
+        inputCells.resize(n);
+
+        size_t moved = parallelReduce(n, parallelGrain<T>(), size_t(0), [&](size_t begin, size_t end)
+        {
+            size_t count = 0;
+            for(size_t i = begin; i < end; ++i)
+            {
+                Cell c = cellOf(x[i], y[i], z[i]);
+                uint32_t key = hash(c);
+                count += key != keys[i];
+                keys[i] = key;
+                inputCells[i] = c;
+            }
+            return count;
+        }, [](size_t a, size_t b) { return a + b; }, scheduler);
+
+        rebuild = rebuild || moved != 0;
+        if(rebuild)
+        {
+            // stable counting sort of the input order by bucket
+            bucketStart.assign(buckets + 1, 0);
+            for(size_t i = 0; i < n; ++i)
+                ++bucketStart[keys[i] + 1];
+            for(size_t b = 0; b < buckets; ++b)
+                bucketStart[b + 1] += bucketStart[b];
+            ids.resize(n);
+            for(size_t i = 0; i < n; ++i)
+                ids[bucketStart[keys[i]]++] = uint32_t(i);
+            for(size_t b = buckets; b > 0; --b)
+                bucketStart[b] = bucketStart[b - 1];
+            bucketStart[0] = 0;
+            sorted = true;
+        }
+
+        xs.resize(n);
+        ys.resize(n);
+        zs.resize(n);
+        cells.resize(n);
+        parallelFor(n, parallelGrain<T>(), [&](size_t begin, size_t end)
+        {
+            for(size_t j = begin; j < end; ++j)
+            {
+                uint32_t i = ids[j];
+                xs[j] = x[i];
+                ys[j] = y[i];
+                zs[j] = z[i];
+                cells[j] = inputCells[i];
+            }
+        }, scheduler);
+        return rebuild;
+    }
+
+    template <class U>
+    inline bool update(const Vector3Array<T, U>& points, TaskScheduler& scheduler = TaskScheduler::instance())
+    {
+        return update(points.getXStream(), points.getYStream(), points.getZStream(), points.size(), scheduler);
+    }
+
+    /*****************************************************/
+    /*                     Queries                       */
+    /*****************************************************/
+    // calls f(index) for every point in the cells within cellRadius cells of
+    // q's cell along each axis (a (2 cellRadius + 1)^3 block), unfiltered
+    template <class F>
+    inline void forEachInCells(const Vector3<T>& q, int cellRadius, F f) const
+    {
+        if(ids.empty())
+            return;
+        Cell c = cellOf(q.getX(), q.getY(), q.getZ());
+        for(int dz = -cellRadius; dz <= cellRadius; ++dz)
+            for(int dy = -cellRadius; dy <= cellRadius; ++dy)
+                for(int dx = -cellRadius; dx <= cellRadius; ++dx)
+                {
+                    Cell v = { c.x + dx, c.y + dy, c.z + dz };
+                    uint32_t b = hash(v);
+                    for(uint32_t j = bucketStart[b]; j < bucketStart[b + 1]; ++j)
+                        if(sameCell(cells[j], v))
+                            f(ids[j]);
+                }
+    }
+
+    // calls f(index, dist2) for every point within distance r of q (inclusive)
+    template <class F>
+    inline void forEachNeighbor(const Vector3<T>& q, T r, F f) const
+    {
+        if(ids.empty() || r < 0)
+            return;
+        const T px = q.getX(), py = q.getY(), pz = q.getZ(), r2 = r*r;
+        Cell c = cellOf(px, py, pz);
+        int reach = int(std::ceil(r*invCell));
+        T d[BLOCK];
+        for(int dz = -reach; dz <= reach; ++dz)
+            for(int dy = -reach; dy <= reach; ++dy)
+                for(int dx = -reach; dx <= reach; ++dx)
+                {
+                    Cell v = { c.x + dx, c.y + dy, c.z + dz };
+                    uint32_t b = hash(v);
+                    for(uint32_t j = bucketStart[b], end = bucketStart[b + 1]; j < end; j += BLOCK)
+                    {
+                        uint32_t m = end - j < BLOCK ? end - j : uint32_t(BLOCK);
+                        squaredDistToBatch(xs.data() + j, ys.data() + j, zs.data() + j, px, py, pz, d, m);
+                        for(uint32_t k = 0; k < m; ++k)
+                            if(d[k] <= r2 && sameCell(cells[j + k], v))
+                                f(ids[j + k], d[k]);
+                    }
+                }
+    }
+
+    // radius query for m points, in parallel; the neighbors of query i are
+    // indices[offsets[i] .. offsets[i + 1]) (offsets gets m + 1 entries)
+    inline void radiusBatch(const T* qx, const T* qy, const T* qz, size_t m, T r,
+                            std::vector<uint32_t>& indices, std::vector<size_t>& offsets,
+                            TaskScheduler& scheduler = TaskScheduler::instance()) const
+    {
+        parallelGather(m, 256, indices, offsets, [&](size_t i, std::vector<uint32_t>& out)
+        {
+            forEachNeighbor(Vector3<T>(qx[i], qy[i], qz[i]), r, [&out](uint32_t j, T)
+            {
+                out.push_back(j);
+            });
+        }, scheduler);
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline size_t size() const
+    {
+        return ids.size();
+    }
+
+    inline bool empty() const
+    {
+        return ids.empty();
+    }
+
+    inline T getCellSize() const
+    {
+        return cellSize;
+    }
+
+    // takes effect on the next update(), which then re-sorts
+    inline void setCellSize(T size)
+    {
+        cellSize = size;
+        invCell = T(1) / size;
+        sorted = false;
+    }
+
+    inline size_t getBucketCount() const
+    {
+        return mask + 1;
+    }
+
+private:
+    inline size_t tableSize(size_t n) const
+    {
+        size_t want = fixedBuckets ? fixedBuckets : 2*n;
+        size_t b = 64;
+        while(b < want)
+            b <<= 1;
+        return b;
+    }
+
+    inline Cell cellOf(T x, T y, T z) const
+    {
+        Cell c = { int32_t(std::floor(x*invCell)), int32_t(std::floor(y*invCell)), int32_t(std::floor(z*invCell)) };
+        return c;
+    }
+
+    static inline bool sameCell(const Cell& a, const Cell& b)
+    {
+        return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+
+    // the usual three-prime spatial hash
+    inline uint32_t hash(const Cell& c) const
+    {
+        uint32_t h = (uint32_t(c.x)*73856093u) ^ (uint32_t(c.y)*19349663u) ^ (uint32_t(c.z)*83492791u);
+        return uint32_t(h & mask);
+    }
+};
+
+#endif	/* SPATIALHASH_H */
@@ -0,0 +1,371 @@
+#ifndef VERTEXWELD_H
+#define	VERTEXWELD_H
+
+#include "../math/Vector3.h"
+#include "../math/Vector3Array.h"
+#include "../util/Parallel.h"
+#include "SpaceFillingCurve.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// vertex welding: merges vertices closer than a tolerance epsilon and
+// returns a remap table
+//
+// the welded vertices (representatives) are picked greedily in index order:
+// vertex i is a representative when no earlier representative lies within
+// epsilon of it (Euclidean distance), and otherwise joins the lowest-index
+// one that does. so every vertex ends up within epsilon of the vertex it is
+// welded to, and the representatives are more than epsilon apart. an epsilon
+// of 0 merges only exactly equal vertices; vertices with a NaN coordinate
+// are then merged with their exact copies, and never with a positive epsilon
+//
+// vertices are first grouped into the cubes of a grid (cube side 4 epsilon,
+// or one cube per exact position) by a linear-probing hash table of vertex
+// indices, sized up front to a power of two of at least twice the vertex
+// count so probes stay short:
+//   insert:   every vertex claims the first empty slot of its probe sequence
+//             with a compare-and-swap, unless it meets a slot already holding
+//             a vertex of its cube; a slot then keeps the lowest index of its
+//             cube (an atomic min), and the slot found is kept per vertex
+//   merge:    (epsilon > 0) the vertices are sorted by slot so each cube
+//             lists its vertices in index order, and every vertex looks for
+//             representatives within epsilon in the cubes the ball around
+//             it touches (one to eight, 3.4 on average). a vertex that still has undecided
+//             earlier neighbours is retried in the next round; chunks walk
+//             their vertices in index order, so one thread needs a single
+//             round and more threads a few
+//   number:   a vertex that is its own representative (for epsilon 0, the
+//             first of its cube) is numbered by a prefix sum over chunks, and
+//             remap[i] is the number of i's representative
+// the representatives follow from the greedy rule alone, so the output
+// (unique vertices numbered in order of first occurrence) does not depend on
+// the thread count. memory is 4 bytes per table slot plus 4 per vertex beyond
+// the remap table, and about 40 more per vertex and 4 per slot for the merge;
+// vertex counts must stay below 2^31. the merge assumes epsilon is small
+// against the spacing of distinct vertices: a cube crowded with vertices
+// that are not welded makes every one of them scan the others
+
+const uint32_t WELD_EMPTY = 0xffffffffu;
+
+template <class T>
+class VertexWeld
+{
+private:
+    const T* x;
+    const T* y;
+    const T* z;
+    T epsilon;
+    T invCell;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    VertexWeld(const T* x, const T* y, const T* z, T epsilon):
+    x(x), y(y), z(z), epsilon(epsilon > T(0) ? epsilon : T(0)),
+    invCell(epsilon > T(0) ? T(0.25) / epsilon : T(0))
+    {
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // writes remap[i] for vertices [0, n) and returns the unique count
+    inline size_t run(size_t n, uint32_t* remap, TaskScheduler& scheduler) const
+    {
+        if(n == 0)
+            return 0;
+        size_t capacity = 1;
+        while(capacity < 2*n)
+            capacity <<= 1;
+        const size_t mask = capacity - 1;
+        std::unique_ptr<std::atomic<uint32_t>[]> table(new std::atomic<uint32_t>[capacity]);
+        std::vector<uint32_t> slot(n);
+        parallelFor(capacity, parallelGrain<uint32_t>(), [&](size_t begin, size_t end)
+        {
+            for(size_t s = begin; s < end; ++s)
+                table[s].store(WELD_EMPTY, std::memory_order_relaxed);
+        }, scheduler);
+
+        parallelFor(n, parallelGrain<T>(), [&](size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; ++i)
+            {
+                int64_t k[3] = { key(x[i]), key(y[i]), key(z[i]) };
+                size_t s = size_t(hashCoordinates(k[0], k[1], k[2])) & mask;
+                uint32_t id = uint32_t(i);
+                for(;;)
+                {
+                    uint32_t held = table[s].load(std::memory_order_relaxed);
+                    if(held == WELD_EMPTY)
+                    {
+                        if(table[s].compare_exchange_weak(held, id, std::memory_order_relaxed))
+                            break;
+                        if(held == WELD_EMPTY)
+                            continue;
+                    }
+                    if(equal(held, k))
+                    {
+                        while(held > id && !table[s].compare_exchange_weak(held, id, std::memory_order_relaxed))
+                        {
+                        }
+                        break;
+                    }
+                    s = (s + 1) & mask;
+                }
+                slot[i] = uint32_t(s);
+            }
+        }, scheduler);
+
+        if(epsilon == T(0))
+            return number(n, [&](size_t i) { return table[slot[i]].load(std::memory_order_relaxed); },
+                          remap, scheduler);
+        std::vector<uint32_t> rep(n);
+        merge(n, table.get(), mask, slot, rep.data(), scheduler);
+        return number(n, [&](size_t i) { return rep[i]; }, remap, scheduler);
+    }
+
+private:
+    inline int64_t key(T c) const
+    {
+        return quantizeCoordinate(c, invCell);
+    }
+
+    inline bool equal(uint32_t j, const int64_t* k) const
+    {
+        return key(x[j]) == k[0] && key(y[j]) == k[1] && key(z[j]) == k[2];
+    }
+
+    inline T distance2(uint32_t i, uint32_t j) const
+    {
+        T dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+        return dx*dx + dy*dy + dz*dz;
+    }
+
+    // the table slot of cube k, or WELD_EMPTY when no vertex lies in it
+    inline uint32_t find(const std::atomic<uint32_t>* table, size_t mask, const int64_t* k) const
+    {
+        size_t s = size_t(hashCoordinates(k[0], k[1], k[2])) & mask;
+        for(;;)
+        {
+            uint32_t held = table[s].load(std::memory_order_relaxed);
+            if(held == WELD_EMPTY)
+                return WELD_EMPTY;
+            if(equal(held, k))
+                return uint32_t(s);
+            s = (s + 1) & mask;
+        }
+    }
+
+    // rep[i] = the representative of vertex i under the greedy rule
+    inline void merge(size_t n, const std::atomic<uint32_t>* table, size_t mask,
+                      const std::vector<uint32_t>& slot, uint32_t* rep,
+                      TaskScheduler& scheduler) const
+    {
+        // the vertices of each cube, in index order: cube s holds
+        // member[first[s]] onwards for as long as cubeOf matches s
+        std::vector<uint64_t> cubeOf(slot.begin(), slot.end());
+        std::vector<uint32_t> member(n);
+        radixSort(cubeOf.data(), member.data(), n, scheduler);
+        std::vector<uint32_t> first(mask + 1);
+        parallelFor(n, parallelGrain<uint32_t>(), [&](size_t begin, size_t end)
+        {
+            for(size_t m = begin; m < end; ++m)
+                if(m == 0 || cubeOf[m] != cubeOf[m - 1])
+                    first[cubeOf[m]] = uint32_t(m);
+        }, scheduler);
+
+        std::unique_ptr<std::atomic<uint32_t>[]> decided(new std::atomic<uint32_t>[n]);
+        std::vector<uint32_t> pending(n), next(n);
+        parallelFor(n, parallelGrain<uint32_t>(), [&](size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; ++i)
+            {
+                decided[i].store(WELD_EMPTY, std::memory_order_relaxed);
+                pending[i] = uint32_t(i);
+            }
+        }, scheduler);
+
+        // reach covers the rounding of the distance test, so no neighbour
+        // that passes it lies outside the cubes searched
+        const T eps2 = epsilon*epsilon;
+        const T reach = epsilon + epsilon / T(1024);
+        const size_t grain = parallelGrain<uint32_t>();
+        size_t count = n;
+        while(count > 0)
+        {
+            const size_t chunks = (count + grain - 1) / grain;
+            std::vector<size_t> left(chunks + 1, 0);
+            parallelFor(chunks, 1, [&](size_t begin, size_t end)
+            {
+                for(size_t c = begin; c < end; ++c)
+                {
+                    size_t kept = c*grain;
+                    for(size_t p = c*grain; p < std::min(count, (c + 1)*grain); ++p)
+                    {
+                        uint32_t i = pending[p];
+                        uint32_t r = decide(i, table, mask, cubeOf, member, first, decided.get(),
+                                            eps2, reach);
+                        if(r == WELD_EMPTY)
+                            next[kept++] = i;
+                        else
+                            decided[i].store(r, std::memory_order_relaxed);
+                    }
+                    left[c + 1] = kept - c*grain;
+                }
+            }, scheduler);
+            for(size_t c = 0; c < chunks; ++c)
+                left[c + 1] += left[c];
+            for(size_t c = 0; c < chunks; ++c)
+                std::copy(next.begin() + c*grain, next.begin() + c*grain + (left[c + 1] - left[c]),
+                          pending.begin() + left[c]);
+            count = left[chunks];
+        }
+        parallelFor(n, parallelGrain<uint32_t>(), [&](size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; ++i)
+                rep[i] = decided[i].load(std::memory_order_relaxed);
+        }, scheduler);
+    }
+
+    // the representative of vertex i, or WELD_EMPTY while an earlier
+    // neighbour below the best representative found is still undecided
+    inline uint32_t decide(uint32_t i, const std::atomic<uint32_t>* table, size_t mask,
+                           const std::vector<uint64_t>& cubeOf, const std::vector<uint32_t>& member,
+                           const std::vector<uint32_t>& first, const std::atomic<uint32_t>* decided,
+                           T eps2, T reach) const
+    {
+        const T c[3] = { x[i], y[i], z[i] };
+        if(!(c[0] == c[0] && c[1] == c[1] && c[2] == c[2]))
+            return i;
+        int64_t lo[3], hi[3];
+        for(int a = 0; a < 3; ++a)
+        {
+            lo[a] = key(c[a] - reach);
+            hi[a] = key(c[a] + reach);
+        }
+        uint32_t best = i, blocked = i;
+        int64_t k[3];
+        for(k[0] = lo[0]; k[0] <= hi[0]; ++k[0])
+            for(k[1] = lo[1]; k[1] <= hi[1]; ++k[1])
+                for(k[2] = lo[2]; k[2] <= hi[2]; ++k[2])
+                {
+                    uint32_t s = find(table, mask, k);
+                    if(s == WELD_EMPTY)
+                        continue;
+                    for(size_t m = first[s]; m < member.size() && cubeOf[m] == s; ++m)
+                    {
+                        uint32_t j = member[m];
+                        if(j >= best)
+                            break;
+                        if(!(distance2(i, j) <= eps2))
+                            continue;
+                        uint32_t r = decided[j].load(std::memory_order_relaxed);
+                        if(r == j)
+                            best = j;
+                        else if(r == WELD_EMPTY)
+                            blocked = std::min(blocked, j);
+                    }
+                }
+        return blocked < best ? WELD_EMPTY : best;
+    }
+
+    // numbers the vertices that are their own representative in index order
+    // and points every vertex at the number of its representative
+    template <class F>
+    inline size_t number(size_t n, F representative, uint32_t* remap, TaskScheduler& scheduler) const
+    {
+        const size_t grain = parallelGrain<uint32_t>();
+        const size_t chunks = (n + grain - 1) / grain;
+        std::vector<size_t> start(chunks + 1, 0);
+        parallelFor(chunks, 1, [&](size_t begin, size_t end)
+        {
+            for(size_t c = begin; c < end; ++c)
+            {
+                size_t count = 0;
+                for(size_t i = c*grain; i < std::min(n, (c + 1)*grain); ++i)
+                    count += representative(i) == uint32_t(i);
+                start[c + 1] = count;
+            }
+        }, scheduler);
+        for(size_t c = 0; c < chunks; ++c)
+            start[c + 1] += start[c];
+
+        parallelFor(chunks, 1, [&](size_t begin, size_t end)
+        {
+            for(size_t c = begin; c < end; ++c)
+            {
+                uint32_t next = uint32_t(start[c]);
+                for(size_t i = c*grain; i < std::min(n, (c + 1)*grain); ++i)
+                    if(representative(i) == uint32_t(i))
+                        remap[i] = next++;
+            }
+        }, scheduler);
+        parallelFor(n, parallelGrain<uint32_t>(), [&](size_t begin, size_t end)
+        {
+            for(size_t i = begin; i < end; ++i)
+            {
+                uint32_t r = representative(i);
+                if(r != uint32_t(i))
+                    remap[i] = remap[r];
+            }
+        }, scheduler);
+        return start[chunks];
+    }
+};
+
+// welds the n vertices of the (x, y, z) streams: remap[i] is the new index
+// of vertex i, and the return value is the number of unique vertices
+template <class T>
+inline size_t weldVertices(const T* x, const T* y, const T* z, size_t n, T epsilon, uint32_t* remap,
+                           TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    return VertexWeld<T>(x, y, z, epsilon).run(n, remap, scheduler);
+}
+
+// welds vertices and fills welded (when given) with the first vertex of each
+// class, colors included
+template <class T, class U>
+inline size_t weldVertices(const Vector3Array<T, U>& vertices, T epsilon, std::vector<uint32_t>& remap,
+                           Vector3Array<T, U>* welded = 0,
+                           TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    const size_t n = vertices.size();
+    remap.resize(n);
+    size_t unique = weldVertices(vertices.getXStream(), vertices.getYStream(), vertices.getZStream(),
+                                 n, epsilon, remap.data(), scheduler);
+    if(welded)
+    {
+        // representatives are numbered in index order
+        *welded = Vector3Array<T, U>(unique, vertices.hasColor());
+        uint32_t next = 0;
+        for(size_t i = 0; i < n; ++i)
+            if(remap[i] == next)
+                welded->set(next++, vertices.get(i));
+    }
+    return unique;
+}
+
+template <class T, class U>
+inline size_t weldVertices(const std::vector<Vector3<T, U> >& vertices, T epsilon, std::vector<uint32_t>& remap,
+                           TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    return weldVertices(Vector3Array<T, U>(vertices), epsilon, remap, 0, scheduler);
+}
+
+// rewrites an index buffer through a remap table
+inline void remapIndices(uint32_t* indices, size_t count, const uint32_t* remap,
+                         TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    parallelFor(count, parallelGrain<uint32_t>(), [&](size_t begin, size_t end)
+    {
+        for(size_t k = begin; k < end; ++k)
+            indices[k] = remap[indices[k]];
+    }, scheduler);
+}
+
+#endif	/* VERTEXWELD_H */
@@ -0,0 +1,788 @@
+#ifndef MESHIMPORTER_H
+#define	MESHIMPORTER_H
+
+#include "../util/TaskScheduler.h"
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// streaming importer for PLY (ascii, binary little and big endian) and OBJ
+// vertex data
+//
+// the file is read in fixed-size chunks on the calling thread while earlier
+// chunks are parsed on the TaskScheduler, so I/O overlaps parsing; at most
+// chunksInFlight chunks (and their parsed batches) exist at once, so memory
+// stays bounded whatever the file size. each chunk is parsed straight into
+// structure-of-arrays streams and handed to a sink callback in file order
+//
+// the streams mirror the double-precision Vector3 in includes/math/Vector3.h:
+// positions x, y, z and normals nx, ny, nz of type T, colors r, g, b, a as
+// float in [0, 1] (integer PLY colors are divided by the type's maximum)
+//
+// PLY: only the vertex element is read (earlier elements are skipped, later
+// ones such as faces are never read); recognised properties are x, y, z,
+// nx, ny, nz and red, green, blue, alpha; missing alpha is 1
+// OBJ: "v x y z [w]" and "v x y z r g b [a]" lines fill positions and colors,
+// "vn" lines fill normals (so normalCount() may differ from size(), as OBJ
+// normals are indexed separately); a batch has colors when any of its
+// vertices has them, and the others get opaque white
+//
+// numbers are parsed with strtod, so the C locale is assumed. errors are
+// reported by returning false; getError() describes the failure
+
+// one parsed chunk of vertices in structure-of-arrays form; streams the file
+// does not provide are empty
+template <class T = double>
+struct VertexBatch
+{
+    std::vector<T> x, y, z;
+    std::vector<float> r, g, b, a;
+    std::vector<T> nx, ny, nz;
+
+    inline size_t size() const
+    {
+        return x.size();
+    }
+
+    inline size_t normalCount() const
+    {
+        return nx.size();
+    }
+
+    inline bool hasColor() const
+    {
+        return !r.empty();
+    }
+
+    inline bool hasNormals() const
+    {
+        return !nx.empty();
+    }
+
+    // empties every stream but keeps the capacity for the next chunk
+    inline void clear()
+    {
+        x.clear(); y.clear(); z.clear();
+        r.clear(); g.clear(); b.clear(); a.clear();
+        nx.clear(); ny.clear(); nz.clear();
+    }
+
+    // appends another batch (for callers that do want the whole file in memory);
+    // when only one side has colors the other side's vertices become opaque white
+    inline void append(const VertexBatch& o)
+    {
+        if(o.hasColor() && !hasColor())
+            padColor(size());
+        if(hasColor() && !o.hasColor())
+            padColor(o.size());
+        else
+        {
+            appendStream(r, o.r); appendStream(g, o.g); appendStream(b, o.b); appendStream(a, o.a);
+        }
+        appendStream(x, o.x); appendStream(y, o.y); appendStream(z, o.z);
+        appendStream(nx, o.nx); appendStream(ny, o.ny); appendStream(nz, o.nz);
+    }
+
+private:
+    inline void padColor(size_t n)
+    {
+        r.insert(r.end(), n, 1.0f);
+        g.insert(g.end(), n, 1.0f);
+        b.insert(b.end(), n, 1.0f);
+        a.insert(a.end(), n, 1.0f);
+    }
+
+    template <class S>
+    static inline void appendStream(std::vector<S>& to, const std::vector<S>& from)
+    {
+        to.insert(to.end(), from.begin(), from.end());
+    }
+};
+
+/*****************************************************/
+/*                   PLY Helpers                     */
+/*****************************************************/
+enum PlyType
+{
+    PLY_NONE, PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16,
+    PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64
+};
+
+// destination of a PLY property (or PLY_SKIP)
+enum PlyField
+{
+    PLY_SKIP = -1,
+    PLY_X, PLY_Y, PLY_Z, PLY_R, PLY_G, PLY_B, PLY_A, PLY_NX, PLY_NY, PLY_NZ,
+    PLY_FIELDS
+};
+
+inline PlyType plyType(const char* name)
+{
+    static const char* names[] = { "char", "uchar", "short", "ushort", "int", "uint", "float", "double" };
+    static const char* sized[] = { "int8", "uint8", "int16", "uint16", "int32", "uint32", "float32", "float64" };
+    for(int k = 0; k < 8; ++k)
+        if(std::strcmp(name, names[k]) == 0 || std::strcmp(name, sized[k]) == 0)
+            return PlyType(k + 1);
+    return PLY_NONE;
+}
+
+inline size_t plyTypeSize(PlyType t)
+{
+    static const size_t sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+    return sizes[t];
+}
+
+// scale that maps an integer color channel to [0, 1]
+inline double plyColorScale(PlyType t)
+{
+    switch(t)
+    {
+        case PLY_INT8: return 1.0/127;
+        case PLY_UINT8: return 1.0/255;
+        case PLY_INT16: return 1.0/32767;
+        case PLY_UINT16: return 1.0/65535;
+        case PLY_INT32: return 1.0/2147483647.0;
+        case PLY_UINT32: return 1.0/4294967295.0;
+        default: return 1.0;
+    }
+}
+
+inline PlyField plyField(const char* name)
+{
+    static const char* names[] = { "x", "y", "z", "red", "green", "blue", "alpha", "nx", "ny", "nz" };
+    for(int k = 0; k < PLY_FIELDS; ++k)
+        if(std::strcmp(name, names[k]) == 0)
+            return PlyField(k);
+    if(std::strcmp(name, "r") == 0) return PLY_R;
+    if(std::strcmp(name, "g") == 0) return PLY_G;
+    if(std::strcmp(name, "b") == 0) return PLY_B;
+    if(std::strcmp(name, "a") == 0) return PLY_A;
+    return PLY_SKIP;
+}
+
+// reads one binary PLY scalar, byte-swapping when the file's endianness
+// differs from the (little-endian) host
+inline double plyRead(const char* p, PlyType t, bool swap)
+{
+    char buf[8];
+    size_t n = plyTypeSize(t);
+    for(size_t k = 0; k < n; ++k)
+        buf[k] = swap ? p[n - 1 - k] : p[k];
+    switch(t)
+    {
+        case PLY_INT8: { int8_t v; std::memcpy(&v, buf, 1); return v; }
+        case PLY_UINT8: { uint8_t v; std::memcpy(&v, buf, 1); return v; }
+        case PLY_INT16: { int16_t v; std::memcpy(&v, buf, 2); return v; }
+        case PLY_UINT16: { uint16_t v; std::memcpy(&v, buf, 2); return v; }
+        case PLY_INT32: { int32_t v; std::memcpy(&v, buf, 4); return v; }
+        case PLY_UINT32: { uint32_t v; std::memcpy(&v, buf, 4); return v; }
+        case PLY_FLOAT32: { float v; std::memcpy(&v, buf, 4); return v; }
+        case PLY_FLOAT64: { double v; std::memcpy(&v, buf, 8); return v; }
+        default: return 0;
+    }
+}
+
+/*****************************************************/
+/*                     Importer                      */
+/*****************************************************/
+template <class T = double>
+class MeshImporter
+{
+public:
+    // receives each parsed batch in file order; return false to stop the import
+    typedef std::function<bool(const VertexBatch<T>&)> Sink;
+
+private:
+    enum Mode { PLY_ASCII, PLY_BINARY, OBJ_TEXT };
+
+    struct PlyProperty
+    {
+        PlyType type;
+        PlyField field;
+        size_t offset;
+    };
+
+    struct PlyElement
+    {
+        std::string name;
+        uint64_t count;
+        size_t bytes;
+        bool hasList;
+    };
+
+    // a chunk buffer and the batch parsed from it
+    struct Slot
+    {
+        std::vector<char> data;
+        size_t bytes;
+        VertexBatch<T> batch;
+        std::atomic<size_t> pending;
+        std::string error;
+
+        Slot(): bytes(0), pending(0) {}
+    };
+
+    size_t chunkBytes;
+    size_t chunksInFlight;
+    TaskScheduler& scheduler;
+    std::string error;
+
+    // layout of the PLY vertex element
+    std::vector<PlyProperty> properties;
+    size_t recordBytes;
+    bool swapBytes;
+    bool plyColor;
+    bool plyNormals;
+    uint64_t vertexCount;
+    uint64_t imported;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    // chunksInFlight = 0 allows two chunks per scheduler thread
+    explicit MeshImporter(size_t chunkBytes = 4 << 20, size_t chunksInFlight = 0,
+                          TaskScheduler& scheduler = TaskScheduler::instance()):
+    chunkBytes(chunkBytes < 4096 ? 4096 : chunkBytes),
+    chunksInFlight(chunksInFlight ? chunksInFlight : 2*scheduler.size()),
+    scheduler(scheduler),
+    recordBytes(0), swapBytes(false), plyColor(false), plyNormals(false),
+    vertexCount(0), imported(0)
+    {
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // imports path as PLY or OBJ, chosen by its extension
+    inline bool importFile(const char* path, const Sink& sink)
+    {
+        size_t len = std::strlen(path);
+        if(len >= 4 && endsWith(path, len, ".ply"))
+            return importPLY(path, sink);
+        if(len >= 4 && endsWith(path, len, ".obj"))
+            return importOBJ(path, sink);
+        return fail("unknown extension (expected .ply or .obj)");
+    }
+
+    inline bool importPLY(const char* path, const Sink& sink)
+    {
+        error.clear();
+        imported = 0;
+        FILE* f = std::fopen(path, "rb");
+        if(!f)
+            return fail("cannot open file");
+        Mode mode;
+        bool ok = readPLYHeader(f, mode) && run(f, mode, sink);
+        std::fclose(f);
+        if(ok && imported != vertexCount)
+            return fail("file has fewer vertices than its header declares");
+        return ok;
+    }
+
+    inline bool importOBJ(const char* path, const Sink& sink)
+    {
+        error.clear();
+        imported = 0;
+        FILE* f = std::fopen(path, "rb");
+        if(!f)
+            return fail("cannot open file");
+        bool ok = run(f, OBJ_TEXT, sink);
+        std::fclose(f);
+        return ok;
+    }
+
+    // imports the whole file into one batch (memory grows with the file)
+    inline bool importAll(const char* path, VertexBatch<T>& out)
+    {
+        out.clear();
+        return importFile(path, [&out](const VertexBatch<T>& b)
+        {
+            out.append(b);
+            return true;
+        });
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    // vertices delivered by the last import
+    inline uint64_t getImported() const
+    {
+        return imported;
+    }
+
+    inline const char* getError() const
+    {
+        return error.c_str();
+    }
+
+private:
+    /*****************************************************/
+    /*                     Pipeline                      */
+    /*****************************************************/
+    // reads chunks into a ring of slots, parses them as tasks and delivers
+    // them in order; a full ring makes the reader wait for the oldest chunk
+    inline bool run(FILE* f, Mode mode, const Sink& sink)
+    {
+        std::vector<std::unique_ptr<Slot> > slots;
+        for(size_t k = 0; k < chunksInFlight; ++k)
+            slots.push_back(std::unique_ptr<Slot>(new Slot()));
+
+        std::vector<char> carry;
+        uint64_t remaining = vertexCount;   // PLY vertices still to read
+        size_t head = 0, inFlight = 0;
+        bool ok = true, done = false;
+
+        while(ok && !done)
+        {
+            Slot& slot = *slots[(head + inFlight) % slots.size()];
+            if(inFlight == slots.size())
+            {
+                ok = deliver(*slots[head], sink);
+                head = (head + 1) % slots.size();
+                --inFlight;
+                continue;
+            }
+
+            if(mode == PLY_BINARY)
+                done = !readBinary(f, slot, remaining, ok);
+            else
+                done = !readText(f, slot, carry, mode == PLY_ASCII ? &remaining : 0, ok);
+            if(!ok || slot.bytes == 0)
+                break;
+
+            slot.error.clear();
+            slot.pending.store(1, std::memory_order_relaxed);
+            Slot* s = &slot;
+            scheduler.spawn([this, s, mode]()
+            {
+                parse(*s, mode);
+                s->pending.store(0, std::memory_order_release);
+            });
+            ++inFlight;
+        }
+
+        // deliver (or, after an error, just drain) what is still in flight
+        for(; inFlight > 0; --inFlight)
+        {
+            if(ok)
+                ok = deliver(*slots[head], sink);
+            else
+                scheduler.wait(slots[head]->pending);
+            head = (head + 1) % slots.size();
+        }
+        return ok;
+    }
+
+    inline bool deliver(Slot& slot, const Sink& sink)
+    {
+        scheduler.wait(slot.pending);
+        if(!slot.error.empty())
+            return fail(slot.error.c_str());
+        imported += slot.batch.size();
+        bool keepGoing = sink(slot.batch);
+        slot.batch.clear();
+        return keepGoing ? true : fail("import stopped by the sink");
+    }
+
+    // reads up to chunkBytes of whole lines (the partial last line is carried
+    // to the next chunk); for ascii PLY it also stops after the vertex lines.
+    // returns false when this is the last chunk
+    inline bool readText(FILE* f, Slot& slot, std::vector<char>& carry, uint64_t* lines, bool& ok)
+    {
+        slot.data.resize(carry.size() + chunkBytes + 1);
+        if(!carry.empty())
+            std::memcpy(&slot.data[0], &carry[0], carry.size());
+        size_t got = std::fread(&slot.data[carry.size()], 1, chunkBytes, f);
+        size_t total = carry.size() + got;
+        bool eof = got < chunkBytes;
+        carry.clear();
+
+        size_t cut = total;
+        if(!eof)
+        {
+            const char* nl = lastNewline(&slot.data[0], total);
+            if(!nl)
+            {
+                ok = fail("line longer than the chunk size");
+                return false;
+            }
+            cut = size_t(nl - &slot.data[0]) + 1;
+            carry.assign(slot.data.begin() + cut, slot.data.begin() + total);
+        }
+
+        bool more = !eof;
+        if(lines)
+        {
+            // stop after the declared number of vertex lines
+            const char* p = &slot.data[0];
+            const char* end = p + cut;
+            uint64_t counted = 0;
+            while(p < end && counted < *lines)
+            {
+                const char* nl = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+                p = nl ? nl + 1 : end;
+                ++counted;
+            }
+            *lines -= counted;
+            cut = size_t(p - &slot.data[0]);
+            if(*lines == 0)
+                more = false;
+        }
+
+        slot.data[cut] = 0;
+        slot.bytes = cut;
+        return more;
+    }
+
+    // reads whole binary records, at most chunkBytes worth
+    inline bool readBinary(FILE* f, Slot& slot, uint64_t& remaining, bool& ok)
+    {
+        uint64_t records = chunkBytes / recordBytes;
+        if(records == 0)
+            records = 1;
+        if(records > remaining)
+            records = remaining;
+        size_t bytes = size_t(records*recordBytes);
+        slot.data.resize(bytes + 1);
+        size_t got = bytes ? std::fread(&slot.data[0], 1, bytes, f) : 0;
+        if(got != bytes)
+        {
+            ok = fail("file has fewer vertices than its header declares");
+            return false;
+        }
+        remaining -= records;
+        slot.bytes = bytes;
+        return remaining > 0;
+    }
+
+    /*****************************************************/
+    /*                      Parsing                      */
+    /*****************************************************/
+    // runs on a scheduler thread; touches only the slot and the read-only layout
+    inline void parse(Slot& slot, Mode mode) const
+    {
+        VertexBatch<T>& out = slot.batch;
+        out.clear();
+        if(mode == PLY_BINARY)
+            parseBinary(slot.data.data(), slot.bytes, out);
+        else if(mode == PLY_ASCII)
+        {
+            if(!parseAsciiPLY(slot.data.data(), slot.bytes, out))
+                slot.error = "malformed ascii PLY vertex line";
+        }
+        else
+            parseOBJ(slot.data.data(), slot.bytes, out);
+    }
+
+    inline void emit(const double* v, VertexBatch<T>& out) const
+    {
+        out.x.push_back(T(v[PLY_X]));
+        out.y.push_back(T(v[PLY_Y]));
+        out.z.push_back(T(v[PLY_Z]));
+        if(plyColor)
+        {
+            out.r.push_back(float(v[PLY_R]));
+            out.g.push_back(float(v[PLY_G]));
+            out.b.push_back(float(v[PLY_B]));
+            out.a.push_back(float(v[PLY_A]));
+        }
+        if(plyNormals)
+        {
+            out.nx.push_back(T(v[PLY_NX]));
+            out.ny.push_back(T(v[PLY_NY]));
+            out.nz.push_back(T(v[PLY_NZ]));
+        }
+    }
+
+    inline void store(double* v, const PlyProperty& p, double value) const
+    {
+        if(p.field == PLY_SKIP)
+            return;
+        if(p.field >= PLY_R && p.field <= PLY_A)
+            value *= plyColorScale(p.type);
+        v[p.field] = value;
+    }
+
+    inline void parseBinary(const char* data, size_t bytes, VertexBatch<T>& out) const
+    {
+        double v[PLY_FIELDS] = {};
+        v[PLY_A] = 1;
+        for(size_t off = 0; off + recordBytes <= bytes; off += recordBytes)
+        {
+            for(size_t k = 0; k < properties.size(); ++k)
+            {
+                const PlyProperty& p = properties[k];
+                if(p.field != PLY_SKIP)
+                    store(v, p, plyRead(data + off + p.offset, p.type, swapBytes));
+            }
+            emit(v, out);
+        }
+    }
+
+    inline bool parseAsciiPLY(const char* data, size_t bytes, VertexBatch<T>& out) const
+    {
+        const char* p = data;
+        const char* end = data + bytes;
+        double v[PLY_FIELDS] = {};
+        v[PLY_A] = 1;
+        while(p < end)
+        {
+            p = skipSpace(p, end);
+            if(p == end)
+                break;
+            for(size_t k = 0; k < properties.size(); ++k)
+            {
+                char* q;
+                double value = std::strtod(p, &q);
+                if(q == p)
+                    return false;
+                p = q;
+                store(v, properties[k], value);
+            }
+            emit(v, out);
+            p = nextLine(p, end);
+        }
+        return true;
+    }
+
+    inline void parseOBJ(const char* data, size_t bytes, VertexBatch<T>& out) const
+    {
+        const char* p = data;
+        const char* end = data + bytes;
+        while(p < end)
+        {
+            p = skipBlank(p, end);
+            if(end - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+            {
+                double v[7];
+                int n = readNumbers(p + 2, end, v, 7);
+                if(n >= 3)
+                {
+                    out.x.push_back(T(v[0]));
+                    out.y.push_back(T(v[1]));
+                    out.z.push_back(T(v[2]));
+                    bool colored = n >= 6;
+                    if(colored && !out.hasColor())
+                    {
+                        // first colored vertex of the batch: earlier ones are white
+                        size_t before = out.size() - 1;
+                        out.r.assign(before, 1.0f);
+                        out.g.assign(before, 1.0f);
+                        out.b.assign(before, 1.0f);
+                        out.a.assign(before, 1.0f);
+                    }
+                    if(colored || out.hasColor())
+                    {
+                        out.r.push_back(colored ? float(v[3]) : 1.0f);
+                        out.g.push_back(colored ? float(v[4]) : 1.0f);
+                        out.b.push_back(colored ? float(v[5]) : 1.0f);
+                        out.a.push_back(n >= 7 ? float(v[6]) : 1.0f);
+                    }
+                }
+            }
+            else if(end - p >= 3 && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+            {
+                double v[3];
+                if(readNumbers(p + 3, end, v, 3) == 3)
+                {
+                    out.nx.push_back(T(v[0]));
+                    out.ny.push_back(T(v[1]));
+                    out.nz.push_back(T(v[2]));
+                }
+            }
+            p = nextLine(p, end);
+        }
+    }
+
+    // parses up to max numbers from the rest of the line
+    static inline int readNumbers(const char* p, const char* end, double* v, int max)
+    {
+        int n = 0;
+        while(n < max)
+        {
+            p = skipBlank(p, end);
+            if(p == end || *p == '\n' || *p == '\r' || *p == '#')
+                break;
+            char* q;
+            v[n] = std::strtod(p, &q);
+            if(q == p)
+                break;
+            p = q;
+            ++n;
+        }
+        return n;
+    }
+
+    /*****************************************************/
+    /*                    PLY Header                     */
+    /*****************************************************/
+    inline bool readPLYHeader(FILE* f, Mode& mode)
+    {
+        char line[1024];
+        if(!std::fgets(line, sizeof(line), f) || std::strncmp(line, "ply", 3) != 0)
+            return fail("not a PLY file");
+
+        std::vector<PlyElement> elements;
+        std::vector<PlyProperty> vertexProps;
+        bool formatSeen = false;
+        mode = PLY_ASCII;
+        swapBytes = false;
+
+        while(std::fgets(line, sizeof(line), f))
+        {
+            char word[64] = "", a[64] = "", b[64] = "", c[64] = "";
+            int n = std::sscanf(line, "%63s %63s %63s %63s", word, a, b, c);
+            if(n <= 0)
+                continue;
+            if(std::strcmp(word, "end_header") == 0)
+            {
+                if(!formatSeen)
+                    return fail("PLY header has no format line");
+                return layoutVertices(f, mode, elements, vertexProps);
+            }
+            if(std::strcmp(word, "format") == 0 && n >= 2)
+            {
+                formatSeen = true;
+                if(std::strcmp(a, "ascii") == 0)
+                    mode = PLY_ASCII;
+                else if(std::strcmp(a, "binary_little_endian") == 0)
+                    mode = PLY_BINARY;
+                else if(std::strcmp(a, "binary_big_endian") == 0)
+                {
+                    mode = PLY_BINARY;
+                    swapBytes = true;
+                }
+                else
+                    return fail("unknown PLY format");
+            }
+            else if(std::strcmp(word, "element") == 0 && n >= 3)
+            {
+                PlyElement e = { a, std::strtoull(b, 0, 10), 0, false };
+                elements.push_back(e);
+            }
+            else if(std::strcmp(word, "property") == 0 && n >= 3 && !elements.empty())
+            {
+                PlyElement& e = elements.back();
+                if(std::strcmp(a, "list") == 0)
+                {
+                    e.hasList = true;
+                    continue;
+                }
+                PlyType t = plyType(a);
+                if(t == PLY_NONE)
+                    return fail("unknown PLY property type");
+                if(e.name == "vertex")
+                {
+                    PlyProperty p = { t, plyField(b), e.bytes };
+                    vertexProps.push_back(p);
+                }
+                e.bytes += plyTypeSize(t);
+            }
+        }
+        return fail("PLY header has no end_header");
+    }
+
+    // skips the elements stored before the vertex element and records the
+    // vertex layout
+    inline bool layoutVertices(FILE* f, Mode mode, const std::vector<PlyElement>& elements,
+                               const std::vector<PlyProperty>& vertexProps)
+    {
+        size_t k = 0;
+        for(; k < elements.size() && elements[k].name != "vertex"; ++k)
+        {
+            const PlyElement& e = elements[k];
+            if(mode == PLY_ASCII)
+            {
+                for(uint64_t i = 0; i < e.count; ++i)
+                    if(!skipLine(f))
+                        return fail("file ends inside a PLY element");
+            }
+            else if(e.hasList)
+                return fail("binary PLY with list elements before the vertex element");
+            else if(std::fseek(f, long(e.count*e.bytes), SEEK_CUR) != 0)
+                return fail("cannot skip PLY element");
+        }
+        if(k == elements.size())
+            return fail("PLY file has no vertex element");
+        if(elements[k].hasList)
+            return fail("list properties in the PLY vertex element are not supported");
+
+        properties = vertexProps;
+        recordBytes = elements[k].bytes;
+        vertexCount = elements[k].count;
+        bool fields[PLY_FIELDS] = {};
+        for(size_t i = 0; i < properties.size(); ++i)
+            if(properties[i].field != PLY_SKIP)
+                fields[properties[i].field] = true;
+        if(!fields[PLY_X] || !fields[PLY_Y] || !fields[PLY_Z])
+            return fail("PLY vertex element has no x, y, z");
+        plyColor = fields[PLY_R] && fields[PLY_G] && fields[PLY_B];
+        plyNormals = fields[PLY_NX] && fields[PLY_NY] && fields[PLY_NZ];
+        return true;
+    }
+
+    /*****************************************************/
+    /*                   Text Helpers                    */
+    /*****************************************************/
+    static inline const char* skipSpace(const char* p, const char* end)
+    {
+        while(p < end && std::isspace(static_cast<unsigned char>(*p)))
+            ++p;
+        return p;
+    }
+
+    static inline const char* skipBlank(const char* p, const char* end)
+    {
+        while(p < end && (*p == ' ' || *p == '\t'))
+            ++p;
+        return p;
+    }
+
+    static inline const char* nextLine(const char* p, const char* end)
+    {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+        return nl ? nl + 1 : end;
+    }
+
+    static inline const char* lastNewline(const char* p, size_t n)
+    {
+        for(size_t i = n; i > 0; --i)
+            if(p[i - 1] == '\n')
+                return p + i - 1;
+        return 0;
+    }
+
+    static inline bool skipLine(FILE* f)
+    {
+        int ch;
+        while((ch = std::fgetc(f)) != EOF)
+            if(ch == '\n')
+                return true;
+        return false;
+    }
+
+    static inline bool endsWith(const char* s, size_t len, const char* ext)
+    {
+        for(size_t k = 0; k < 4; ++k)
+            if(std::tolower(static_cast<unsigned char>(s[len - 4 + k])) != ext[k])
+                return false;
+        return true;
+    }
+
+    inline bool fail(const char* what)
+    {
+        if(error.empty())
+            error = what;
+        return false;
+    }
+};
+
+#endif	/* MESHIMPORTER_H */
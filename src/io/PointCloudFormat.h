@@ -0,0 +1,103 @@
+#ifndef POINTCLOUDFORMAT_H
+#define	POINTCLOUDFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// binary point-cloud file layout (little-endian, version 1)
+//
+//   offset 0     PointCloudHeader (64 bytes)
+//   offset 64    PointCloudSection table (sectionCount entries of 24 bytes)
+//   ...          sections, each starting on a POINTCLOUD_ALIGN boundary
+//
+// positions and normals are stored as separate x, y and z sections of float or
+// double (structure of arrays, like Vector3Array), colors as one interleaved
+// RGBA8 section; a reader maps the file and hands out the sections in place.
+// sections are 64-byte aligned so aligned SIMD loads (up to AVX-512) are legal
+// at the start of every stream
+//
+// compatibility: readers reject a different major version and ignore section
+// kinds they do not know, so new optional sections can be added in minor
+// versions without breaking old readers
+
+const char POINTCLOUD_MAGIC[8] = { 'P', 'C', 'L', 'O', 'U', 'D', 'S', 'A' };
+const uint16_t POINTCLOUD_VERSION_MAJOR = 1;
+const uint16_t POINTCLOUD_VERSION_MINOR = 0;
+const size_t POINTCLOUD_ALIGN = 64;
+
+// scalar type of the position and normal sections
+enum PointCloudScalar
+{
+    POINTCLOUD_FLOAT32 = 1,
+    POINTCLOUD_FLOAT64 = 2
+};
+
+// section kinds
+enum PointCloudSectionKind
+{
+    POINTCLOUD_POSITION_X = 1,
+    POINTCLOUD_POSITION_Y = 2,
+    POINTCLOUD_POSITION_Z = 3,
+    POINTCLOUD_COLOR_RGBA8 = 4,
+    POINTCLOUD_NORMAL_X = 5,
+    POINTCLOUD_NORMAL_Y = 6,
+    POINTCLOUD_NORMAL_Z = 7
+};
+
+struct PointCloudHeader
+{
+    char magic[8];
+    uint16_t versionMajor;
+    uint16_t versionMinor;
+    uint32_t scalar;        // PointCloudScalar
+    uint64_t count;         // number of points
+    uint32_t sectionCount;  // entries in the section table
+    uint32_t reserved0;
+    uint64_t fileBytes;     // total size, to detect truncated files
+    uint8_t reserved[24];
+};
+
+struct PointCloudSection
+{
+    uint32_t kind;          // PointCloudSectionKind
+    uint32_t reserved;
+    uint64_t offset;        // from the start of the file, POINTCLOUD_ALIGN aligned
+    uint64_t bytes;
+};
+
+static_assert(sizeof(PointCloudHeader) == 64, "PointCloudHeader is part of the file format");
+static_assert(sizeof(PointCloudSection) == 24, "PointCloudSection is part of the file format");
+
+// returns the scalar tag for float or double
+template <class T> struct PointCloudScalarOf;
+template <> struct PointCloudScalarOf<float> { enum { value = POINTCLOUD_FLOAT32 }; };
+template <> struct PointCloudScalarOf<double> { enum { value = POINTCLOUD_FLOAT64 }; };
+
+// rounds offset up to the next POINTCLOUD_ALIGN boundary
+inline uint64_t pointCloudAlign(uint64_t offset)
+{
+    return (offset + POINTCLOUD_ALIGN - 1) & ~uint64_t(POINTCLOUD_ALIGN - 1);
+}
+
+// whether kind is one of the per-point sections above (unknown kinds are
+// skipped by readers)
+inline bool pointCloudKnownKind(uint32_t kind)
+{
+    switch(kind)
+    {
+        case POINTCLOUD_POSITION_X: case POINTCLOUD_POSITION_Y: case POINTCLOUD_POSITION_Z:
+        case POINTCLOUD_COLOR_RGBA8:
+        case POINTCLOUD_NORMAL_X: case POINTCLOUD_NORMAL_Y: case POINTCLOUD_NORMAL_Z:
+            return true;
+        default: return false;
+    }
+}
+
+// bytes per point of a section kind for the given scalar size
+inline uint64_t pointCloudStride(uint32_t kind, uint64_t scalarBytes)
+{
+    return kind == POINTCLOUD_COLOR_RGBA8 ? 4 : scalarBytes;
+}
+
+#endif	/* POINTCLOUDFORMAT_H */
@@ -0,0 +1,221 @@
+#ifndef POINTCLOUDREADER_H
+#define	POINTCLOUDREADER_H
+
+#include "PointCloudFormat.h"
+#include "../math/Vector3View.h"
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// memory-mapped reader for the binary point-cloud format in PointCloudFormat.h
+// open() maps the file read-only and checks the header and section table;
+// positions(), normals() and colors() then point straight into the mapping,
+// so nothing is parsed or copied and pages are faulted in on first touch
+// (prefetch() asks the kernel to read the whole file ahead)
+//
+// views stay valid until close() or destruction. errors are reported by
+// returning false or an empty view; getError() describes the failure
+class PointCloudReader
+{
+private:
+    int fd;
+    const char* base;
+    size_t length;
+    const PointCloudHeader* header;
+    const PointCloudSection* table;
+    std::string error;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    PointCloudReader():
+    fd(-1), base(0), length(0), header(0), table(0)
+    {
+    }
+
+    PointCloudReader(const PointCloudReader&) = delete;
+    PointCloudReader& operator=(const PointCloudReader&) = delete;
+
+    ~PointCloudReader()
+    {
+        close();
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // maps path and validates it
+    inline bool open(const char* path)
+    {
+        close();
+        error.clear();
+        fd = ::open(path, O_RDONLY);
+        if(fd < 0)
+            return fail("cannot open", std::strerror(errno));
+
+        struct stat st;
+        if(::fstat(fd, &st) != 0)
+            return fail("cannot stat", std::strerror(errno));
+        length = size_t(st.st_size);
+        if(length < sizeof(PointCloudHeader))
+            return fail("file too small for a header", "");
+
+        void* p = ::mmap(0, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED)
+            return fail("mmap failed", std::strerror(errno));
+        base = static_cast<const char*>(p);
+        header = reinterpret_cast<const PointCloudHeader*>(base);
+        table = reinterpret_cast<const PointCloudSection*>(base + sizeof(PointCloudHeader));
+
+        if(std::memcmp(header->magic, POINTCLOUD_MAGIC, sizeof(POINTCLOUD_MAGIC)) != 0)
+            return fail("not a point-cloud file", "");
+        if(header->versionMajor != POINTCLOUD_VERSION_MAJOR)
+            return fail("unsupported major version", "");
+        if(header->scalar != POINTCLOUD_FLOAT32 && header->scalar != POINTCLOUD_FLOAT64)
+            return fail("unknown scalar type", "");
+        if(header->fileBytes > length)
+            return fail("file is truncated", "");
+        if(sizeof(PointCloudHeader) + uint64_t(header->sectionCount)*sizeof(PointCloudSection) > length)
+            return fail("section table past the end of the file", "");
+
+        // every point takes at least 4 bytes, which also keeps count*stride
+        // below 2^64 in the section checks
+        uint64_t scalarBytes = header->scalar == POINTCLOUD_FLOAT64 ? 8 : 4;
+        if(header->count > length / 4)
+            return fail("point count exceeds the file size", "");
+        for(uint32_t k = 0; k < header->sectionCount; ++k)
+        {
+            const PointCloudSection& s = table[k];
+            if(s.offset % POINTCLOUD_ALIGN != 0 || s.offset > length || s.bytes > length - s.offset)
+                return fail("section out of bounds or misaligned", "");
+            uint64_t stride = pointCloudStride(s.kind, scalarBytes);
+            // colors included: colors() hands out 4 bytes per point
+            if(pointCloudKnownKind(s.kind) &&
+               (s.bytes % stride != 0 || s.bytes / stride != header->count))
+                return fail("section size does not match the point count", "");
+        }
+        if(!section(POINTCLOUD_POSITION_X) || !section(POINTCLOUD_POSITION_Y) || !section(POINTCLOUD_POSITION_Z))
+            return fail("missing position sections", "");
+        return true;
+    }
+
+    // unmaps the file; views handed out before become invalid
+    inline void close()
+    {
+        if(base)
+            ::munmap(const_cast<char*>(base), length);
+        if(fd >= 0)
+            ::close(fd);
+        fd = -1;
+        base = 0;
+        length = 0;
+        header = 0;
+        table = 0;
+    }
+
+    // asks the kernel to start reading the whole file in the background
+    inline void prefetch() const
+    {
+        if(base)
+            ::madvise(const_cast<char*>(base), length, MADV_WILLNEED);
+    }
+
+    /*****************************************************/
+    /*                      Views                        */
+    /*****************************************************/
+    // positions as a view of T (empty when T is not the file's scalar type)
+    template <class T>
+    inline Vector3View<T> positions() const
+    {
+        return view<T>(POINTCLOUD_POSITION_X, POINTCLOUD_POSITION_Y, POINTCLOUD_POSITION_Z);
+    }
+
+    // normals as a view of T (empty when the file has none)
+    template <class T>
+    inline Vector3View<T> normals() const
+    {
+        return view<T>(POINTCLOUD_NORMAL_X, POINTCLOUD_NORMAL_Y, POINTCLOUD_NORMAL_Z);
+    }
+
+    // interleaved RGBA8 colors, 4 bytes per point (0 when the file has none)
+    inline const uint8_t* colors() const
+    {
+        const PointCloudSection* s = section(POINTCLOUD_COLOR_RGBA8);
+        return s ? reinterpret_cast<const uint8_t*>(base + s->offset) : 0;
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline bool isOpen() const
+    {
+        return header != 0;
+    }
+
+    inline uint64_t size() const
+    {
+        return header ? header->count : 0;
+    }
+
+    // POINTCLOUD_FLOAT32 or POINTCLOUD_FLOAT64
+    inline uint32_t getScalar() const
+    {
+        return header ? header->scalar : 0;
+    }
+
+    inline bool hasColor() const
+    {
+        return colors() != 0;
+    }
+
+    inline bool hasNormals() const
+    {
+        return section(POINTCLOUD_NORMAL_X) != 0;
+    }
+
+    inline const char* getError() const
+    {
+        return error.c_str();
+    }
+
+private:
+    // returns the first section of the given kind, or 0
+    inline const PointCloudSection* section(uint32_t kind) const
+    {
+        if(!header)
+            return 0;
+        for(uint32_t k = 0; k < header->sectionCount; ++k)
+            if(table[k].kind == kind)
+                return &table[k];
+        return 0;
+    }
+
+    template <class T>
+    inline Vector3View<T> view(uint32_t kx, uint32_t ky, uint32_t kz) const
+    {
+        const PointCloudSection* sx = section(kx);
+        const PointCloudSection* sy = section(ky);
+        const PointCloudSection* sz = section(kz);
+        if(!isOpen() || !sx || !sy || !sz || header->scalar != uint32_t(PointCloudScalarOf<T>::value))
+            return Vector3View<T>();
+        return Vector3View<T>(reinterpret_cast<const T*>(base + sx->offset),
+                              reinterpret_cast<const T*>(base + sy->offset),
+                              reinterpret_cast<const T*>(base + sz->offset),
+                              size_t(header->count));
+    }
+
+    // records the error and releases the file
+    inline bool fail(const char* what, const char* detail)
+    {
+        error = std::string(what) + (detail[0] ? std::string(": ") + detail : std::string());
+        close();
+        return false;
+    }
+};
+
+#endif	/* POINTCLOUDREADER_H */
@@ -0,0 +1,229 @@
+#ifndef POINTCLOUDWRITER_H
+#define	POINTCLOUDWRITER_H
+
+#include "PointCloudFormat.h"
+#include "../math/Vector3Array.h"
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+// streaming writer for the binary point-cloud format in PointCloudFormat.h
+// open() reserves every section for up to capacity points, and each write()
+// appends a batch to the end of every section with positioned writes, so a
+// cloud of any size is written in batches without being held in memory;
+// close() stores the final count in the header and trims the unused tail
+//
+// errors are reported by returning false; getError() describes the failure
+template <class T = float>
+class PointCloudWriter
+{
+private:
+    int fd;
+    uint64_t capacity;
+    uint64_t written;
+    bool color;
+    bool normals;
+    PointCloudSection sections[7];
+    uint32_t sectionCount;
+    std::string error;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    PointCloudWriter():
+    fd(-1), capacity(0), written(0), color(false), normals(false), sectionCount(0)
+    {
+    }
+
+    PointCloudWriter(const PointCloudWriter&) = delete;
+    PointCloudWriter& operator=(const PointCloudWriter&) = delete;
+
+    // closes the file (finishing it) if it is still open
+    ~PointCloudWriter()
+    {
+        close();
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // creates path for up to capacity points, with optional color and normal sections
+    inline bool open(const char* path, uint64_t capacity, bool withColor = false, bool withNormals = false)
+    {
+        close();
+        error.clear();
+        fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0)
+            return fail("cannot create", path);
+
+        this->capacity = capacity;
+        written = 0;
+        color = withColor;
+        normals = withNormals;
+        sectionCount = 0;
+
+        const uint32_t kinds[7] = { POINTCLOUD_POSITION_X, POINTCLOUD_POSITION_Y, POINTCLOUD_POSITION_Z,
+                                    POINTCLOUD_COLOR_RGBA8,
+                                    POINTCLOUD_NORMAL_X, POINTCLOUD_NORMAL_Y, POINTCLOUD_NORMAL_Z };
+        uint64_t offset = pointCloudAlign(sizeof(PointCloudHeader) + 7*sizeof(PointCloudSection));
+        for(int k = 0; k < 7; ++k)
+        {
+            if((kinds[k] == POINTCLOUD_COLOR_RGBA8 && !color) || (kinds[k] >= POINTCLOUD_NORMAL_X && !normals))
+                continue;
+            PointCloudSection& s = sections[sectionCount++];
+            s.kind = kinds[k];
+            s.reserved = 0;
+            s.offset = offset;
+            s.bytes = 0;
+            offset = pointCloudAlign(offset + capacity*pointCloudStride(s.kind, sizeof(T)));
+        }
+        // the header is written last, so a partial file never looks valid
+        return true;
+    }
+
+    // appends n points from separate x, y and z streams; rgba holds 4n bytes
+    // when the file has colors and nx, ny, nz the normals when it has normals
+    inline bool write(const T* x, const T* y, const T* z, size_t n,
+                      const uint8_t* rgba = 0,
+                      const T* nx = 0, const T* ny = 0, const T* nz = 0)
+    {
+        if(fd < 0)
+            return fail("write on a closed writer", "");
+        if(written + n > capacity)
+            return fail("more points than the capacity given to open", "");
+        if((color && !rgba) || (normals && !(nx && ny && nz)))
+            return fail("missing color or normal stream", "");
+
+        for(uint32_t k = 0; k < sectionCount; ++k)
+        {
+            const PointCloudSection& s = sections[k];
+            const void* src = 0;
+            switch(s.kind)
+            {
+                case POINTCLOUD_POSITION_X: src = x; break;
+                case POINTCLOUD_POSITION_Y: src = y; break;
+                case POINTCLOUD_POSITION_Z: src = z; break;
+                case POINTCLOUD_COLOR_RGBA8: src = rgba; break;
+                case POINTCLOUD_NORMAL_X: src = nx; break;
+                case POINTCLOUD_NORMAL_Y: src = ny; break;
+                case POINTCLOUD_NORMAL_Z: src = nz; break;
+            }
+            uint64_t stride = pointCloudStride(s.kind, sizeof(T));
+            if(!writeAt(src, n*stride, s.offset + written*stride))
+                return false;
+        }
+        written += n;
+        return true;
+    }
+
+    // appends every point of positions (and its colors, clamped to 0..255,
+    // when the file has colors) plus the matching normals when it has normals
+    template <class U>
+    inline bool write(const Vector3Array<T, U>& positions, const Vector3Array<T, U>* normalArray = 0)
+    {
+        size_t n = positions.size();
+        if(normals && (!normalArray || normalArray->size() != n))
+            return fail("normals must match the positions", "");
+        if(color && !positions.hasColor())
+            return fail("positions have no color stream", "");
+
+        // colors are converted a block at a time, positions go straight out
+        const size_t block = 4096;
+        uint8_t rgba[4*block];
+        for(size_t i = 0; i < n; i += block)
+        {
+            size_t b = n - i < block ? n - i : block;
+            if(color)
+            {
+                const U* src = positions.getRGBAStream() + 4*i;
+                for(size_t j = 0; j < 4*b; ++j)
+                    rgba[j] = uint8_t(src[j] < 0 ? 0 : (src[j] > 255 ? 255 : src[j]));
+            }
+            const T* nx = normalArray ? normalArray->getXStream() + i : 0;
+            const T* ny = normalArray ? normalArray->getYStream() + i : 0;
+            const T* nz = normalArray ? normalArray->getZStream() + i : 0;
+            if(!write(positions.getXStream() + i, positions.getYStream() + i, positions.getZStream() + i,
+                      b, color ? rgba : 0, nx, ny, nz))
+                return false;
+        }
+        return true;
+    }
+
+    // writes the section table and header and closes the file
+    inline bool close()
+    {
+        if(fd < 0)
+            return true;
+
+        uint64_t end = sizeof(PointCloudHeader) + sectionCount*sizeof(PointCloudSection);
+        for(uint32_t k = 0; k < sectionCount; ++k)
+        {
+            PointCloudSection& s = sections[k];
+            s.bytes = written*pointCloudStride(s.kind, sizeof(T));
+            end = s.offset + s.bytes;
+        }
+
+        PointCloudHeader h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, POINTCLOUD_MAGIC, sizeof(h.magic));
+        h.versionMajor = POINTCLOUD_VERSION_MAJOR;
+        h.versionMinor = POINTCLOUD_VERSION_MINOR;
+        h.scalar = PointCloudScalarOf<T>::value;
+        h.count = written;
+        h.sectionCount = sectionCount;
+        h.fileBytes = end;
+
+        bool ok = writeAt(sections, sectionCount*sizeof(PointCloudSection), sizeof(PointCloudHeader)) &&
+                  ::ftruncate(fd, off_t(end)) == 0 &&
+                  writeAt(&h, sizeof(h), 0);
+        if(!ok && error.empty())
+            fail("cannot finish", "");
+        if(::close(fd) != 0 && ok)
+            ok = fail("cannot close", "");
+        fd = -1;
+        return ok;
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline uint64_t getCount() const
+    {
+        return written;
+    }
+
+    inline const char* getError() const
+    {
+        return error.c_str();
+    }
+
+private:
+    // writes all of bytes at offset, retrying short writes
+    inline bool writeAt(const void* src, uint64_t bytes, uint64_t offset)
+    {
+        const char* p = static_cast<const char*>(src);
+        while(bytes > 0)
+        {
+            ssize_t r = ::pwrite(fd, p, bytes, off_t(offset));
+            if(r < 0 && errno == EINTR)
+                continue;
+            if(r <= 0)
+                return fail("write failed", std::strerror(errno));
+            p += r;
+            bytes -= uint64_t(r);
+            offset += uint64_t(r);
+        }
+        return true;
+    }
+
+    inline bool fail(const char* what, const char* detail)
+    {
+        error = std::string(what) + (detail[0] ? std::string(": ") + detail : std::string());
+        return false;
+    }
+};
+
+#endif	/* POINTCLOUDWRITER_H */
@@ -0,0 +1,166 @@
+#ifndef DUALQUAT_H
+#define	DUALQUAT_H
+
+#include "Quat.h"
+#include "Vector3.h"
+#include <cmath>
+#include <type_traits>
+
+// unit dual quaternion: a rotation followed by a translation, kept as a real
+// part (the rotation quaternion r) and a dual part d = t r / 2 for the
+// translation t. products compose rigid transforms like Quat::mult composes
+// rotations, and a weighted sum of dual quaternions renormalized by its real
+// part blends rigid transforms without the volume loss of blending matrices
+// (Kavan et al., "Geometric Skinning with Approximate Dual Quaternion
+// Blending", 2008); see Skinning.h for the batch blend
+template <class T = float>
+class DualQuat
+{
+private:
+    Quat<T> real;
+    Quat<T> dual;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    // default constructor (creates the identity transform)
+    inline constexpr DualQuat() noexcept:
+    real(), dual(0, 0, 0, 0)
+    {
+    }
+
+    // rotation (a unit quaternion) followed by the translation (tx, ty, tz)
+    inline constexpr DualQuat(const Quat<T>& rotation, T tx, T ty, T tz) noexcept:
+    real(rotation), dual(Quat<T>(tx/2, ty/2, tz/2, 0).mult(rotation))
+    {
+    }
+
+    template <class U>
+    inline constexpr DualQuat(const Quat<T>& rotation, const Vector3<T, U>& translation) noexcept:
+    DualQuat(rotation, translation.getX(), translation.getY(), translation.getZ())
+    {
+    }
+
+    // from raw real and dual parts
+    inline constexpr DualQuat(const Quat<T>& real, const Quat<T>& dual) noexcept:
+    real(real), dual(dual)
+    {
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // returns this * q (apply q first, then this)
+    inline constexpr DualQuat mult(const DualQuat& q) const noexcept
+    {
+        return DualQuat(real.mult(q.real), add(real.mult(q.dual), dual.mult(q.real)));
+    }
+
+    // returns the inverse transform (for a unit dual quaternion)
+    inline constexpr DualQuat conjugate() const noexcept
+    {
+        return DualQuat(real.conjugate(), dual.conjugate());
+    }
+
+    // rescales to a unit real part, as needed after blending
+    inline void normalize() noexcept
+    {
+        T m = T(1) / real.mag();
+        real = scale(real, m);
+        dual = scale(dual, m);
+    }
+
+    // applies the transform to a point: r p r* + t
+    template <class U>
+    inline constexpr Vector3<T, U> transformPoint(const Vector3<T, U>& p) const noexcept
+    {
+        Vector3<T, U> r = transformVector(p);
+        return Vector3<T, U>(r.getX() + translationX(), r.getY() + translationY(), r.getZ() + translationZ());
+    }
+
+    // applies only the rotation, for directions and normals
+    template <class U>
+    inline constexpr Vector3<T, U> transformVector(const Vector3<T, U>& v) const noexcept
+    {
+        T rx = real.getX(), ry = real.getY(), rz = real.getZ(), rw = real.getW();
+        T px = v.getX(), py = v.getY(), pz = v.getZ();
+        // v + 2 r x (r x v + w v)
+        T cx = ry*pz - rz*py + rw*px;
+        T cy = rz*px - rx*pz + rw*py;
+        T cz = rx*py - ry*px + rw*pz;
+        return Vector3<T, U>(px + 2*(ry*cz - rz*cy),
+                             py + 2*(rz*cx - rx*cz),
+                             pz + 2*(rx*cy - ry*cx));
+    }
+
+    // fills m with the top three rows of the row-major 4x4 affine matrix, the
+    // layout transformAffineBatch takes
+    inline constexpr void getMatrix(T m[12]) const noexcept
+    {
+        T r[9] = {};
+        real.getMatrix(r);
+        m[0] = r[0]; m[1] = r[1]; m[2] = r[2];  m[3] = translationX();
+        m[4] = r[3]; m[5] = r[4]; m[6] = r[5];  m[7] = translationY();
+        m[8] = r[6]; m[9] = r[7]; m[10] = r[8]; m[11] = translationZ();
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline constexpr const Quat<T>& getReal() const noexcept
+    {
+        return real;
+    }
+
+    inline constexpr const Quat<T>& getDual() const noexcept
+    {
+        return dual;
+    }
+
+    inline constexpr const Quat<T>& getRotation() const noexcept
+    {
+        return real;
+    }
+
+    // the translation, 2 d r*
+    template <class U = int>
+    inline constexpr Vector3<T, U> getTranslation() const noexcept
+    {
+        return Vector3<T, U>(translationX(), translationY(), translationZ());
+    }
+
+private:
+    static inline constexpr Quat<T> add(const Quat<T>& a, const Quat<T>& b) noexcept
+    {
+        return Quat<T>(a.getX() + b.getX(), a.getY() + b.getY(), a.getZ() + b.getZ(), a.getW() + b.getW());
+    }
+
+    static inline constexpr Quat<T> scale(const Quat<T>& a, T s) noexcept
+    {
+        return Quat<T>(a.getX()*s, a.getY()*s, a.getZ()*s, a.getW()*s);
+    }
+
+    // components of 2 (d r*): 2 (rw dv - dw rv + rv x dv)
+    inline constexpr T translationX() const noexcept
+    {
+        return 2*(real.getW()*dual.getX() - dual.getW()*real.getX() + real.getY()*dual.getZ() - real.getZ()*dual.getY());
+    }
+
+    inline constexpr T translationY() const noexcept
+    {
+        return 2*(real.getW()*dual.getY() - dual.getW()*real.getY() + real.getZ()*dual.getX() - real.getX()*dual.getZ());
+    }
+
+    inline constexpr T translationZ() const noexcept
+    {
+        return 2*(real.getW()*dual.getZ() - dual.getW()*real.getZ() + real.getX()*dual.getY() - real.getY()*dual.getX());
+    }
+};
+
+static_assert(std::is_trivially_copyable<DualQuat<> >::value,
+              "DualQuat must stay trivially copyable so bulk copies lower to memcpy");
+static_assert(sizeof(DualQuat<>) == 8*sizeof(float),
+              "the skinning kernels read DualQuat arrays as real xyzw followed by dual xyzw");
+
+#endif	/* DUALQUAT_H */
@@ -0,0 +1,198 @@
+#ifndef MAT3_H
+#define	MAT3_H
+
+#include "Vector3.h"
+#include "Quat.h"
+#include "VectorKernels.h"
+#include <cmath>
+#include <cstddef>
+
+// templated row-major 3x3 matrix class with default type float
+// used for rotations and scales; see Mat4 for transforms with a translation
+template <class T = float>
+class Mat3
+{
+private:
+    T m[9]; // m[3*row + col]
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    // default constructor (creates an identity matrix)
+    inline Mat3()
+    {
+        for(int i = 0; i < 9; ++i)
+            m[i] = (i % 4 == 0) ? T(1) : T(0);
+    }
+
+    // constructor for passing in all nine values, row by row
+    inline Mat3(T m00, T m01, T m02,
+                T m10, T m11, T m12,
+                T m20, T m21, T m22)
+    {
+        m[0] = m00; m[1] = m01; m[2] = m02;
+        m[3] = m10; m[4] = m11; m[5] = m12;
+        m[6] = m20; m[7] = m21; m[8] = m22;
+    }
+
+    // constructor for passing in a row-major array of nine values
+    inline explicit Mat3(const T* values)
+    {
+        for(int i = 0; i < 9; ++i)
+            m[i] = values[i];
+    }
+
+    // constructor converting a (unit) quaternion into its rotation matrix
+    inline explicit Mat3(const Quat<T>& q)
+    {
+        q.getMatrix(m);
+    }
+
+    // returns a scale matrix
+    static inline Mat3 scale(T sx, T sy, T sz)
+    {
+        return Mat3(sx, 0, 0,
+                    0, sy, 0,
+                    0, 0, sz);
+    }
+
+    // returns a rotation of theta radians around a unit axis (same matrix as Vector3::rotate)
+    static inline Mat3 rotation(T theta, const Vector3<T>& axis)
+    {
+        T ax = axis.getX(), ay = axis.getY(), az = axis.getZ();
+        T s = sin(theta);
+        T c = cos(theta);
+        T k = 1 - c;
+        return Mat3(c + k*ax*ax,    k*ax*ay - s*az, k*ax*az + s*ay,
+                    k*ax*ay + s*az, c + k*ay*ay,    k*ay*az - s*ax,
+                    k*ax*az - s*ay, k*ay*az + s*ax, c + k*az*az);
+    }
+
+    /*****************************************************/
+    /*              Member Overloaded Ops                */
+    /*****************************************************/
+    // overloaded operator() to get/set the element at row, col
+    inline T& operator()(int row, int col)
+    {
+        return m[3*row + col];
+    }
+
+    inline T operator()(int row, int col) const
+    {
+        return m[3*row + col];
+    }
+
+    // overloaded operator*= to compose with another matrix (this = this * rhs)
+    inline Mat3& operator*=(const Mat3& rhs)
+    {
+        *this = *this * rhs;
+        return *this;
+    }
+
+    // overloaded operator*= for scaling every element
+    inline Mat3& operator*=(T s)
+    {
+        for(int i = 0; i < 9; ++i)
+            m[i] *= s;
+        return *this;
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    inline Mat3 transpose() const
+    {
+        return Mat3(m[0], m[3], m[6],
+                    m[1], m[4], m[7],
+                    m[2], m[5], m[8]);
+    }
+
+    inline T determinant() const
+    {
+        return m[0]*(m[4]*m[8] - m[5]*m[7]) -
+               m[1]*(m[3]*m[8] - m[5]*m[6]) +
+               m[2]*(m[3]*m[7] - m[4]*m[6]);
+    }
+
+    // returns the inverse (the matrix must not be singular)
+    inline Mat3 inverse() const
+    {
+        T d = 1 / determinant();
+        return Mat3((m[4]*m[8] - m[5]*m[7])*d, (m[2]*m[7] - m[1]*m[8])*d, (m[1]*m[5] - m[2]*m[4])*d,
+                    (m[5]*m[6] - m[3]*m[8])*d, (m[0]*m[8] - m[2]*m[6])*d, (m[2]*m[3] - m[0]*m[5])*d,
+                    (m[3]*m[7] - m[4]*m[6])*d, (m[1]*m[6] - m[0]*m[7])*d, (m[0]*m[4] - m[1]*m[3])*d);
+    }
+
+    // returns the vector transformed by this matrix
+    inline Vector3<T> transform(const Vector3<T>& v) const
+    {
+        T x = v.getX(), y = v.getY(), z = v.getZ();
+        return Vector3<T>(m[0]*x + m[1]*y + m[2]*z,
+                          m[3]*x + m[4]*y + m[5]*z,
+                          m[6]*x + m[7]*y + m[8]*z);
+    }
+
+    // transforms n interleaved xyz vectors from in into out (which may be in)
+    inline void transformPoints(const T* in, T* out, size_t n) const
+    {
+        transform3x3Interleaved(m, in, out, n);
+    }
+
+    // transforms n vectors held in separate x, y and z streams
+    inline void transformPoints(const T* x, const T* y, const T* z,
+                                T* ox, T* oy, T* oz, size_t n) const
+    {
+        transform3x3Batch(m, x, y, z, ox, oy, oz, n);
+    }
+
+    // without a translation, points and directions transform the same way
+    inline void transformDirections(const T* in, T* out, size_t n) const
+    {
+        transform3x3Interleaved(m, in, out, n);
+    }
+
+    inline void transformDirections(const T* x, const T* y, const T* z,
+                                    T* ox, T* oy, T* oz, size_t n) const
+    {
+        transform3x3Batch(m, x, y, z, ox, oy, oz, n);
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    // returns the row-major array of nine values
+    inline const T* getData() const
+    {
+        return m;
+    }
+
+    inline T* getData()
+    {
+        return m;
+    }
+
+    /*****************************************************/
+    /*            Non-Member Ops & Functions             */
+    /*****************************************************/
+    // overloaded operator* to compose two matrices (rhs is applied first)
+    inline friend Mat3 operator*(const Mat3& lhs, const Mat3& rhs)
+    {
+        Mat3 r;
+        for(int row = 0; row < 3; ++row)
+            for(int col = 0; col < 3; ++col)
+                r.m[3*row + col] = lhs.m[3*row]*rhs.m[col] +
+                                   lhs.m[3*row + 1]*rhs.m[3 + col] +
+                                   lhs.m[3*row + 2]*rhs.m[6 + col];
+        return r;
+    }
+
+    // overloaded operator* to transform a vector
+    inline friend Vector3<T> operator*(const Mat3& lhs, const Vector3<T>& v)
+    {
+        return lhs.transform(v);
+    }
+};
+
+#endif	/* MAT3_H */
+
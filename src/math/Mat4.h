@@ -0,0 +1,253 @@
+#ifndef MAT4_H
+#define	MAT4_H
+
+#include "Vector3.h"
+#include "Quat.h"
+#include "Mat3.h"
+#include "VectorKernels.h"
+#include <cstddef>
+
+// templated row-major 4x4 matrix class with default type float
+// points are treated as (x, y, z, 1) column vectors, so a translate-rotate-scale
+// chain T * R * S composes into one matrix and is applied to a whole vertex
+// buffer in a single pass with transformPoints
+template <class T = float>
+class Mat4
+{
+private:
+    T m[16]; // m[4*row + col]
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    // default constructor (creates an identity matrix)
+    inline Mat4()
+    {
+        for(int i = 0; i < 16; ++i)
+            m[i] = (i % 5 == 0) ? T(1) : T(0);
+    }
+
+    // constructor for passing in all sixteen values, row by row
+    inline Mat4(T m00, T m01, T m02, T m03,
+                T m10, T m11, T m12, T m13,
+                T m20, T m21, T m22, T m23,
+                T m30, T m31, T m32, T m33)
+    {
+        m[0] = m00;  m[1] = m01;  m[2] = m02;  m[3] = m03;
+        m[4] = m10;  m[5] = m11;  m[6] = m12;  m[7] = m13;
+        m[8] = m20;  m[9] = m21;  m[10] = m22; m[11] = m23;
+        m[12] = m30; m[13] = m31; m[14] = m32; m[15] = m33;
+    }
+
+    // constructor for passing in a row-major array of sixteen values
+    inline explicit Mat4(const T* values)
+    {
+        for(int i = 0; i < 16; ++i)
+            m[i] = values[i];
+    }
+
+    // constructor for a 3x3 block (rotation/scale) with an optional translation
+    inline explicit Mat4(const Mat3<T>& r, const Vector3<T>& t = Vector3<T>())
+    {
+        for(int row = 0; row < 3; ++row)
+            for(int col = 0; col < 3; ++col)
+                m[4*row + col] = r(row, col);
+        m[3] = t.getX();
+        m[7] = t.getY();
+        m[11] = t.getZ();
+        m[12] = m[13] = m[14] = 0;
+        m[15] = 1;
+    }
+
+    // constructor converting a (unit) quaternion into its rotation matrix
+    inline explicit Mat4(const Quat<T>& q)
+    {
+        *this = Mat4(Mat3<T>(q));
+    }
+
+    // returns a translation matrix
+    static inline Mat4 translation(T tx, T ty, T tz)
+    {
+        return Mat4(1, 0, 0, tx,
+                    0, 1, 0, ty,
+                    0, 0, 1, tz,
+                    0, 0, 0, 1);
+    }
+
+    // returns a scale matrix
+    static inline Mat4 scale(T sx, T sy, T sz)
+    {
+        return Mat4(sx, 0, 0, 0,
+                    0, sy, 0, 0,
+                    0, 0, sz, 0,
+                    0, 0, 0, 1);
+    }
+
+    // returns the fused translate * rotate * scale matrix (scale is applied first)
+    static inline Mat4 trs(const Vector3<T>& t, const Quat<T>& q, const Vector3<T>& s)
+    {
+        T r[9];
+        q.getMatrix(r);
+        T sx = s.getX(), sy = s.getY(), sz = s.getZ();
+        return Mat4(r[0]*sx, r[1]*sy, r[2]*sz, t.getX(),
+                    r[3]*sx, r[4]*sy, r[5]*sz, t.getY(),
+                    r[6]*sx, r[7]*sy, r[8]*sz, t.getZ(),
+                    0, 0, 0, 1);
+    }
+
+    /*****************************************************/
+    /*              Member Overloaded Ops                */
+    /*****************************************************/
+    // overloaded operator() to get/set the element at row, col
+    inline T& operator()(int row, int col)
+    {
+        return m[4*row + col];
+    }
+
+    inline T operator()(int row, int col) const
+    {
+        return m[4*row + col];
+    }
+
+    // overloaded operator*= to compose with another matrix (this = this * rhs)
+    inline Mat4& operator*=(const Mat4& rhs)
+    {
+        *this = *this * rhs;
+        return *this;
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // true when the bottom row is (0, 0, 0, 1), i.e. no perspective divide is needed
+    inline bool isAffine() const
+    {
+        return m[12] == 0 && m[13] == 0 && m[14] == 0 && m[15] == 1;
+    }
+
+    inline Mat4 transpose() const
+    {
+        Mat4 r;
+        for(int row = 0; row < 4; ++row)
+            for(int col = 0; col < 4; ++col)
+                r.m[4*row + col] = m[4*col + row];
+        return r;
+    }
+
+    // returns the upper-left 3x3 block (rotation and scale)
+    inline Mat3<T> getMat3() const
+    {
+        return Mat3<T>(m[0], m[1], m[2],
+                       m[4], m[5], m[6],
+                       m[8], m[9], m[10]);
+    }
+
+    inline Vector3<T> getTranslation() const
+    {
+        return Vector3<T>(m[3], m[7], m[11]);
+    }
+
+    // returns the inverse of an affine matrix (the 3x3 block must not be singular)
+    inline Mat4 inverseAffine() const
+    {
+        Mat3<T> r = getMat3().inverse();
+        Vector3<T> t = r.transform(getTranslation());
+        return Mat4(r, -t);
+    }
+
+    // returns the point transformed by this matrix (divided by w if not affine)
+    inline Vector3<T> transformPoint(const Vector3<T>& v) const
+    {
+        T x = v.getX(), y = v.getY(), z = v.getZ();
+        T rx = m[0]*x + m[1]*y + m[2]*z + m[3];
+        T ry = m[4]*x + m[5]*y + m[6]*z + m[7];
+        T rz = m[8]*x + m[9]*y + m[10]*z + m[11];
+        if(isAffine())
+            return Vector3<T>(rx, ry, rz);
+        T rw = m[12]*x + m[13]*y + m[14]*z + m[15];
+        return Vector3<T>(rx/rw, ry/rw, rz/rw);
+    }
+
+    // returns the direction transformed by the 3x3 block (translation ignored)
+    inline Vector3<T> transformDirection(const Vector3<T>& v) const
+    {
+        T x = v.getX(), y = v.getY(), z = v.getZ();
+        return Vector3<T>(m[0]*x + m[1]*y + m[2]*z,
+                          m[4]*x + m[5]*y + m[6]*z,
+                          m[8]*x + m[9]*y + m[10]*z);
+    }
+
+    // transforms n interleaved xyz points from in into out (which may be in)
+    // in one pass; non-affine matrices also divide by w
+    inline void transformPoints(const T* in, T* out, size_t n) const
+    {
+        if(isAffine())
+            transformAffineInterleaved(m, in, out, n);
+        else
+            transformProjectiveInterleaved(m, in, out, n);
+    }
+
+    // transforms n points held in separate x, y and z streams
+    inline void transformPoints(const T* x, const T* y, const T* z,
+                                T* ox, T* oy, T* oz, size_t n) const
+    {
+        if(isAffine())
+            transformAffineBatch(m, x, y, z, ox, oy, oz, n);
+        else
+            transformProjectiveBatch(m, x, y, z, ox, oy, oz, n);
+    }
+
+    // transforms n interleaved xyz directions by the 3x3 block (translation ignored)
+    inline void transformDirections(const T* in, T* out, size_t n) const
+    {
+        T r[9] = {m[0], m[1], m[2], m[4], m[5], m[6], m[8], m[9], m[10]};
+        transform3x3Interleaved(r, in, out, n);
+    }
+
+    inline void transformDirections(const T* x, const T* y, const T* z,
+                                    T* ox, T* oy, T* oz, size_t n) const
+    {
+        T r[9] = {m[0], m[1], m[2], m[4], m[5], m[6], m[8], m[9], m[10]};
+        transform3x3Batch(r, x, y, z, ox, oy, oz, n);
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    // returns the row-major array of sixteen values
+    inline const T* getData() const
+    {
+        return m;
+    }
+
+    inline T* getData()
+    {
+        return m;
+    }
+
+    /*****************************************************/
+    /*            Non-Member Ops & Functions             */
+    /*****************************************************/
+    // overloaded operator* to compose two matrices (rhs is applied first)
+    inline friend Mat4 operator*(const Mat4& lhs, const Mat4& rhs)
+    {
+        Mat4 r;
+        for(int row = 0; row < 4; ++row)
+            for(int col = 0; col < 4; ++col)
+                r.m[4*row + col] = lhs.m[4*row]*rhs.m[col] +
+                                   lhs.m[4*row + 1]*rhs.m[4 + col] +
+                                   lhs.m[4*row + 2]*rhs.m[8 + col] +
+                                   lhs.m[4*row + 3]*rhs.m[12 + col];
+        return r;
+    }
+
+    // overloaded operator* to transform a point
+    inline friend Vector3<T> operator*(const Mat4& lhs, const Vector3<T>& v)
+    {
+        return lhs.transformPoint(v);
+    }
+};
+
+#endif	/* MAT4_H */
+
@@ -0,0 +1,285 @@
+#ifndef POINT3_H
+#define	POINT3_H
+
+#include "Vector3.h"
+#include "VectorKernels.h"
+#include "Precision.h"
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+// position-only 3D vector for large meshes and point clouds
+// Vector3 carries its color next to the coordinates (28 bytes for
+// Vector3<float, int>, over 100 for the double Vector3 with its duplicate
+// color and normal arrays); Point3 holds just xyz and leaves color and normal
+// to a separate VertexAttributes store, so passes that only touch positions
+// stream 3-6x less memory
+//
+// Padded (the default) adds a fourth lane kept at zero, making the point 16
+// bytes for float (one aligned SSE load, never straddling a cache line) and 32
+// for double; alignment stops at 16 bytes so std::vector and new still honor
+// it before C++17. Padded = false packs to 12 or 24 bytes for storage-bound data
+template <class T = float, bool Padded = true>
+class alignas(Padded ? 16 : sizeof(T)) Point3
+{
+private:
+    T xyz[Padded ? 4 : 3];
+
+public:
+    enum { stride = Padded ? 4 : 3 };   // scalars from one point to the next
+
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    // default constructor (creates a zero point)
+    inline constexpr Point3() noexcept:
+    xyz()
+    {
+    }
+
+    inline constexpr Point3(T x, T y, T z) noexcept:
+    xyz{ x, y, z }
+    {
+    }
+
+    // drops the color of v
+    template <class U>
+    inline constexpr explicit Point3(const Vector3<T, U>& v) noexcept:
+    xyz{ v.getX(), v.getY(), v.getZ() }
+    {
+    }
+
+    template <class U = int>
+    inline constexpr Vector3<T, U> toVector3() const noexcept
+    {
+        return Vector3<T, U>(xyz[0], xyz[1], xyz[2]);
+    }
+
+    /*****************************************************/
+    /*              Member Overloaded Ops                */
+    /*****************************************************/
+    inline constexpr Point3& operator+=(const Point3& p) noexcept
+    {
+        xyz[0] += p.xyz[0];
+        xyz[1] += p.xyz[1];
+        xyz[2] += p.xyz[2];
+        return *this;
+    }
+
+    inline constexpr Point3& operator-=(const Point3& p) noexcept
+    {
+        xyz[0] -= p.xyz[0];
+        xyz[1] -= p.xyz[1];
+        xyz[2] -= p.xyz[2];
+        return *this;
+    }
+
+    inline constexpr Point3& operator*=(T s) noexcept
+    {
+        xyz[0] *= s;
+        xyz[1] *= s;
+        xyz[2] *= s;
+        return *this;
+    }
+
+    inline constexpr Point3& operator/=(T s) noexcept
+    {
+        xyz[0] /= s;
+        xyz[1] /= s;
+        xyz[2] /= s;
+        return *this;
+    }
+
+    inline constexpr T operator[](int index) const noexcept
+    {
+        return xyz[index];
+    }
+
+    inline constexpr bool operator==(const Point3& p) const noexcept
+    {
+        return xyz[0] == p.xyz[0] && xyz[1] == p.xyz[1] && xyz[2] == p.xyz[2];
+    }
+
+    inline constexpr bool operator!=(const Point3& p) const noexcept
+    {
+        return !(*this == p);
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // P selects Exact (default), Fast or Approx; see Precision.h for the error bounds
+    template <class P = Exact>
+    inline T mag() const noexcept
+    {
+        return Precision<P>::sqrt(squaredMag());
+    }
+
+    inline constexpr T squaredMag() const noexcept
+    {
+        return xyz[0]*xyz[0] + xyz[1]*xyz[1] + xyz[2]*xyz[2];
+    }
+
+    template <class P = Exact>
+    inline void normalize() noexcept
+    {
+        if(std::is_same<P, Exact>::value)
+            *this /= mag();
+        else
+            *this *= Precision<P>::rsqrt(squaredMag());
+    }
+
+    inline T dist(const Point3& p) const noexcept
+    {
+        return std::sqrt(squaredDist(p));
+    }
+
+    inline constexpr T squaredDist(const Point3& p) const noexcept
+    {
+        T dx = xyz[0] - p.xyz[0];
+        T dy = xyz[1] - p.xyz[1];
+        T dz = xyz[2] - p.xyz[2];
+        return dx*dx + dy*dy + dz*dz;
+    }
+
+    inline constexpr T dot(const Point3& p) const noexcept
+    {
+        return xyz[0]*p.xyz[0] + xyz[1]*p.xyz[1] + xyz[2]*p.xyz[2];
+    }
+
+    inline constexpr Point3 cross(const Point3& p) const noexcept
+    {
+        return Point3(xyz[1]*p.xyz[2] - xyz[2]*p.xyz[1],
+                      xyz[2]*p.xyz[0] - xyz[0]*p.xyz[2],
+                      xyz[0]*p.xyz[1] - xyz[1]*p.xyz[0]);
+    }
+
+    /*****************************************************/
+    /*                 Batch Functions                   */
+    /*****************************************************/
+    // the SoA kernels of VectorKernels.h run over Point3 buffers by staging
+    // blocks through forEachStridedBlock (in and out may be the same buffer,
+    // and may be null when n is 0)
+    template <class P = Exact>
+    static inline void normalize(Point3* v, size_t n)
+    {
+        if(n == 0)
+            return;
+        forEachStridedBlock(v->data(), v->data(), n, stride, [](T* x, T* y, T* z, size_t b)
+        {
+            normalizeBatch<P>(x, y, z, b);
+        });
+    }
+
+    // out[i] = m * in[i] for a row-major 3x3 matrix
+    static inline void transform3x3(const T* m, const Point3* in, Point3* out, size_t n)
+    {
+        if(n == 0)
+            return;
+        forEachStridedBlock(in->data(), out->data(), n, stride, [m](T* x, T* y, T* z, size_t b)
+        {
+            transform3x3Batch(m, x, y, z, x, y, z, b);
+        });
+    }
+
+    // out[i] = m * (in[i], 1) for the top three rows of a row-major 4x4 matrix
+    static inline void transformAffine(const T* m, const Point3* in, Point3* out, size_t n)
+    {
+        if(n == 0)
+            return;
+        forEachStridedBlock(in->data(), out->data(), n, stride, [m](T* x, T* y, T* z, size_t b)
+        {
+            transformAffineBatch(m, x, y, z, x, y, z, b);
+        });
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline constexpr T getX() const noexcept
+    {
+        return xyz[0];
+    }
+
+    inline constexpr T getY() const noexcept
+    {
+        return xyz[1];
+    }
+
+    inline constexpr T getZ() const noexcept
+    {
+        return xyz[2];
+    }
+
+    inline constexpr void setX(T x) noexcept
+    {
+        xyz[0] = x;
+    }
+
+    inline constexpr void setY(T y) noexcept
+    {
+        xyz[1] = y;
+    }
+
+    inline constexpr void setZ(T z) noexcept
+    {
+        xyz[2] = z;
+    }
+
+    // the coordinates (followed by the zero pad lane when Padded)
+    inline constexpr const T* data() const noexcept
+    {
+        return xyz;
+    }
+
+    inline constexpr T* data() noexcept
+    {
+        return xyz;
+    }
+
+    /*****************************************************/
+    /*            Non-Member Ops & Functions             */
+    /*****************************************************/
+    inline friend std::ostream& operator<<(std::ostream& out, const Point3& p)
+    {
+        out << "(" << p.xyz[0] << ", " << p.xyz[1] << ", " << p.xyz[2] << ")";
+        return out;
+    }
+
+    inline friend constexpr Point3 operator+(const Point3& lhs, const Point3& rhs) noexcept
+    {
+        return Point3(lhs.xyz[0] + rhs.xyz[0], lhs.xyz[1] + rhs.xyz[1], lhs.xyz[2] + rhs.xyz[2]);
+    }
+
+    inline friend constexpr Point3 operator-(const Point3& lhs, const Point3& rhs) noexcept
+    {
+        return Point3(lhs.xyz[0] - rhs.xyz[0], lhs.xyz[1] - rhs.xyz[1], lhs.xyz[2] - rhs.xyz[2]);
+    }
+
+    inline friend constexpr Point3 operator-(const Point3& p) noexcept
+    {
+        return Point3(-p.xyz[0], -p.xyz[1], -p.xyz[2]);
+    }
+
+    inline friend constexpr Point3 operator*(const Point3& p, T s) noexcept
+    {
+        return Point3(p.xyz[0]*s, p.xyz[1]*s, p.xyz[2]*s);
+    }
+
+    inline friend constexpr Point3 operator*(T s, const Point3& p) noexcept
+    {
+        return Point3(p.xyz[0]*s, p.xyz[1]*s, p.xyz[2]*s);
+    }
+
+    inline friend constexpr Point3 operator/(const Point3& p, T s) noexcept
+    {
+        return Point3(p.xyz[0]/s, p.xyz[1]/s, p.xyz[2]/s);
+    }
+};
+
+static_assert(sizeof(Point3<float>) == 16 && alignof(Point3<float>) == 16, "padded float Point3 is one SSE register");
+static_assert(sizeof(Point3<double>) == 32 && alignof(Point3<double>) == 16, "padded double Point3 is two SSE registers");
+static_assert(sizeof(Point3<float, false>) == 12 && sizeof(Point3<double, false>) == 24, "packed Point3 is just xyz");
+static_assert(std::is_trivially_copyable<Point3<> >::value, "Point3 must stay trivially copyable");
+
+#endif	/* POINT3_H */
@@ -2,7 +2,11 @@
 #define	QUATERNION_H
 
 #include "Vector3.h"
+#include "VectorKernels.h"
+#include "../util/Instrument.h"
 #include <cmath>
+#include <cstddef>
+#include <type_traits>
 
 // templated 3D vector class with default type float
 template <class T = float>
@@ -15,12 +19,13 @@ public:
     /*****************************************************/
     /*                  Constructors                     */
     /*****************************************************/
-    inline Quat()
+    // default constructor (creates the identity rotation)
+    inline constexpr Quat() noexcept:
+    x(0), y(0), z(0), w(1)
     {
-     
     }
     
-    inline Quat(Vector3<> axis, T theta)
+    inline Quat(Vector3<> axis, T theta) noexcept
     {
         if(axis.squaredMag() > 1)
             axis.normalize();
@@ -30,60 +35,146 @@ public:
         w = cos(theta/2);
     }
     
-    inline Quat(T x, T y, T z, T w):
+    inline constexpr Quat(T x, T y, T z, T w) noexcept:
     x(x), y(y), z(z), w(w)
     {
-        
     }
     
     /*****************************************************/
     /*                 Member Functions                  */
     /*****************************************************/
-    inline Quat mult(Quat q)
+    // returns the Hamilton product this * q (apply q first, then this)
+    inline constexpr Quat mult(const Quat& q) const noexcept
     {
+        VECTOR_COUNT(QUAT_MULT);
+        VECTOR_TIME(QUAT_MULT);
         return Quat(w*q.x + x*q.w + y*q.z - z*q.y, 
-                    w*q.y + x*q.z + y*q.w - z*q.x, 
-                    w*q.z + x*q.y + y*q.x - z*q.w, 
-                    w*q.w + x*q.x + y*q.y - z*q.z);
+                    w*q.y - x*q.z + y*q.w + z*q.x, 
+                    w*q.z + x*q.y - y*q.x + z*q.w, 
+                    w*q.w - x*q.x - y*q.y - z*q.z);
+    }
+    
+    // returns the 4D dot product (cos of half the angle between two unit rotations)
+    inline constexpr T dot(const Quat& q) const noexcept
+    {
+        return (x*q.x + y*q.y + z*q.z + w*q.w);
+    }
+    
+    // returns the conjugate, which is the inverse rotation for a unit quaternion
+    inline constexpr Quat conjugate() const noexcept
+    {
+        return Quat(-x, -y, -z, w);
+    }
+    
+    // returns the multiplicative inverse (conjugate / |q|^2)
+    inline constexpr Quat inverse() const noexcept
+    {
+        T m = squaredMag();
+        return Quat(-x/m, -y/m, -z/m, w/m);
+    }
+    
+    // normalized linear interpolation from this (t = 0) to q (t = 1) along the
+    // shortest path; cheaper than slerp but does not keep a constant angular rate
+    inline Quat nlerp(const Quat& q, T t) const noexcept
+    {
+        VECTOR_COUNT(QUAT_NLERP);
+        T wb = dot(q) < 0 ? -t : t;
+        return blend(q, 1 - t, wb);
+    }
+    
+    // spherical linear interpolation from this (t = 0) to q (t = 1) along the
+    // shortest path at a constant angular rate; falls back to nlerp when the
+    // angle is small enough that dividing by sin(theta) loses precision
+    inline Quat slerp(const Quat& q, T t) const noexcept
+    {
+        VECTOR_COUNT(QUAT_SLERP);
+        VECTOR_TIME(QUAT_SLERP);
+        T d = dot(q);
+        T sign = d < 0 ? T(-1) : T(1);
+        d *= sign;
+        if(d > T(QUAT_NLERP_THRESHOLD))
+            return blend(q, 1 - t, sign*t);
+        
+        T theta = acos(d);
+        T s = sin(theta);
+        return blend(q, sin((1 - t)*theta)/s, sign*sin(t*theta)/s);
+    }
+    
+    // out[i] = a[i].slerp(b[i], t[i]) for n keyframe pairs in one vectorized pass
+    // (out may alias a or b); lanes use a polynomial slerp without acos or sin,
+    // and packs whose angles are all small take the nlerp path, see slerpBatch
+    static inline void slerp(const Quat* a, const Quat* b, const T* t, Quat* out, size_t n) noexcept
+    {
+        if(n == 0)
+            return;
+        slerpBatch(&a->x, &b->x, t, &out->x, n);
+    }
+    
+    // out[i] = a[i].nlerp(b[i], t[i]) for n keyframe pairs
+    static inline void nlerp(const Quat* a, const Quat* b, const T* t, Quat* out, size_t n) noexcept
+    {
+        if(n == 0)
+            return;
+        nlerpBatch(&a->x, &b->x, t, &out->x, n);
+    }
+    
+    // fills m with the row-major 3x3 rotation matrix of this (unit) quaternion
+    inline constexpr void getMatrix(T m[9]) const noexcept
+    {
+        T xx = 2*x*x, yy = 2*y*y, zz = 2*z*z;
+        T xy = 2*x*y, xz = 2*x*z, yz = 2*y*z;
+        T wx = 2*w*x, wy = 2*w*y, wz = 2*w*z;
+
+        m[0] = 1 - yy - zz; m[1] = xy - wz;     m[2] = xz + wy;
+        m[3] = xy + wz;     m[4] = 1 - xx - zz; m[5] = yz - wx;
+        m[6] = xz - wy;     m[7] = yz + wx;     m[8] = 1 - xx - yy;
+    }
+    
+    inline constexpr void rotateXYZ(Vector3<>& v) const noexcept
+    {
+        v = getRotateXYZ(v);
+    }
+    
+    inline constexpr Vector3<> getRotateXYZ(const Vector3<>& v) const noexcept
+    {
+        T m[9] = {};
+        getMatrix(m);
+        T vx = v.getX(), vy = v.getY(), vz = v.getZ();
+        return Vector3<>(vx*m[0] + vy*m[1] + vz*m[2],
+                         vx*m[3] + vy*m[4] + vz*m[5],
+                         vx*m[6] + vy*m[7] + vz*m[8]);
     }
     
-    inline void rotateXYZ(Vector3<>& v)
+    // rotates n interleaved xyz points from in into out (which may be in)
+    // the matrix is built once and streamed over the buffer with the SIMD
+    // kernels, so rotating a whole mesh costs one matrix build
+    inline void rotate(const T* in, T* out, size_t n) const noexcept
     {
-        v[0] = v[0]*(1 - 2*y*y - 2*z*z) + 
-                     v[1]*(2*x*y - 2*w*z) + 
-                            v[2]*(2*x*z + 2*w*y);
-        v[1] = v[0]*(2*x*y + 2*w*z) + 
-                     v[1]*(1 - 2*x*x - 2*z*z) + 
-                            v[2]*(2*y*z + 2*w*x);
-        v[2] = v[0]*(2*x*z - 2*w*y) + 
-                     v[1]*(2*y*z - 2*w*x) + 
-                            v[2]*(1 - 2*x*x - 2*y*y);
+        T m[9];
+        getMatrix(m);
+        transform3x3Interleaved(m, in, out, n);
     }
     
-    inline Vector3<> getRotateXYZ(const Vector3<>& v)
+    // rotates n points held in separate x, y and z streams
+    inline void rotate(const T* x, const T* y, const T* z,
+                       T* ox, T* oy, T* oz, size_t n) const noexcept
     {
-        return Vector3<>(v[0]*(1 - 2*y*y - 2*z*z) + 
-                                v[1]*(2*x*y - 2*w*z) + 
-                                      v[2]*(2*x*z + 2*w*y),
-                          v[0]*(2*x*y + 2*w*z) + 
-                                v[1]*(1 - 2*x*x - 2*z*z) + 
-                                      v[2]*(2*y*z + 2*w*x),
-                          v[0]*(2*x*z - 2*w*y) + 
-                                v[1]*(2*y*z - 2*w*x) + 
-                                      v[2]*(1 - 2*x*x - 2*y*y));
+        T m[9];
+        getMatrix(m);
+        transform3x3Batch(m, x, y, z, ox, oy, oz, n);
     }
     
-    inline T mag()
+    inline T mag() const noexcept
     {
         return sqrt(x*x + y*y + z*z + w*w);
     }
     
-    inline T squaredMag()
+    inline constexpr T squaredMag() const noexcept
     {
         return (x*x + y*y + z*z + w*w);
     }
     
-    inline void normalize()
+    inline void normalize() noexcept
     {
         T m = squaredMag();
         
@@ -96,7 +187,45 @@ public:
             w /= m;
         }
     }
+    
+private:
+    // returns (this*wa + q*wb) / |this*wa + q*wb|
+    inline Quat blend(const Quat& q, T wa, T wb) const noexcept
+    {
+        Quat r(x*wa + q.x*wb, y*wa + q.y*wb, z*wa + q.z*wb, w*wa + q.w*wb);
+        T m = sqrt(r.squaredMag());
+        return Quat(r.x/m, r.y/m, r.z/m, r.w/m);
+    }
+    
+public:
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline constexpr T getX() const noexcept
+    {
+        return x;
+    }
+    
+    inline constexpr T getY() const noexcept
+    {
+        return y;
+    }
+    
+    inline constexpr T getZ() const noexcept
+    {
+        return z;
+    }
+    
+    inline constexpr T getW() const noexcept
+    {
+        return w;
+    }
 };
 
+static_assert(std::is_trivially_copyable<Quat<> >::value,
+              "Quat must stay trivially copyable so bulk copies lower to memcpy");
+static_assert(sizeof(Quat<>) == 4*sizeof(float),
+              "the batch functions treat Quat arrays as interleaved xyzw buffers");
+
 #endif	/* QUATERNION_H */
 
@@ -0,0 +1,421 @@
+#ifndef SIMD_H
+#define	SIMD_H
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// thin wrappers over SSE2, AVX2 and AVX-512 registers so batch kernels can be
+// written once as templates and instantiated for 1, 2, 4, 8 or 16 lanes
+// Pack<T> is the widest pack the compiler was allowed to target (-msse2,
+// -mavx2, -mavx512f); ScalarPack<T> has a single lane and is used for tails
+// and for builds without any SIMD instruction set
+
+/*****************************************************/
+/*                    Scalar Pack                    */
+/*****************************************************/
+template <class T>
+struct ScalarMask
+{
+    bool m;
+
+    inline ScalarMask() {}
+    inline ScalarMask(bool m): m(m) {}
+};
+
+template <class T>
+struct ScalarPack
+{
+    enum { width = 1 };
+    typedef T Scalar;
+    typedef ScalarMask<T> Mask;
+
+    T v;
+
+    inline ScalarPack() {}
+    inline ScalarPack(T s): v(s) {}
+
+    static inline ScalarPack load(const T* p) { return ScalarPack(*p); }
+    inline void store(T* p) const { *p = v; }
+    inline T lane(int) const { return v; }
+};
+
+template <class T> inline ScalarPack<T> operator+(ScalarPack<T> a, ScalarPack<T> b) { return a.v + b.v; }
+template <class T> inline ScalarPack<T> operator-(ScalarPack<T> a, ScalarPack<T> b) { return a.v - b.v; }
+template <class T> inline ScalarPack<T> operator*(ScalarPack<T> a, ScalarPack<T> b) { return a.v * b.v; }
+template <class T> inline ScalarPack<T> operator/(ScalarPack<T> a, ScalarPack<T> b) { return a.v / b.v; }
+template <class T> inline ScalarPack<T> operator-(ScalarPack<T> a) { return -a.v; }
+template <class T> inline ScalarPack<T> fmadd(ScalarPack<T> a, ScalarPack<T> b, ScalarPack<T> c) { return a.v*b.v + c.v; }
+template <class T> inline ScalarPack<T> fmsub(ScalarPack<T> a, ScalarPack<T> b, ScalarPack<T> c) { return a.v*b.v - c.v; }
+template <class T> inline ScalarPack<T> sqrt(ScalarPack<T> a) { return std::sqrt(a.v); }
+template <class T> inline ScalarPack<T> min(ScalarPack<T> a, ScalarPack<T> b) { return b.v < a.v ? b.v : a.v; }
+template <class T> inline ScalarPack<T> max(ScalarPack<T> a, ScalarPack<T> b) { return a.v < b.v ? b.v : a.v; }
+template <class T> inline ScalarPack<T> abs(ScalarPack<T> a) { return std::fabs(a.v); }
+template <class T> inline ScalarMask<T> operator<(ScalarPack<T> a, ScalarPack<T> b) { return a.v < b.v; }
+template <class T> inline ScalarMask<T> operator<=(ScalarPack<T> a, ScalarPack<T> b) { return a.v <= b.v; }
+template <class T> inline ScalarMask<T> operator>(ScalarPack<T> a, ScalarPack<T> b) { return a.v > b.v; }
+template <class T> inline ScalarMask<T> operator>=(ScalarPack<T> a, ScalarPack<T> b) { return a.v >= b.v; }
+template <class T> inline ScalarMask<T> operator&(ScalarMask<T> a, ScalarMask<T> b) { return a.m && b.m; }
+template <class T> inline ScalarMask<T> operator|(ScalarMask<T> a, ScalarMask<T> b) { return a.m || b.m; }
+template <class T> inline ScalarPack<T> select(ScalarMask<T> m, ScalarPack<T> a, ScalarPack<T> b) { return m.m ? a : b; }
+template <class T> inline int bits(ScalarMask<T> m) { return m.m ? 1 : 0; }
+
+// hardware reciprocal square root estimates: about 12 correct bits (14 with
+// AVX-512), or exact when the target has no estimate instruction; refine with
+// Newton steps (see Precision.h)
+inline float rsqrtEstimate(float x)
+{
+#if defined(__SSE__) || defined(_M_X64)
+    return _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#else
+    return 1.0f / std::sqrt(x);
+#endif
+}
+
+inline double rsqrtEstimate(double x)
+{
+#if defined(__SSE__) || defined(_M_X64)
+    return double(rsqrtEstimate(float(x)));
+#else
+    return 1.0 / std::sqrt(x);
+#endif
+}
+
+template <class T> inline ScalarPack<T> rsqrtEstimate(ScalarPack<T> a) { return rsqrtEstimate(a.v); }
+
+#if defined(__SSE2__) || defined(_M_X64)
+/*****************************************************/
+/*              SSE2 Packs (4 / 2 lanes)             */
+/*****************************************************/
+struct MaskF4
+{
+    __m128 m;
+
+    inline MaskF4() {}
+    inline MaskF4(__m128 m): m(m) {}
+};
+
+struct PackF4
+{
+    enum { width = 4 };
+    typedef float Scalar;
+    typedef MaskF4 Mask;
+
+    __m128 v;
+
+    inline PackF4() {}
+    inline PackF4(__m128 v): v(v) {}
+    inline PackF4(float s): v(_mm_set1_ps(s)) {}
+
+    static inline PackF4 load(const float* p) { return _mm_loadu_ps(p); }
+    inline void store(float* p) const { _mm_storeu_ps(p, v); }
+    inline float lane(int i) const { float t[4]; store(t); return t[i]; }
+};
+
+inline PackF4 operator+(PackF4 a, PackF4 b) { return _mm_add_ps(a.v, b.v); }
+inline PackF4 operator-(PackF4 a, PackF4 b) { return _mm_sub_ps(a.v, b.v); }
+inline PackF4 operator*(PackF4 a, PackF4 b) { return _mm_mul_ps(a.v, b.v); }
+inline PackF4 operator/(PackF4 a, PackF4 b) { return _mm_div_ps(a.v, b.v); }
+inline PackF4 operator-(PackF4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+#if defined(__FMA__)
+inline PackF4 fmadd(PackF4 a, PackF4 b, PackF4 c) { return _mm_fmadd_ps(a.v, b.v, c.v); }
+inline PackF4 fmsub(PackF4 a, PackF4 b, PackF4 c) { return _mm_fmsub_ps(a.v, b.v, c.v); }
+#else
+inline PackF4 fmadd(PackF4 a, PackF4 b, PackF4 c) { return _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v); }
+inline PackF4 fmsub(PackF4 a, PackF4 b, PackF4 c) { return _mm_sub_ps(_mm_mul_ps(a.v, b.v), c.v); }
+#endif
+inline PackF4 sqrt(PackF4 a) { return _mm_sqrt_ps(a.v); }
+inline PackF4 min(PackF4 a, PackF4 b) { return _mm_min_ps(a.v, b.v); }
+inline PackF4 max(PackF4 a, PackF4 b) { return _mm_max_ps(a.v, b.v); }
+inline PackF4 abs(PackF4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+inline MaskF4 operator<(PackF4 a, PackF4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline MaskF4 operator<=(PackF4 a, PackF4 b) { return _mm_cmple_ps(a.v, b.v); }
+inline MaskF4 operator>(PackF4 a, PackF4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+inline MaskF4 operator>=(PackF4 a, PackF4 b) { return _mm_cmpge_ps(a.v, b.v); }
+inline MaskF4 operator&(MaskF4 a, MaskF4 b) { return _mm_and_ps(a.m, b.m); }
+inline MaskF4 operator|(MaskF4 a, MaskF4 b) { return _mm_or_ps(a.m, b.m); }
+inline PackF4 select(MaskF4 m, PackF4 a, PackF4 b) { return _mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v)); }
+inline int bits(MaskF4 m) { return _mm_movemask_ps(m.m); }
+inline PackF4 rsqrtEstimate(PackF4 a) { return _mm_rsqrt_ps(a.v); }
+
+struct MaskD2
+{
+    __m128d m;
+
+    inline MaskD2() {}
+    inline MaskD2(__m128d m): m(m) {}
+};
+
+struct PackD2
+{
+    enum { width = 2 };
+    typedef double Scalar;
+    typedef MaskD2 Mask;
+
+    __m128d v;
+
+    inline PackD2() {}
+    inline PackD2(__m128d v): v(v) {}
+    inline PackD2(double s): v(_mm_set1_pd(s)) {}
+
+    static inline PackD2 load(const double* p) { return _mm_loadu_pd(p); }
+    inline void store(double* p) const { _mm_storeu_pd(p, v); }
+    inline double lane(int i) const { double t[2]; store(t); return t[i]; }
+};
+
+inline PackD2 operator+(PackD2 a, PackD2 b) { return _mm_add_pd(a.v, b.v); }
+inline PackD2 operator-(PackD2 a, PackD2 b) { return _mm_sub_pd(a.v, b.v); }
+inline PackD2 operator*(PackD2 a, PackD2 b) { return _mm_mul_pd(a.v, b.v); }
+inline PackD2 operator/(PackD2 a, PackD2 b) { return _mm_div_pd(a.v, b.v); }
+inline PackD2 operator-(PackD2 a) { return _mm_xor_pd(a.v, _mm_set1_pd(-0.0)); }
+#if defined(__FMA__)
+inline PackD2 fmadd(PackD2 a, PackD2 b, PackD2 c) { return _mm_fmadd_pd(a.v, b.v, c.v); }
+inline PackD2 fmsub(PackD2 a, PackD2 b, PackD2 c) { return _mm_fmsub_pd(a.v, b.v, c.v); }
+#else
+inline PackD2 fmadd(PackD2 a, PackD2 b, PackD2 c) { return _mm_add_pd(_mm_mul_pd(a.v, b.v), c.v); }
+inline PackD2 fmsub(PackD2 a, PackD2 b, PackD2 c) { return _mm_sub_pd(_mm_mul_pd(a.v, b.v), c.v); }
+#endif
+inline PackD2 sqrt(PackD2 a) { return _mm_sqrt_pd(a.v); }
+inline PackD2 min(PackD2 a, PackD2 b) { return _mm_min_pd(a.v, b.v); }
+inline PackD2 max(PackD2 a, PackD2 b) { return _mm_max_pd(a.v, b.v); }
+inline PackD2 abs(PackD2 a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a.v); }
+inline MaskD2 operator<(PackD2 a, PackD2 b) { return _mm_cmplt_pd(a.v, b.v); }
+inline MaskD2 operator<=(PackD2 a, PackD2 b) { return _mm_cmple_pd(a.v, b.v); }
+inline MaskD2 operator>(PackD2 a, PackD2 b) { return _mm_cmpgt_pd(a.v, b.v); }
+inline MaskD2 operator>=(PackD2 a, PackD2 b) { return _mm_cmpge_pd(a.v, b.v); }
+inline MaskD2 operator&(MaskD2 a, MaskD2 b) { return _mm_and_pd(a.m, b.m); }
+inline MaskD2 operator|(MaskD2 a, MaskD2 b) { return _mm_or_pd(a.m, b.m); }
+inline PackD2 select(MaskD2 m, PackD2 a, PackD2 b) { return _mm_or_pd(_mm_and_pd(m.m, a.v), _mm_andnot_pd(m.m, b.v)); }
+inline int bits(MaskD2 m) { return _mm_movemask_pd(m.m); }
+inline PackD2 rsqrtEstimate(PackD2 a) { return _mm_cvtps_pd(_mm_rsqrt_ps(_mm_cvtpd_ps(a.v))); }
+#endif
+
+#if defined(__AVX2__)
+/*****************************************************/
+/*              AVX2 Packs (8 / 4 lanes)             */
+/*****************************************************/
+struct MaskF8
+{
+    __m256 m;
+
+    inline MaskF8() {}
+    inline MaskF8(__m256 m): m(m) {}
+};
+
+struct PackF8
+{
+    enum { width = 8 };
+    typedef float Scalar;
+    typedef MaskF8 Mask;
+
+    __m256 v;
+
+    inline PackF8() {}
+    inline PackF8(__m256 v): v(v) {}
+    inline PackF8(float s): v(_mm256_set1_ps(s)) {}
+
+    static inline PackF8 load(const float* p) { return _mm256_loadu_ps(p); }
+    inline void store(float* p) const { _mm256_storeu_ps(p, v); }
+    inline float lane(int i) const { float t[8]; store(t); return t[i]; }
+};
+
+inline PackF8 operator+(PackF8 a, PackF8 b) { return _mm256_add_ps(a.v, b.v); }
+inline PackF8 operator-(PackF8 a, PackF8 b) { return _mm256_sub_ps(a.v, b.v); }
+inline PackF8 operator*(PackF8 a, PackF8 b) { return _mm256_mul_ps(a.v, b.v); }
+inline PackF8 operator/(PackF8 a, PackF8 b) { return _mm256_div_ps(a.v, b.v); }
+inline PackF8 operator-(PackF8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+#if defined(__FMA__)
+inline PackF8 fmadd(PackF8 a, PackF8 b, PackF8 c) { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+inline PackF8 fmsub(PackF8 a, PackF8 b, PackF8 c) { return _mm256_fmsub_ps(a.v, b.v, c.v); }
+#else
+inline PackF8 fmadd(PackF8 a, PackF8 b, PackF8 c) { return _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v); }
+inline PackF8 fmsub(PackF8 a, PackF8 b, PackF8 c) { return _mm256_sub_ps(_mm256_mul_ps(a.v, b.v), c.v); }
+#endif
+inline PackF8 sqrt(PackF8 a) { return _mm256_sqrt_ps(a.v); }
+inline PackF8 min(PackF8 a, PackF8 b) { return _mm256_min_ps(a.v, b.v); }
+inline PackF8 max(PackF8 a, PackF8 b) { return _mm256_max_ps(a.v, b.v); }
+inline PackF8 abs(PackF8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline MaskF8 operator<(PackF8 a, PackF8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline MaskF8 operator<=(PackF8 a, PackF8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline MaskF8 operator>(PackF8 a, PackF8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline MaskF8 operator>=(PackF8 a, PackF8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+inline MaskF8 operator&(MaskF8 a, MaskF8 b) { return _mm256_and_ps(a.m, b.m); }
+inline MaskF8 operator|(MaskF8 a, MaskF8 b) { return _mm256_or_ps(a.m, b.m); }
+inline PackF8 select(MaskF8 m, PackF8 a, PackF8 b) { return _mm256_blendv_ps(b.v, a.v, m.m); }
+inline int bits(MaskF8 m) { return _mm256_movemask_ps(m.m); }
+inline PackF8 rsqrtEstimate(PackF8 a) { return _mm256_rsqrt_ps(a.v); }
+
+struct MaskD4
+{
+    __m256d m;
+
+    inline MaskD4() {}
+    inline MaskD4(__m256d m): m(m) {}
+};
+
+struct PackD4
+{
+    enum { width = 4 };
+    typedef double Scalar;
+    typedef MaskD4 Mask;
+
+    __m256d v;
+
+    inline PackD4() {}
+    inline PackD4(__m256d v): v(v) {}
+    inline PackD4(double s): v(_mm256_set1_pd(s)) {}
+
+    static inline PackD4 load(const double* p) { return _mm256_loadu_pd(p); }
+    inline void store(double* p) const { _mm256_storeu_pd(p, v); }
+    inline double lane(int i) const { double t[4]; store(t); return t[i]; }
+};
+
+inline PackD4 operator+(PackD4 a, PackD4 b) { return _mm256_add_pd(a.v, b.v); }
+inline PackD4 operator-(PackD4 a, PackD4 b) { return _mm256_sub_pd(a.v, b.v); }
+inline PackD4 operator*(PackD4 a, PackD4 b) { return _mm256_mul_pd(a.v, b.v); }
+inline PackD4 operator/(PackD4 a, PackD4 b) { return _mm256_div_pd(a.v, b.v); }
+inline PackD4 operator-(PackD4 a) { return _mm256_xor_pd(a.v, _mm256_set1_pd(-0.0)); }
+#if defined(__FMA__)
+inline PackD4 fmadd(PackD4 a, PackD4 b, PackD4 c) { return _mm256_fmadd_pd(a.v, b.v, c.v); }
+inline PackD4 fmsub(PackD4 a, PackD4 b, PackD4 c) { return _mm256_fmsub_pd(a.v, b.v, c.v); }
+#else
+inline PackD4 fmadd(PackD4 a, PackD4 b, PackD4 c) { return _mm256_add_pd(_mm256_mul_pd(a.v, b.v), c.v); }
+inline PackD4 fmsub(PackD4 a, PackD4 b, PackD4 c) { return _mm256_sub_pd(_mm256_mul_pd(a.v, b.v), c.v); }
+#endif
+inline PackD4 sqrt(PackD4 a) { return _mm256_sqrt_pd(a.v); }
+inline PackD4 min(PackD4 a, PackD4 b) { return _mm256_min_pd(a.v, b.v); }
+inline PackD4 max(PackD4 a, PackD4 b) { return _mm256_max_pd(a.v, b.v); }
+inline PackD4 abs(PackD4 a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v); }
+inline MaskD4 operator<(PackD4 a, PackD4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+inline MaskD4 operator<=(PackD4 a, PackD4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ); }
+inline MaskD4 operator>(PackD4 a, PackD4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); }
+inline MaskD4 operator>=(PackD4 a, PackD4 b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ); }
+inline MaskD4 operator&(MaskD4 a, MaskD4 b) { return _mm256_and_pd(a.m, b.m); }
+inline MaskD4 operator|(MaskD4 a, MaskD4 b) { return _mm256_or_pd(a.m, b.m); }
+inline PackD4 select(MaskD4 m, PackD4 a, PackD4 b) { return _mm256_blendv_pd(b.v, a.v, m.m); }
+inline int bits(MaskD4 m) { return _mm256_movemask_pd(m.m); }
+inline PackD4 rsqrtEstimate(PackD4 a) { return _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(a.v))); }
+#endif
+
+#if defined(__AVX512F__)
+/*****************************************************/
+/*            AVX-512 Packs (16 / 8 lanes)           */
+/*****************************************************/
+struct MaskF16
+{
+    __mmask16 m;
+
+    inline MaskF16() {}
+    inline MaskF16(__mmask16 m): m(m) {}
+};
+
+struct PackF16
+{
+    enum { width = 16 };
+    typedef float Scalar;
+    typedef MaskF16 Mask;
+
+    __m512 v;
+
+    inline PackF16() {}
+    inline PackF16(__m512 v): v(v) {}
+    inline PackF16(float s): v(_mm512_set1_ps(s)) {}
+
+    static inline PackF16 load(const float* p) { return _mm512_loadu_ps(p); }
+    inline void store(float* p) const { _mm512_storeu_ps(p, v); }
+    inline float lane(int i) const { float t[16]; store(t); return t[i]; }
+};
+
+inline PackF16 operator+(PackF16 a, PackF16 b) { return _mm512_add_ps(a.v, b.v); }
+inline PackF16 operator-(PackF16 a, PackF16 b) { return _mm512_sub_ps(a.v, b.v); }
+inline PackF16 operator*(PackF16 a, PackF16 b) { return _mm512_mul_ps(a.v, b.v); }
+inline PackF16 operator/(PackF16 a, PackF16 b) { return _mm512_div_ps(a.v, b.v); }
+inline PackF16 operator-(PackF16 a) { return _mm512_sub_ps(_mm512_setzero_ps(), a.v); }
+inline PackF16 fmadd(PackF16 a, PackF16 b, PackF16 c) { return _mm512_fmadd_ps(a.v, b.v, c.v); }
+inline PackF16 fmsub(PackF16 a, PackF16 b, PackF16 c) { return _mm512_fmsub_ps(a.v, b.v, c.v); }
+inline PackF16 sqrt(PackF16 a) { return _mm512_sqrt_ps(a.v); }
+inline PackF16 min(PackF16 a, PackF16 b) { return _mm512_min_ps(a.v, b.v); }
+inline PackF16 max(PackF16 a, PackF16 b) { return _mm512_max_ps(a.v, b.v); }
+inline PackF16 abs(PackF16 a) { return _mm512_abs_ps(a.v); }
+inline MaskF16 operator<(PackF16 a, PackF16 b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ); }
+inline MaskF16 operator<=(PackF16 a, PackF16 b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ); }
+inline MaskF16 operator>(PackF16 a, PackF16 b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ); }
+inline MaskF16 operator>=(PackF16 a, PackF16 b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ); }
+inline MaskF16 operator&(MaskF16 a, MaskF16 b) { return (__mmask16)(a.m & b.m); }
+inline MaskF16 operator|(MaskF16 a, MaskF16 b) { return (__mmask16)(a.m | b.m); }
+inline PackF16 select(MaskF16 m, PackF16 a, PackF16 b) { return _mm512_mask_blend_ps(m.m, b.v, a.v); }
+inline int bits(MaskF16 m) { return m.m; }
+inline PackF16 rsqrtEstimate(PackF16 a) { return _mm512_rsqrt14_ps(a.v); }
+
+struct MaskD8
+{
+    __mmask8 m;
+
+    inline MaskD8() {}
+    inline MaskD8(__mmask8 m): m(m) {}
+};
+
+struct PackD8
+{
+    enum { width = 8 };
+    typedef double Scalar;
+    typedef MaskD8 Mask;
+
+    __m512d v;
+
+    inline PackD8() {}
+    inline PackD8(__m512d v): v(v) {}
+    inline PackD8(double s): v(_mm512_set1_pd(s)) {}
+
+    static inline PackD8 load(const double* p) { return _mm512_loadu_pd(p); }
+    inline void store(double* p) const { _mm512_storeu_pd(p, v); }
+    inline double lane(int i) const { double t[8]; store(t); return t[i]; }
+};
+
+inline PackD8 operator+(PackD8 a, PackD8 b) { return _mm512_add_pd(a.v, b.v); }
+inline PackD8 operator-(PackD8 a, PackD8 b) { return _mm512_sub_pd(a.v, b.v); }
+inline PackD8 operator*(PackD8 a, PackD8 b) { return _mm512_mul_pd(a.v, b.v); }
+inline PackD8 operator/(PackD8 a, PackD8 b) { return _mm512_div_pd(a.v, b.v); }
+inline PackD8 operator-(PackD8 a) { return _mm512_sub_pd(_mm512_setzero_pd(), a.v); }
+inline PackD8 fmadd(PackD8 a, PackD8 b, PackD8 c) { return _mm512_fmadd_pd(a.v, b.v, c.v); }
+inline PackD8 fmsub(PackD8 a, PackD8 b, PackD8 c) { return _mm512_fmsub_pd(a.v, b.v, c.v); }
+inline PackD8 sqrt(PackD8 a) { return _mm512_sqrt_pd(a.v); }
+inline PackD8 min(PackD8 a, PackD8 b) { return _mm512_min_pd(a.v, b.v); }
+inline PackD8 max(PackD8 a, PackD8 b) { return _mm512_max_pd(a.v, b.v); }
+inline PackD8 abs(PackD8 a) { return _mm512_abs_pd(a.v); }
+inline MaskD8 operator<(PackD8 a, PackD8 b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ); }
+inline MaskD8 operator<=(PackD8 a, PackD8 b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LE_OQ); }
+inline MaskD8 operator>(PackD8 a, PackD8 b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ); }
+inline MaskD8 operator>=(PackD8 a, PackD8 b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GE_OQ); }
+inline MaskD8 operator&(MaskD8 a, MaskD8 b) { return (__mmask8)(a.m & b.m); }
+inline MaskD8 operator|(MaskD8 a, MaskD8 b) { return (__mmask8)(a.m | b.m); }
+inline PackD8 select(MaskD8 m, PackD8 a, PackD8 b) { return _mm512_mask_blend_pd(m.m, b.v, a.v); }
+inline int bits(MaskD8 m) { return m.m; }
+inline PackD8 rsqrtEstimate(PackD8 a) { return _mm512_rsqrt14_pd(a.v); }
+#endif
+
+/*****************************************************/
+/*                 Widest Pack Types                 */
+/*****************************************************/
+template <class T> struct WidestPack { typedef ScalarPack<T> type; };
+
+#if defined(__AVX512F__)
+template <> struct WidestPack<float> { typedef PackF16 type; };
+template <> struct WidestPack<double> { typedef PackD8 type; };
+#elif defined(__AVX2__)
+template <> struct WidestPack<float> { typedef PackF8 type; };
+template <> struct WidestPack<double> { typedef PackD4 type; };
+#elif defined(__SSE2__) || defined(_M_X64)
+template <> struct WidestPack<float> { typedef PackF4 type; };
+template <> struct WidestPack<double> { typedef PackD2 type; };
+#endif
+
+// widest pack available for T in this build
+template <class T>
+using Pack = typename WidestPack<T>::type;
+
+#endif	/* SIMD_H */
+
@@ -0,0 +1,148 @@
+#ifndef SKINNING_H
+#define	SKINNING_H
+
+#include "DualQuat.h"
+#include "Simd.h"
+#include "../util/Parallel.h"
+#include <cstddef>
+#include <cstdint>
+
+// dual-quaternion linear blend skinning over SoA vertex streams
+//
+// every vertex names SKIN_INFLUENCES bones and weights (interleaved, four per
+// vertex; unused slots take weight 0 and any valid bone). the bone dual
+// quaternions are blended per vertex, each flipped onto the hemisphere of the
+// first influence so antipodal rotations do not cancel, then renormalized and
+// applied to the position and normal in one pass. a vertex whose blend has a
+// zero real part, such as one with all weights 0, gets the identity and
+// passes through unchanged
+//
+// vertices go through in blocks of SKIN_BLOCK: the blend gathers bones by
+// index into eight SoA scratch streams, then the transform runs Pack<T>::width
+// vertices at a time like the VectorKernels.h kernels. dualQuatSkin splits the
+// vertex range across the TaskScheduler; each vertex is independent, so the
+// output does not depend on the thread count
+const size_t SKIN_INFLUENCES = 4;
+const size_t SKIN_BLOCK = 256;
+
+// one step of the transform at offset i: b holds the eight blended dual
+// quaternion streams (real xyzw, dual xyzw), not yet normalized; a zero real
+// part is replaced by the identity
+template <class P, class T>
+inline void dualQuatSkinStep(const T* const* b,
+                             const T* x, const T* y, const T* z,
+                             const T* nx, const T* ny, const T* nz,
+                             T* ox, T* oy, T* oz, T* onx, T* ony, T* onz, size_t i)
+{
+    P rx = P::load(b[0] + i), ry = P::load(b[1] + i), rz = P::load(b[2] + i), rw = P::load(b[3] + i);
+    P dx = P::load(b[4] + i), dy = P::load(b[5] + i), dz = P::load(b[6] + i), dw = P::load(b[7] + i);
+    P m2 = fmadd(rw, rw, fmadd(rz, rz, fmadd(ry, ry, rx*rx)));
+    typename P::Mask nonzero = m2 > P(0);
+    P inv = select(nonzero, P(1) / sqrt(select(nonzero, m2, P(1))), P(0));
+    rx = rx*inv; ry = ry*inv; rz = rz*inv;
+    rw = select(nonzero, rw*inv, P(1));
+    dx = dx*inv; dy = dy*inv; dz = dz*inv; dw = dw*inv;
+
+    // p' = p + 2 r x (r x p + w p) + 2 (rw d - dw r + r x d)
+    P px = P::load(x + i), py = P::load(y + i), pz = P::load(z + i);
+    P cx = fmadd(rw, px, fmsub(ry, pz, rz*py));
+    P cy = fmadd(rw, py, fmsub(rz, px, rx*pz));
+    P cz = fmadd(rw, pz, fmsub(rx, py, ry*px));
+    P tx = fmadd(rw, dx, fmsub(ry, dz, rz*dy)) - dw*rx;
+    P ty = fmadd(rw, dy, fmsub(rz, dx, rx*dz)) - dw*ry;
+    P tz = fmadd(rw, dz, fmsub(rx, dy, ry*dx)) - dw*rz;
+    P two(2);
+    fmadd(two, fmsub(ry, cz, rz*cy) + tx, px).store(ox + i);
+    fmadd(two, fmsub(rz, cx, rx*cz) + ty, py).store(oy + i);
+    fmadd(two, fmsub(rx, cy, ry*cx) + tz, pz).store(oz + i);
+
+    if(nx)
+    {
+        P qx = P::load(nx + i), qy = P::load(ny + i), qz = P::load(nz + i);
+        P ex = fmadd(rw, qx, fmsub(ry, qz, rz*qy));
+        P ey = fmadd(rw, qy, fmsub(rz, qx, rx*qz));
+        P ez = fmadd(rw, qz, fmsub(rx, qy, ry*qx));
+        fmadd(two, fmsub(ry, ez, rz*ey), qx).store(onx + i);
+        fmadd(two, fmsub(rz, ex, rx*ez), qy).store(ony + i);
+        fmadd(two, fmsub(rx, ey, ry*ex), qz).store(onz + i);
+    }
+}
+
+// skins vertices [0, n) on the calling thread; normals are optional (pass 0
+// for nx and onx) and outputs may alias inputs
+template <class T>
+inline void dualQuatSkinBatch(const DualQuat<T>* bones, const uint16_t* boneIndices, const T* boneWeights,
+                              const T* x, const T* y, const T* z,
+                              const T* nx, const T* ny, const T* nz,
+                              T* ox, T* oy, T* oz, T* onx, T* ony, T* onz, size_t n)
+{
+    typedef Pack<T> P;
+    typedef ScalarPack<T> S;
+    const T* table = reinterpret_cast<const T*>(bones);
+    T blend[8][SKIN_BLOCK];
+    const T* b[8] = { blend[0], blend[1], blend[2], blend[3], blend[4], blend[5], blend[6], blend[7] };
+
+    for(size_t begin = 0; begin < n; begin += SKIN_BLOCK)
+    {
+        size_t m = n - begin < SKIN_BLOCK ? n - begin : SKIN_BLOCK;
+        for(size_t j = 0; j < m; ++j)
+        {
+            const uint16_t* idx = boneIndices + SKIN_INFLUENCES*(begin + j);
+            const T* w = boneWeights + SKIN_INFLUENCES*(begin + j);
+            const T* q0 = table + 8*size_t(idx[0]);
+            T acc[8];
+            for(int c = 0; c < 8; ++c)
+                acc[c] = w[0]*q0[c];
+            for(size_t k = 1; k < SKIN_INFLUENCES; ++k)
+            {
+                const T* q = table + 8*size_t(idx[k]);
+                T d = q[0]*q0[0] + q[1]*q0[1] + q[2]*q0[2] + q[3]*q0[3];
+                T s = d < 0 ? -w[k] : w[k];
+                for(int c = 0; c < 8; ++c)
+                    acc[c] += s*q[c];
+            }
+            for(int c = 0; c < 8; ++c)
+                blend[c][j] = acc[c];
+        }
+
+        const T* bx = x + begin;
+        const T* by = y + begin;
+        const T* bz = z + begin;
+        const T* bnx = nx ? nx + begin : 0;
+        const T* bny = nx ? ny + begin : 0;
+        const T* bnz = nx ? nz + begin : 0;
+        T* box = ox + begin;
+        T* boy = oy + begin;
+        T* boz = oz + begin;
+        T* bonx = nx ? onx + begin : 0;
+        T* bony = nx ? ony + begin : 0;
+        T* bonz = nx ? onz + begin : 0;
+        size_t i = 0;
+        for(; i + P::width <= m; i += P::width)
+            dualQuatSkinStep<P>(b, bx, by, bz, bnx, bny, bnz, box, boy, boz, bonx, bony, bonz, i);
+        for(; i < m; ++i)
+            dualQuatSkinStep<S>(b, bx, by, bz, bnx, bny, bnz, box, boy, boz, bonx, bony, bonz, i);
+    }
+}
+
+// dualQuatSkinBatch with the vertex range split across the scheduler
+template <class T>
+inline void dualQuatSkin(const DualQuat<T>* bones, const uint16_t* boneIndices, const T* boneWeights,
+                         const T* x, const T* y, const T* z,
+                         const T* nx, const T* ny, const T* nz,
+                         T* ox, T* oy, T* oz, T* onx, T* ony, T* onz, size_t n,
+                         TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    parallelFor(n, 4*SKIN_BLOCK, [&](size_t begin, size_t end)
+    {
+        bool normals = nx != 0;
+        dualQuatSkinBatch(bones, boneIndices + SKIN_INFLUENCES*begin, boneWeights + SKIN_INFLUENCES*begin,
+                          x + begin, y + begin, z + begin,
+                          normals ? nx + begin : nx, normals ? ny + begin : ny, normals ? nz + begin : nz,
+                          ox + begin, oy + begin, oz + begin,
+                          normals ? onx + begin : onx, normals ? ony + begin : ony, normals ? onz + begin : onz,
+                          end - begin);
+    }, scheduler);
+}
+
+#endif	/* SKINNING_H */
@@ -6,7 +6,10 @@
 //  Copyright 2011 SMU. All rights reserved.
 //
 
-#include "Vector3.h"
+#include "../../includes/math/Vector3.h"
+#include "VectorKernels.h"
+#include "../geom/MeshNormals.h"
+#include "../util/Instrument.h"
 #include <iostream>
 
 
@@ -58,6 +61,8 @@
     
     Vector3 rotate(double theta, const Vector3& axis, const Vector3& v)
     {
+        VECTOR_COUNT(ROTATE);
+        VECTOR_TIME(ROTATE);
         Vector3 rv;
         double s = sin(theta);
         double c = cos(theta);
@@ -92,6 +97,102 @@
         
         return ang;
     }
+    
+    
+    /*****************************************************/
+    /*                 Batch Functions                   */
+    /*****************************************************/
+    // the batch functions copy blocks of vectors into structure-of-arrays
+    // scratch buffers, run the SIMD kernels over them and copy the results back
+    static const size_t BATCH_BLOCK = 256;
+    
+    static void gatherXYZ(const Vector3* v, size_t n, double* x, double* y, double* z)
+    {
+        for(size_t i = 0; i < n; ++i){
+            x[i] = v[i].x;
+            y[i] = v[i].y;
+            z[i] = v[i].z;
+        }
+    }
+    
+    static void scatterXYZ(const double* x, const double* y, const double* z, size_t n, Vector3* v)
+    {
+        for(size_t i = 0; i < n; ++i){
+            v[i].x = x[i];
+            v[i].y = y[i];
+            v[i].z = z[i];
+        }
+    }
+    
+    void dot(const Vector3* lhs, const Vector3* rhs, double* out, size_t n)
+    {
+        double ax[BATCH_BLOCK], ay[BATCH_BLOCK], az[BATCH_BLOCK];
+        double bx[BATCH_BLOCK], by[BATCH_BLOCK], bz[BATCH_BLOCK];
+        for(size_t i = 0; i < n; i += BATCH_BLOCK){
+            size_t m = n - i < BATCH_BLOCK ? n - i : BATCH_BLOCK;
+            gatherXYZ(lhs + i, m, ax, ay, az);
+            gatherXYZ(rhs + i, m, bx, by, bz);
+            dotBatch(ax, ay, az, bx, by, bz, out + i, m);
+        }
+    }
+    
+    void cross(const Vector3* lhs, const Vector3* rhs, Vector3* out, size_t n)
+    {
+        double ax[BATCH_BLOCK], ay[BATCH_BLOCK], az[BATCH_BLOCK];
+        double bx[BATCH_BLOCK], by[BATCH_BLOCK], bz[BATCH_BLOCK];
+        for(size_t i = 0; i < n; i += BATCH_BLOCK){
+            size_t m = n - i < BATCH_BLOCK ? n - i : BATCH_BLOCK;
+            gatherXYZ(lhs + i, m, ax, ay, az);
+            gatherXYZ(rhs + i, m, bx, by, bz);
+            crossBatch(ax, ay, az, bx, by, bz, ax, ay, az, m);
+            scatterXYZ(ax, ay, az, m, out + i);
+        }
+    }
+    
+    void normalize(Vector3* v, size_t n)
+    {
+        double x[BATCH_BLOCK], y[BATCH_BLOCK], z[BATCH_BLOCK];
+        for(size_t i = 0; i < n; i += BATCH_BLOCK){
+            size_t m = n - i < BATCH_BLOCK ? n - i : BATCH_BLOCK;
+            gatherXYZ(v + i, m, x, y, z);
+            normalizeBatch(x, y, z, m);
+            scatterXYZ(x, y, z, m, v + i);
+        }
+    }
+    
+    void dist(const Vector3* lhs, const Vector3* rhs, double* out, size_t n)
+    {
+        double ax[BATCH_BLOCK], ay[BATCH_BLOCK], az[BATCH_BLOCK];
+        double bx[BATCH_BLOCK], by[BATCH_BLOCK], bz[BATCH_BLOCK];
+        for(size_t i = 0; i < n; i += BATCH_BLOCK){
+            size_t m = n - i < BATCH_BLOCK ? n - i : BATCH_BLOCK;
+            gatherXYZ(lhs + i, m, ax, ay, az);
+            gatherXYZ(rhs + i, m, bx, by, bz);
+            distBatch(ax, ay, az, bx, by, bz, out + i, m);
+        }
+    }
+    
+    // positions are staged whole into SoA streams, since any triangle may
+    // reference any vertex; the normals come back the same way
+    void computeNormals(Vector3* v, size_t n, const uint32_t* indices, size_t triangles,
+                        bool angleWeighted)
+    {
+        MeshNormals<double> topology(indices, triangles, n);
+        computeNormals(v, n, topology, angleWeighted);
+    }
+    
+    void computeNormals(Vector3* v, size_t n, MeshNormals<double>& topology, bool angleWeighted)
+    {
+        std::vector<double> x(n), y(n), z(n), nx(n), ny(n), nz(n);
+        parallelFor(n, parallelGrain<Vector3>(), [&](size_t begin, size_t end){
+            gatherXYZ(v + begin, end - begin, &x[begin], &y[begin], &z[begin]);
+        });
+        topology.compute(x.data(), y.data(), z.data(), nx.data(), ny.data(), nz.data(), angleWeighted);
+        parallelFor(n, parallelGrain<Vector3>(), [&](size_t begin, size_t end){
+            for(size_t i = begin; i < end; ++i)
+                v[i].setNormal(nx[i], ny[i], nz[i]);
+        });
+    }
 
 
 /*****************************************************/
@@ -99,18 +200,12 @@
 /*****************************************************/
 
 
-// initialize static counter
-// keeps track of all the vectors created
-int Vector3::totolVector3Count = 0;
-
-
 /*****************************************************/
 /*                   Constructors                    */
 /*****************************************************/
 Vector3::Vector3(double x, double y, double z, float r, float g, float b, float a):
 x(x), y(y), z(z), r(r), g(g), b(b), a(a){
-    // increment static vector count
-    totolVector3Count++;
+    VECTOR_COUNT(CONSTRUCT);
 }
 
 Vector3::Vector3(double xyz[3])
@@ -119,7 +214,7 @@ Vector3::Vector3(double xyz[3])
     y = xyz[1];
     z = xyz[2];
     r=g=b=a=0;
-    totolVector3Count++;
+    VECTOR_COUNT(CONSTRUCT);
 }
 
 Vector3::Vector3(double xyz[3], float rgba[4])
@@ -131,7 +226,7 @@ Vector3::Vector3(double xyz[3], float rgba[4])
     g = rgba[1];
     b = rgba[2];
     a = rgba[3];
-    totolVector3Count++;
+    VECTOR_COUNT(CONSTRUCT);
 }
 
 /*****************************************************/
@@ -248,11 +343,14 @@ std::ostream& operator<<(std::ostream& output, const Vector3& vec) {
 /*                 Member Functions                  */
 /*****************************************************/
 double Vector3::mag(){
+    VECTOR_COUNT(MAG);
     double m = sqrt(x*x + y*y + z*z);
     return m;
 }
 
 void Vector3::normalize(){
+    VECTOR_COUNT(NORMALIZE);
+    VECTOR_TIME(NORMALIZE);
     double m = mag();
     *this /= m;
 }
@@ -276,6 +374,7 @@ double Vector3::angle(const Vector3& v){
 }
 
 double Vector3::dot(const Vector3& v){
+    VECTOR_COUNT(DOT);
     // copy vectors
     //Vector3 a = *this;
     //Vector3 b = v;
@@ -288,6 +387,7 @@ double Vector3::dot(const Vector3& v){
 }
 
 Vector3 Vector3::cross(const Vector3& v){
+    VECTOR_COUNT(CROSS);
     Vector3 rhs;
     rhs.x = y*v.z - z*v.y;
     rhs.y = z*v.x - x*v.z;
@@ -305,6 +405,8 @@ double Vector3::dist(const Vector3& v){
 
 // inspired/ported from C4 Vector4D api
 Vector3& Vector3::rotate(double theta, const Vector3& axis) {
+    VECTOR_COUNT(ROTATE);
+    VECTOR_TIME(ROTATE);
     double s = sin(theta);
     double c = cos(theta);
     double k = 1.0 - c;
@@ -324,5 +426,23 @@ Vector3& Vector3::rotate(double theta, const Vector3& axis) {
 }
 
 
+/*****************************************************/
+/*                 Getters & Setters                 */
+/*****************************************************/
+void Vector3::setNormal(double nx, double ny, double nz){
+    this->nx = nxyz[0] = nx;
+    this->ny = nxyz[1] = ny;
+    this->nz = nxyz[2] = nz;
+}
 
+void Vector3::setNormal(const Vector3& n){
+    setNormal(n.x, n.y, n.z);
+}
+
+Vector3 Vector3::getNormal() const{
+    return Vector3(nx, ny, nz);
+}
 
+const double* Vector3::getNormalArray() const{
+    return nxyz;
+}
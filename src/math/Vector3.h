@@ -1,8 +1,15 @@
 #ifndef VECTOR3_H
 #define	VECTOR3_H
 
+#include "Precision.h"
+#include "../util/Instrument.h"
+#include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <type_traits>
 
 // templated 3D vector class with default types float and int
 template <class T = float, class U = int>
@@ -11,142 +18,165 @@ class Vector3
 private:
     T x, y, z; // x, y, z coordinates with default type float
     U r, g, b, a; // r, g, b, a color and alpha values with default type int
-    int totalVecs; // total number of created vectors
     
 public:
     /*****************************************************/
     /*                  Constructors                     */
     /*****************************************************/
     // default constructor (creates a zero vector)
-    inline Vector3()
+    inline constexpr Vector3() noexcept:
+    x(0), y(0), z(0), r(0), g(0), b(0), a(0)
     {
-        x=y=z=0.0;
-        r=g=b=a=0;
-        totalVecs++;
+        VECTOR_COUNT(CONSTRUCT);
     }
     
     // constructor for passing in xyz coordinates
-    inline Vector3(T x, T y, T z):
-    x(x), y(y), z(z)
+    inline constexpr Vector3(T x, T y, T z) noexcept:
+    x(x), y(y), z(z), r(0), g(0), b(0), a(0)
     {
-        totalVecs++;
+        VECTOR_COUNT(CONSTRUCT);
     }
     
     // constructor for passing in xyz coordinates and rgb color values
-    inline Vector3(T x, T y, T z, U r, U g, U b):
-    x(x), y(y), z(z), r(r), g(g), b(b)
+    inline constexpr Vector3(T x, T y, T z, U r, U g, U b) noexcept:
+    x(x), y(y), z(z), r(r), g(g), b(b), a(0)
     {
-        totalVecs++;
+        VECTOR_COUNT(CONSTRUCT);
     }
     
     // constructor for passing in xyz coordinates, rgb color values, and an alpha value
-    inline Vector3(T x, T y, T z, U r, U g, U b, U a):
+    inline constexpr Vector3(T x, T y, T z, U r, U g, U b, U a) noexcept:
     x(x), y(y), z(z), r(r), g(g), b(b), a(a)
     {
-        totalVecs++;
+        VECTOR_COUNT(CONSTRUCT);
     }
     
     // constructor for passing in an array of coordinate values
-    inline Vector3(T* xyz)
+    inline constexpr Vector3(const T* xyz) noexcept:
+    x(xyz[0]), y(xyz[1]), z(xyz[2]), r(0), g(0), b(0), a(0)
     {
-        x = xyz[0];
-        y = xyz[1];
-        z = xyz[2];
-        r=g=b=a=0;
-        totalVecs++;
+        VECTOR_COUNT(CONSTRUCT);
     }
 
     // constructor for passing in an array of coordinate and color values
-    inline Vector3(T* xyz, U* rgba)
+    inline constexpr Vector3(const T* xyz, const U* rgba) noexcept:
+    x(xyz[0]), y(xyz[1]), z(xyz[2]), r(rgba[0]), g(rgba[1]), b(rgba[2]), a(rgba[3])
     {
-        x = xyz[0];
-        y = xyz[1];
-        z = xyz[2];
-        r = rgba[0];
-        g = rgba[1];
-        b = rgba[2];
-        a = rgba[3];
-        totalVecs++;
+        VECTOR_COUNT(CONSTRUCT);
     }
     
-    // copy constructor
-    inline Vector3(const Vector3& v)
+    // copy construction and assignment are left to the compiler so Vector3
+    // stays trivially copyable (bulk copies lower to memcpy); instrumented
+    // builds count copies instead (see Instrument.h)
+#ifdef VECTOR_INSTRUMENT
+    inline Vector3(const Vector3& v) noexcept:
+    x(v.x), y(v.y), z(v.z), r(v.r), g(v.g), b(v.b), a(v.a)
     {
-        x = v.x;
-        y = v.y;
-        z = v.z;
-        r = v.r;
-        g = v.g;
-        b = v.b;
-        a = v.a;
-        totalVecs++;
+        VECTOR_COUNT(COPY);
     }
+
+    inline Vector3& operator=(const Vector3& v) noexcept
+    {
+        x = v.x; y = v.y; z = v.z;
+        r = v.r; g = v.g; b = v.b; a = v.a;
+        VECTOR_COUNT(COPY);
+        return *this;
+    }
+#endif
     
-    /*****************************************************/
-    /*              Member Overloaded Ops                */
-    /*****************************************************/
-    // overloaded assignment operator
-    inline Vector3& operator=(const Vector3& v)
+    // unit axes, usable in constant expressions
+    static inline constexpr Vector3 xAxis() noexcept
+    {
+        return Vector3(1, 0, 0);
+    }
+    
+    static inline constexpr Vector3 yAxis() noexcept
     {
-        x = v.x;
-        y = v.y;
-        z = v.z;
-        r = v.r;
-        g = v.g;
-        b = v.b;
-        a = v.a;
+        return Vector3(0, 1, 0);
     }
     
+    static inline constexpr Vector3 zAxis() noexcept
+    {
+        return Vector3(0, 0, 1);
+    }
+    
+    /*****************************************************/
+    /*              Member Overloaded Ops                */
+    /*****************************************************/
     // overloaded operator+= for adding two vectors
-    inline Vector3& operator+=(const Vector3& v) 
+    inline constexpr Vector3& operator+=(const Vector3& v) noexcept
     {
-        return Vector3(x += v.x, y += v.y, z += v.z);
+        x += v.x;
+        y += v.y;
+        z += v.z;
+        return *this;
     }
 
     // overloaded operator+= for adding a scalar to a vector
-    inline Vector3& operator+=(T s) 
+    inline constexpr Vector3& operator+=(T s) noexcept
     {
-        return Vector3(x += s, y += s, z += s);
+        x += s;
+        y += s;
+        z += s;
+        return *this;
     }
 
     // overloaded operator-= for subtracting two vectors
-    inline Vector3& operator-=(const Vector3& v) 
+    inline constexpr Vector3& operator-=(const Vector3& v) noexcept
     {
-        return Vector3(x -= v.x, y -= v.y, z -= v.z);
+        x -= v.x;
+        y -= v.y;
+        z -= v.z;
+        return *this;
     }
 
     // overloaded operator-= for subtracting a vector by a scalar
-    inline Vector3& operator-=(T s) 
+    inline constexpr Vector3& operator-=(T s) noexcept
     {
-        return Vector3(x -= s, y -= s, z -= s);
+        x -= s;
+        y -= s;
+        z -= s;
+        return *this;
     }
 
     // overloaded operator*= for multiplying a vector by a scalar
-    inline Vector3& operator*=(T s) 
+    inline constexpr Vector3& operator*=(T s) noexcept
     {
-        return Vector3(x *= s, y *= s, z *= s);
+        x *= s;
+        y *= s;
+        z *= s;
+        return *this;
     }
 
     // overloaded operator+= for dividing a vector by a scalar
-    inline Vector3& operator/=(T s) 
+    inline constexpr Vector3& operator/=(T s) noexcept
     {
-        return Vector3(x /= s, y /= s, z /= s);
+        x /= s;
+        y /= s;
+        z /= s;
+        return *this;
     }
 
     // overloaded operator++ to increment the xyz coordinates by 1
-    inline Vector3& operator++() 
+    inline constexpr Vector3& operator++() noexcept
     {
-        return Vector3(x += 1, y += 1, z += 1);
+        x += 1;
+        y += 1;
+        z += 1;
+        return *this;
     }
 
     // overloaded operator-- to decrease the xyz coordinates by 1
-    inline Vector3& operator--() 
+    inline constexpr Vector3& operator--() noexcept
     {
-        return Vector3(x -= 1, y -= 1, z -= 1);
+        x -= 1;
+        y -= 1;
+        z -= 1;
+        return *this;
     }
 
     // overloaded operator[] to get/return the x, y, or z coordinate based on index
-    inline T operator[](int index)
+    inline constexpr T operator[](int index) const noexcept
     {
         T val = 0;
         switch(index)
@@ -168,13 +198,13 @@ public:
     }
 
     // overloaded operator== to test whether two vectors are equivalent
-    inline bool operator==(const Vector3& v) const 
+    inline constexpr bool operator==(const Vector3& v) const noexcept
     {
         return (x == v.x && y == v.y && z == v.z);
     }
     
     // overloaded operator!= to test whether two vectors are not equal
-    inline bool operator!=(const Vector3& v) const 
+    inline constexpr bool operator!=(const Vector3& v) const noexcept
     {
         return (x != v.x || y != v.y || z != v.z);
     }
@@ -183,26 +213,38 @@ public:
     /*                 Member Functions                  */
     /*****************************************************/
     // returns the magnitude of a vector
-    inline T mag()
+    // P selects Exact (default), Fast or Approx; see Precision.h for the error bounds
+    template <class P = Exact>
+    inline T mag() const noexcept
     {
-        return sqrt(x*x + y*y + z*z);
+        VECTOR_COUNT(MAG);
+        return Precision<P>::sqrt(x*x + y*y + z*z);
     }
     
     // returns the squared magnitude of a vector (less computationally expensive
-    inline T squaredMag()
+    inline constexpr T squaredMag() const noexcept
     {
         return (x*x + y*y + z*z);
     }
     
     // normalizes the vector (a vector in the same direction with magnitude 1)
-    inline void normalize()
+    // Fast and Approx multiply by a reciprocal square root estimate instead of dividing
+    template <class P = Exact>
+    inline void normalize() noexcept
     {
-        T m = mag();
-        *this /= m;
+        VECTOR_COUNT(NORMALIZE);
+        VECTOR_TIME(NORMALIZE);
+        if(std::is_same<P, Exact>::value)
+        {
+            T m = mag();
+            *this /= m;
+        }
+        else
+            *this *= Precision<P>::rsqrt(squaredMag());
     }
     
     // returns the distance between two vectors
-    inline T dist(const Vector3& v)
+    inline T dist(const Vector3& v) const noexcept
     {
         T dx = x-v.x;
         T dy = y-v.y;
@@ -212,7 +254,7 @@ public:
     }
     
     // returns the squared distance between two vectors (less computationally expensive)
-    inline T squaredDist(const Vector3& v)
+    inline constexpr T squaredDist(const Vector3& v) const noexcept
     {
         T dx = x-v.x;
         T dy = y-v.y;
@@ -222,34 +264,46 @@ public:
     }
 
     // returns the angle between two vectors using the dot product
-    inline T angle(const Vector3& v)
+    // Approx replaces acos with a polynomial (about 7e-5 rad absolute error)
+    template <class P = Exact>
+    inline T angle(const Vector3& v) const noexcept
     {
+        if(!std::is_same<P, Exact>::value)
+        {
+            // separate rsqrts so |a|^2 * |b|^2 cannot overflow
+            T c = dot(v) * Precision<P>::rsqrt(squaredMag()) * Precision<P>::rsqrt(v.squaredMag());
+            c = c > 1 ? T(1) : (c < -1 ? T(-1) : c);
+            return Precision<P>::acos(c);
+        }
         T d = dot(v);
         T am = mag();
-        Vector3 b = v;
-        T bm = b.mag();
+        T bm = v.mag();
         T ang = acos(d/(am*bm));
 
         return ang;
     }
 
     // returns the dot product (scalar value) of two vectors
-    inline T dot(const Vector3& v)
+    inline constexpr T dot(const Vector3& v) const noexcept
     {
+        VECTOR_COUNT(DOT);
         return (x*v.x + y*v.y + z*v.z);
     }
 
     // returns the cross product (perpendicular vector) of two vectors
-    inline Vector3 cross(const Vector3& v)
+    inline constexpr Vector3 cross(const Vector3& v) const noexcept
     {
+        VECTOR_COUNT(CROSS);
         return Vector3(y*v.z - z*v.y,
                        z*v.x - x*v.z,
                        x*v.y - y*v.x);
     }
 
     // rotates a vector around an axis by a certain number of degrees
-    inline Vector3& rotate(T theta, const Vector3& axis) 
+    inline Vector3& rotate(T theta, const Vector3& axis) noexcept
     {
+        VECTOR_COUNT(ROTATE);
+        VECTOR_TIME(ROTATE);
         T s = sin(theta);
         T c = cos(theta);
         T k = 1.0 - c;
@@ -274,72 +328,72 @@ public:
     /*****************************************************/
     /*                 Getters & Setters                 */
     /*****************************************************/
-    inline T getX() const
+    inline constexpr T getX() const noexcept
     {
         return x;
     }
     
-    inline void setX(T x)
+    inline constexpr void setX(T x) noexcept
     {
         this->x = x;
     }
     
-    inline T getY() const
+    inline constexpr T getY() const noexcept
     {
         return y;
     }
     
-    inline void setY(T y)
+    inline constexpr void setY(T y) noexcept
     {
         this->y = y;
     }
     
-    inline T getZ() const
+    inline constexpr T getZ() const noexcept
     {
         return z;
     }
     
-    inline void setZ(T z)
+    inline constexpr void setZ(T z) noexcept
     {
         this->z = z;
     }
     
-    inline U getR() const
+    inline constexpr U getR() const noexcept
     {
         return r;
     }
     
-    inline void setR(U r)
+    inline constexpr void setR(U r) noexcept
     {
         this->r = r;
     }
     
-    inline U getG() const
+    inline constexpr U getG() const noexcept
     {
         return g;
     }
     
-    inline void setG(U g)
+    inline constexpr void setG(U g) noexcept
     {
         this->g = g;
     }
     
-    inline U getB() const
+    inline constexpr U getB() const noexcept
     {
         return b;
     }
     
-    inline void setB(U b)
+    inline constexpr void setB(U b) noexcept
     {
         this->b = b;
     }
     
-    inline U getA() const
+    inline constexpr U getA() const noexcept
     {
         return a;
     }
     
-    inline void setA(U a)
+    inline constexpr void setA(U a) noexcept
     {
         this->a = a;
     }
@@ -383,67 +437,67 @@ public:
     }
     
     // overloaded operator+ to add two vectors
-    inline friend Vector3 operator+(const Vector3& lhs, const Vector3& rhs)
+    inline friend constexpr Vector3 operator+(const Vector3& lhs, const Vector3& rhs) noexcept
     {
-        return Vector3(lhs) += rhs;
+        return Vector3(lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z);
     }
     
     // overloaded operator+ to add a scalar (left side) with a vector (right side)
-    inline friend Vector3 operator+(const T s, const Vector3& v)
+    inline friend constexpr Vector3 operator+(const T s, const Vector3& v) noexcept
     {
         return Vector3(v.x + s, v.y + s, v.z + s);
     }
     
     // overloaded operator+ to add a vector (left side) with a scalar (right side)
-    inline friend Vector3 operator+(const Vector3& v, const T s)
+    inline friend constexpr Vector3 operator+(const Vector3& v, const T s) noexcept
     {
         return Vector3(v.x + s, v.y + s, v.z + s);
     }
     
     // overloaded operator- to subtract two vectors
-    inline friend Vector3 operator-(const Vector3& lhs, const Vector3& rhs)
+    inline friend constexpr Vector3 operator-(const Vector3& lhs, const Vector3& rhs) noexcept
     {
-        return Vector3(lhs) -= rhs;
+        return Vector3(lhs.x - rhs.x, lhs.y - rhs.y, lhs.z - rhs.z);
     }
     
     // overloaded operator- to flip the direction of a vector and add a scalar
-    inline friend Vector3 operator-(const T s, const Vector3& v)
+    inline friend constexpr Vector3 operator-(const T s, const Vector3& v) noexcept
     {
         return Vector3(s - v.x, s - v.y, s - v.z);
     }
     
     // overloaded operator- to subtract a scalar from a vector
-    inline friend Vector3 operator-(const Vector3& v, const T s)
+    inline friend constexpr Vector3 operator-(const Vector3& v, const T s) noexcept
     {
         return Vector3(v.x - s, v.y - s, v.z - s);
     }
     
     // overloaded operator- to return a vector in the opposite direction
-    inline friend Vector3 operator-(const Vector3& v)
+    inline friend constexpr Vector3 operator-(const Vector3& v) noexcept
     {
         return Vector3(-v.x, -v.y, -v.z);
     }
     
     // overloaded operator* to multiply a vector (right side) by a scalar (left side)
-    inline friend Vector3 operator*(const T s, const Vector3& v)
+    inline friend constexpr Vector3 operator*(const T s, const Vector3& v) noexcept
     {
         return Vector3(v.x * s, v.y * s, v.z * s);
     }
     
     // overloaded operator* to multiply a vector (left side) by a scalar (right side)
-    inline friend Vector3 operator*(const Vector3& v, const T s)
+    inline friend constexpr Vector3 operator*(const Vector3& v, const T s) noexcept
     {
         return Vector3(v.x * s, v.y * s, v.z * s);
     }
     
     // overloaded operator/ to divide a vector (left side) by a scalar (right side)
-    inline friend Vector3 operator/(const Vector3& v, const T s)
+    inline friend constexpr Vector3 operator/(const Vector3& v, const T s) noexcept
     {
         return Vector3(v.x / s, v.y / s, v.z / s);
     }
     
     // returns the cross product (perpendicular vector) of two vectors
-    inline friend Vector3 cross(const Vector3& lhs, const Vector3& rhs)
+    inline friend constexpr Vector3 cross(const Vector3& lhs, const Vector3& rhs) noexcept
     {
         return Vector3(lhs.y*rhs.z - lhs.z*rhs.y,
                        lhs.z*rhs.x - lhs.x*rhs.z,
@@ -451,20 +505,22 @@ public:
     }
     
     // returns the magnitude of a vector
-    inline friend T mag(const Vector3& v)
+    inline friend T mag(const Vector3& v) noexcept
     {
         return sqrt(v.x*v.x + v.y*v.y + v.z*v.z);
     }
     
     // returns the dot product (scalar value) of two vectors
-    inline friend T dot(const Vector3& lhs, const Vector3& rhs)
+    inline friend constexpr T dot(const Vector3& lhs, const Vector3& rhs) noexcept
     {
         return (lhs.x*rhs.x + lhs.y*rhs.y + lhs.z*rhs.z);
     }
     
     // rotates a vector around an axis by a certain number of degrees
-    inline friend Vector3 rotate(T theta, const Vector3& axis, const Vector3& v)
+    inline friend Vector3 rotate(T theta, const Vector3& axis, const Vector3& v) noexcept
     {
+        VECTOR_COUNT(ROTATE);
+        VECTOR_TIME(ROTATE);
         Vector3 rv;
         T s = sin(theta);
         T c = cos(theta);
@@ -485,7 +541,7 @@ public:
     }
     
     // returns the angle between two vectors using the dot product
-    inline friend T angle(const Vector3& lhs, const Vector3& rhs)
+    inline friend T angle(const Vector3& lhs, const Vector3& rhs) noexcept
     {
         T d = dot(lhs, rhs);
         T lm = mag(lhs);
@@ -496,5 +552,111 @@ public:
     }
 };
 
+#ifndef VECTOR_INSTRUMENT
+static_assert(std::is_trivially_copyable<Vector3<> >::value,
+              "Vector3 must stay trivially copyable so bulk copies lower to memcpy");
+#endif
+
+/*****************************************************/
+/*                     Hashing                       */
+/*****************************************************/
+// std::hash<Vector3> hashes the coordinates exactly, consistent with
+// operator== (-0 and +0 hash alike; color is ignored). Vector3QuantizedHash
+// and Vector3QuantizedEqual instead snap the coordinates to a grid of cubes
+// of side cell, so all vectors in one cube are equal: points closer than cell
+// usually share a cube, but two points on either side of a cube face never do
+
+// the 64-bit finalizer of MurmurHash3
+inline uint64_t hashMix64(uint64_t h) noexcept
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// the bits of c, with -0 folded onto +0
+template <class T>
+inline int64_t coordinateBits(T c) noexcept
+{
+    static_assert(sizeof(T) <= sizeof(int64_t), "coordinateBits needs a type of at most 64 bits");
+    c = c + T(0);
+    int64_t bits = 0;
+    std::memcpy(&bits, &c, sizeof(T));
+    return bits;
+}
+
+// floor(c*invCell) clamped to +-2^62, and 2^63 - 1 for NaN; an invCell of 0
+// gives coordinateBits(c), so the quantized forms become exact
+template <class T>
+inline int64_t quantizeCoordinate(T c, T invCell) noexcept
+{
+    if(invCell == T(0))
+        return coordinateBits(c);
+    T q = std::floor(c*invCell);
+    const T limit = T(4611686018427387904.0);
+    if(!(q == q))
+        return INT64_MAX;
+    return int64_t(q < -limit ? -limit : (q > limit ? limit : q));
+}
+
+inline uint64_t hashCoordinates(int64_t x, int64_t y, int64_t z) noexcept
+{
+    return hashMix64(uint64_t(x)*0x9e3779b97f4a7c15ull ^ uint64_t(y)*0xc2b2ae3d27d4eb4full
+                     ^ uint64_t(z)*0x165667b19e3779f9ull);
+}
+
+template <class T = float, class U = int>
+struct Vector3QuantizedHash
+{
+    T invCell;
+
+    // a cell of 0 hashes exactly
+    explicit Vector3QuantizedHash(T cell = T(0)):
+    invCell(cell > T(0) ? T(1) / cell : T(0))
+    {
+    }
+
+    inline size_t operator()(const Vector3<T, U>& v) const noexcept
+    {
+        return size_t(hashCoordinates(quantizeCoordinate(v.getX(), invCell),
+                                      quantizeCoordinate(v.getY(), invCell),
+                                      quantizeCoordinate(v.getZ(), invCell)));
+    }
+};
+
+template <class T = float, class U = int>
+struct Vector3QuantizedEqual
+{
+    T invCell;
+
+    explicit Vector3QuantizedEqual(T cell = T(0)):
+    invCell(cell > T(0) ? T(1) / cell : T(0))
+    {
+    }
+
+    inline bool operator()(const Vector3<T, U>& a, const Vector3<T, U>& b) const noexcept
+    {
+        return quantizeCoordinate(a.getX(), invCell) == quantizeCoordinate(b.getX(), invCell)
+            && quantizeCoordinate(a.getY(), invCell) == quantizeCoordinate(b.getY(), invCell)
+            && quantizeCoordinate(a.getZ(), invCell) == quantizeCoordinate(b.getZ(), invCell);
+    }
+};
+
+namespace std
+{
+    template <class T, class U>
+    struct hash<Vector3<T, U> >
+    {
+        inline size_t operator()(const Vector3<T, U>& v) const noexcept
+        {
+            return size_t(hashCoordinates(coordinateBits(v.getX()), coordinateBits(v.getY()),
+                                          coordinateBits(v.getZ())));
+        }
+    };
+}
+
 #endif	/* VECTOR3_H */
 
@@ -0,0 +1,471 @@
+#ifndef VECTOR3ARRAY_H
+#define	VECTOR3ARRAY_H
+
+#include "Vector3.h"
+#include "VectorKernels.h"
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// structure-of-arrays container for large batches of Vector3s
+// x, y and z live in separate contiguous streams so bulk passes only touch
+// the coordinates; the rgba color stream is optional and left empty unless
+// requested, since most transform passes never read it
+//
+// element by element operations between two arrays (or an array and a
+// std::vector of scalars) need operands of the same size(); this is asserted,
+// and a shorter operand is otherwise read past its end
+template <class T = float, class U = int>
+class Vector3Array
+{
+private:
+    std::vector<T> xs, ys, zs; // coordinate streams
+    std::vector<U> rgba; // interleaved r, g, b, a stream (empty when color is disabled)
+    bool color; // whether the rgba stream is kept
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    // default constructor (creates an empty array without color)
+    inline Vector3Array():
+    color(false)
+    {
+    }
+
+    // constructor for n zero vectors, optionally with a color stream
+    inline explicit Vector3Array(size_t n, bool withColor = false):
+    xs(n), ys(n), zs(n), color(withColor)
+    {
+        if(color)
+            rgba.resize(4*n);
+    }
+
+    // constructor converting from an array of Vector3s (array of structures)
+    inline explicit Vector3Array(const std::vector<Vector3<T, U> >& v, bool withColor = false):
+    xs(v.size()), ys(v.size()), zs(v.size()), color(withColor)
+    {
+        if(color)
+            rgba.resize(4*v.size());
+        for(size_t i = 0; i < v.size(); ++i)
+            set(i, v[i]);
+    }
+
+    /*****************************************************/
+    /*                  Size & Storage                   */
+    /*****************************************************/
+    inline size_t size() const
+    {
+        return xs.size();
+    }
+
+    inline bool empty() const
+    {
+        return xs.empty();
+    }
+
+    inline bool hasColor() const
+    {
+        return color;
+    }
+
+    // adds a color stream (zero filled) if the array does not have one yet
+    inline void enableColor()
+    {
+        if(!color)
+            rgba.assign(4*size(), U(0));
+        color = true;
+    }
+
+    inline void disableColor()
+    {
+        std::vector<U>().swap(rgba);
+        color = false;
+    }
+
+    inline void reserve(size_t n)
+    {
+        xs.reserve(n);
+        ys.reserve(n);
+        zs.reserve(n);
+        if(color)
+            rgba.reserve(4*n);
+    }
+
+    inline void resize(size_t n)
+    {
+        xs.resize(n);
+        ys.resize(n);
+        zs.resize(n);
+        if(color)
+            rgba.resize(4*n);
+    }
+
+    inline void clear()
+    {
+        xs.clear();
+        ys.clear();
+        zs.clear();
+        rgba.clear();
+    }
+
+    inline void push_back(const Vector3<T, U>& v)
+    {
+        xs.push_back(v.getX());
+        ys.push_back(v.getY());
+        zs.push_back(v.getZ());
+        if(color)
+        {
+            rgba.push_back(v.getR());
+            rgba.push_back(v.getG());
+            rgba.push_back(v.getB());
+            rgba.push_back(v.getA());
+        }
+    }
+
+    /*****************************************************/
+    /*                 AoS Conversion                    */
+    /*****************************************************/
+    // returns element i as a Vector3 (color is zero when there is no color stream)
+    inline Vector3<T, U> get(size_t i) const
+    {
+        if(!color)
+            return Vector3<T, U>(xs[i], ys[i], zs[i], U(0), U(0), U(0), U(0));
+        return Vector3<T, U>(xs[i], ys[i], zs[i],
+                             rgba[4*i], rgba[4*i + 1], rgba[4*i + 2], rgba[4*i + 3]);
+    }
+
+    // overwrites element i (color is only stored when there is a color stream)
+    inline void set(size_t i, const Vector3<T, U>& v)
+    {
+        xs[i] = v.getX();
+        ys[i] = v.getY();
+        zs[i] = v.getZ();
+        if(color)
+        {
+            rgba[4*i] = v.getR();
+            rgba[4*i + 1] = v.getG();
+            rgba[4*i + 2] = v.getB();
+            rgba[4*i + 3] = v.getA();
+        }
+    }
+
+    // converts back to an array of Vector3s
+    inline std::vector<Vector3<T, U> > toVector3s() const
+    {
+        std::vector<Vector3<T, U> > v;
+        v.reserve(size());
+        for(size_t i = 0; i < size(); ++i)
+            v.push_back(get(i));
+        return v;
+    }
+
+    /*****************************************************/
+    /*              Member Overloaded Ops                */
+    /*****************************************************/
+    // overloaded operator+= for adding two arrays element by element (same size)
+    inline Vector3Array& operator+=(const Vector3Array& v)
+    {
+        assert(v.size() == size());
+        const size_t n = size();
+        T* px = xs.data(); T* py = ys.data(); T* pz = zs.data();
+        const T* vx = v.xs.data(); const T* vy = v.ys.data(); const T* vz = v.zs.data();
+        for(size_t i = 0; i < n; ++i)
+        {
+            px[i] += vx[i];
+            py[i] += vy[i];
+            pz[i] += vz[i];
+        }
+        return *this;
+    }
+
+    // overloaded operator+= for adding one vector to every element
+    inline Vector3Array& operator+=(const Vector3<T, U>& v)
+    {
+        addOffset(v.getX(), v.getY(), v.getZ());
+        return *this;
+    }
+
+    // overloaded operator+= for adding a scalar to every element
+    inline Vector3Array& operator+=(T s)
+    {
+        addOffset(s, s, s);
+        return *this;
+    }
+
+    // overloaded operator-= for subtracting two arrays element by element (same size)
+    inline Vector3Array& operator-=(const Vector3Array& v)
+    {
+        assert(v.size() == size());
+        const size_t n = size();
+        T* px = xs.data(); T* py = ys.data(); T* pz = zs.data();
+        const T* vx = v.xs.data(); const T* vy = v.ys.data(); const T* vz = v.zs.data();
+        for(size_t i = 0; i < n; ++i)
+        {
+            px[i] -= vx[i];
+            py[i] -= vy[i];
+            pz[i] -= vz[i];
+        }
+        return *this;
+    }
+
+    // overloaded operator-= for subtracting one vector from every element
+    inline Vector3Array& operator-=(const Vector3<T, U>& v)
+    {
+        addOffset(-v.getX(), -v.getY(), -v.getZ());
+        return *this;
+    }
+
+    // overloaded operator-= for subtracting a scalar from every element
+    inline Vector3Array& operator-=(T s)
+    {
+        addOffset(-s, -s, -s);
+        return *this;
+    }
+
+    // overloaded operator*= for multiplying every element by a scalar
+    inline Vector3Array& operator*=(T s)
+    {
+        const size_t n = size();
+        T* px = xs.data(); T* py = ys.data(); T* pz = zs.data();
+        for(size_t i = 0; i < n; ++i)
+        {
+            px[i] *= s;
+            py[i] *= s;
+            pz[i] *= s;
+        }
+        return *this;
+    }
+
+    // overloaded operator*= for scaling each element by the matching scalar in s (same size)
+    inline Vector3Array& operator*=(const std::vector<T>& s)
+    {
+        assert(s.size() == size());
+        const size_t n = size();
+        T* px = xs.data(); T* py = ys.data(); T* pz = zs.data();
+        const T* ps = s.data();
+        for(size_t i = 0; i < n; ++i)
+        {
+            px[i] *= ps[i];
+            py[i] *= ps[i];
+            pz[i] *= ps[i];
+        }
+        return *this;
+    }
+
+    // overloaded operator/= for dividing every element by a scalar
+    inline Vector3Array& operator/=(T s)
+    {
+        const size_t n = size();
+        T* px = xs.data(); T* py = ys.data(); T* pz = zs.data();
+        for(size_t i = 0; i < n; ++i)
+        {
+            px[i] /= s;
+            py[i] /= s;
+            pz[i] /= s;
+        }
+        return *this;
+    }
+
+    // overloaded operator/= for dividing each element by the matching scalar in s (same size)
+    inline Vector3Array& operator/=(const std::vector<T>& s)
+    {
+        assert(s.size() == size());
+        const size_t n = size();
+        T* px = xs.data(); T* py = ys.data(); T* pz = zs.data();
+        const T* ps = s.data();
+        for(size_t i = 0; i < n; ++i)
+        {
+            px[i] /= ps[i];
+            py[i] /= ps[i];
+            pz[i] /= ps[i];
+        }
+        return *this;
+    }
+
+    // overloaded operator[] returning element i as a Vector3
+    inline Vector3<T, U> operator[](size_t i) const
+    {
+        return get(i);
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // writes the magnitude of every element into out (size() values)
+    // P selects the precision policy (see Precision.h)
+    template <class P = Exact>
+    inline void mag(T* out) const
+    {
+        magBatch<P>(xs.data(), ys.data(), zs.data(), out, size());
+    }
+
+    // writes the squared magnitude of every element into out (less computationally expensive)
+    inline void squaredMag(T* out) const
+    {
+        squaredMagBatch(xs.data(), ys.data(), zs.data(), out, size());
+    }
+
+    // normalizes every element (same direction with magnitude 1)
+    template <class P = Exact>
+    inline void normalize()
+    {
+        normalizeBatch<P>(xs.data(), ys.data(), zs.data(), size());
+    }
+
+    // writes the element by element dot product with v into out
+    inline void dot(const Vector3Array& v, T* out) const
+    {
+        assert(v.size() == size());
+        dotBatch(xs.data(), ys.data(), zs.data(),
+                 v.xs.data(), v.ys.data(), v.zs.data(), out, size());
+    }
+
+    // writes the dot product of every element with a single vector into out
+    inline void dot(const Vector3<T, U>& v, T* out) const
+    {
+        const size_t n = size();
+        const T* px = xs.data(); const T* py = ys.data(); const T* pz = zs.data();
+        const T vx = v.getX(), vy = v.getY(), vz = v.getZ();
+        for(size_t i = 0; i < n; ++i)
+            out[i] = px[i]*vx + py[i]*vy + pz[i]*vz;
+    }
+
+    // returns the element by element cross product with v
+    inline Vector3Array cross(const Vector3Array& v) const
+    {
+        assert(v.size() == size());
+        Vector3Array c(size());
+        crossBatch(xs.data(), ys.data(), zs.data(),
+                   v.xs.data(), v.ys.data(), v.zs.data(),
+                   c.xs.data(), c.ys.data(), c.zs.data(), size());
+        return c;
+    }
+
+    // writes the element by element distance to v into out
+    inline void dist(const Vector3Array& v, T* out) const
+    {
+        assert(v.size() == size());
+        distBatch(xs.data(), ys.data(), zs.data(),
+                  v.xs.data(), v.ys.data(), v.zs.data(), out, size());
+    }
+
+    // writes the distance of every element to a single point into out
+    inline void dist(const Vector3<T, U>& v, T* out) const
+    {
+        squaredDist(v, out);
+        const size_t n = size();
+        for(size_t i = 0; i < n; ++i)
+            out[i] = std::sqrt(out[i]);
+    }
+
+    // writes the element by element squared distance to v into out (less computationally expensive)
+    inline void squaredDist(const Vector3Array& v, T* out) const
+    {
+        assert(v.size() == size());
+        squaredDistBatch(xs.data(), ys.data(), zs.data(),
+                         v.xs.data(), v.ys.data(), v.zs.data(), out, size());
+    }
+
+    // writes the squared distance of every element to a single point into out
+    inline void squaredDist(const Vector3<T, U>& v, T* out) const
+    {
+        const size_t n = size();
+        const T* px = xs.data(); const T* py = ys.data(); const T* pz = zs.data();
+        const T vx = v.getX(), vy = v.getY(), vz = v.getZ();
+        for(size_t i = 0; i < n; ++i)
+        {
+            T dx = px[i] - vx;
+            T dy = py[i] - vy;
+            T dz = pz[i] - vz;
+            out[i] = dx*dx + dy*dy + dz*dz;
+        }
+    }
+
+    // rotates every element around an axis by theta radians
+    // the rotation matrix is built once and then streamed over the coordinates
+    inline Vector3Array& rotate(T theta, const Vector3<T, U>& axis)
+    {
+        const T ax = axis.getX(), ay = axis.getY(), az = axis.getZ();
+        const T s = std::sin(theta);
+        const T c = std::cos(theta);
+        const T k = T(1) - c;
+
+        const T m00 = c + k*ax*ax,    m01 = k*ax*ay - s*az, m02 = k*ax*az + s*ay;
+        const T m10 = k*ax*ay + s*az, m11 = c + k*ay*ay,    m12 = k*ay*az - s*ax;
+        const T m20 = k*ax*az - s*ay, m21 = k*ay*az + s*ax, m22 = c + k*az*az;
+
+        const size_t n = size();
+        T* px = xs.data(); T* py = ys.data(); T* pz = zs.data();
+        for(size_t i = 0; i < n; ++i)
+        {
+            T x = px[i], y = py[i], z = pz[i];
+            px[i] = x*m00 + y*m01 + z*m02;
+            py[i] = x*m10 + y*m11 + z*m12;
+            pz[i] = x*m20 + y*m21 + z*m22;
+        }
+        return *this;
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline T* getXStream()
+    {
+        return xs.data();
+    }
+
+    inline const T* getXStream() const
+    {
+        return xs.data();
+    }
+
+    inline T* getYStream()
+    {
+        return ys.data();
+    }
+
+    inline const T* getYStream() const
+    {
+        return ys.data();
+    }
+
+    inline T* getZStream()
+    {
+        return zs.data();
+    }
+
+    inline const T* getZStream() const
+    {
+        return zs.data();
+    }
+
+    // interleaved r, g, b, a values (null when there is no color stream)
+    inline U* getRGBAStream()
+    {
+        return color ? rgba.data() : 0;
+    }
+
+    inline const U* getRGBAStream() const
+    {
+        return color ? rgba.data() : 0;
+    }
+
+private:
+    // adds (sx, sy, sz) to every element
+    inline void addOffset(T sx, T sy, T sz)
+    {
+        const size_t n = size();
+        T* px = xs.data(); T* py = ys.data(); T* pz = zs.data();
+        for(size_t i = 0; i < n; ++i)
+        {
+            px[i] += sx;
+            py[i] += sy;
+            pz[i] += sz;
+        }
+    }
+};
+
+#endif	/* VECTOR3ARRAY_H */
+
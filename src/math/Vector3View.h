@@ -0,0 +1,103 @@
+#ifndef VECTOR3VIEW_H
+#define	VECTOR3VIEW_H
+
+#include "Vector3.h"
+#include "Vector3Array.h"
+#include <cstddef>
+
+// non-owning structure-of-arrays view over n vectors held in three separate
+// x, y and z streams (a Vector3Array, a memory-mapped file, ...)
+// it never copies or frees the streams, so they must outlive the view; the
+// stream accessors match Vector3Array's, so the batch kernels in
+// VectorKernels.h run on a view exactly as they do on an array
+template <class T = float, class U = int>
+class Vector3View
+{
+private:
+    const T* xs;
+    const T* ys;
+    const T* zs;
+    size_t n;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    inline constexpr Vector3View() noexcept:
+    xs(0), ys(0), zs(0), n(0)
+    {
+    }
+
+    inline constexpr Vector3View(const T* x, const T* y, const T* z, size_t n) noexcept:
+    xs(x), ys(y), zs(z), n(n)
+    {
+    }
+
+    inline Vector3View(const Vector3Array<T, U>& a) noexcept:
+    xs(a.getXStream()), ys(a.getYStream()), zs(a.getZStream()), n(a.size())
+    {
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    inline constexpr size_t size() const noexcept
+    {
+        return n;
+    }
+
+    inline constexpr bool empty() const noexcept
+    {
+        return n == 0;
+    }
+
+    // returns element i as a Vector3 (no bounds checking)
+    inline constexpr Vector3<T, U> get(size_t i) const noexcept
+    {
+        return Vector3<T, U>(xs[i], ys[i], zs[i]);
+    }
+
+    inline constexpr Vector3<T, U> operator[](size_t i) const noexcept
+    {
+        return get(i);
+    }
+
+    // returns the view of elements [begin, begin + count)
+    inline constexpr Vector3View subview(size_t begin, size_t count) const noexcept
+    {
+        return Vector3View(xs + begin, ys + begin, zs + begin, count);
+    }
+
+    // copies the view into an owning array
+    inline Vector3Array<T, U> toArray() const
+    {
+        Vector3Array<T, U> a(n);
+        for(size_t i = 0; i < n; ++i)
+        {
+            a.getXStream()[i] = xs[i];
+            a.getYStream()[i] = ys[i];
+            a.getZStream()[i] = zs[i];
+        }
+        return a;
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline constexpr const T* getXStream() const noexcept
+    {
+        return xs;
+    }
+
+    inline constexpr const T* getYStream() const noexcept
+    {
+        return ys;
+    }
+
+    inline constexpr const T* getZStream() const noexcept
+    {
+        return zs;
+    }
+};
+
+#endif	/* VECTOR3VIEW_H */
@@ -0,0 +1,569 @@
+#ifndef VECTORCODEC_H
+#define	VECTORCODEC_H
+
+#include "Simd.h"
+#include "Vector3.h"
+#include "Vector3Array.h"
+#include "VectorKernels.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// compressed storage for vertex positions and unit normals
+//
+// three encodings, each kept as separate 16-bit streams so a decode pass
+// streams half (float) or a quarter (double) of the bytes of the source:
+//
+//   half (fp16), 6 bytes per position:
+//     |decoded - v| <= 2^-11 |v| per component for 2^-14 <= |v| <= 65504,
+//     <= 2^-25 below 2^-14; |v| >= 65520 becomes +-inf and NaN stays NaN.
+//     doubles are rounded to float first, adding at most 2^-24 |v|
+//   fixed point, 6 bytes per position: each axis is mapped linearly onto
+//     0..65535 over a bounding box lo..hi, so
+//     |decoded - v| <= (hi - lo) / 131070 per component, plus the rounding of
+//     the affine map (a few ulps of max(|lo|, |hi|)). points outside the box
+//     are clamped onto it
+//   octahedral, 4 bytes per unit normal: the normal is projected onto the
+//     octahedron |x| + |y| + |z| = 1, the lower half folded over the upper
+//     one, and the two resulting coordinates stored as 16-bit unorms over
+//     -1..1. the decoded normal is unit length to rounding and within 0.004
+//     degrees of the input; zero vectors decode as +z
+//
+// the 16-bit conversions run 8 (SSE2) or 16 (AVX2) floats at a time, half
+// goes through F16C when the target has it; the octahedral projection runs on
+// Pack<T> like the VectorKernels.h kernels. every path rounds the same way and
+// quiets NaNs the same way, so the encoded bits do not depend on the
+// instruction set (decoded values may differ in the last bit where FMA fuses
+// the affine map)
+
+/*****************************************************/
+/*                  Half Precision                   */
+/*****************************************************/
+// float to IEEE binary16, rounding to nearest even
+inline uint16_t halfFromFloat(float f) noexcept
+{
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    uint32_t sign = (u >> 16) & 0x8000;
+    u &= 0x7fffffff;
+    uint32_t h;
+    if(u >= 0x47800000) // 65536 and up, inf and NaN; NaN keeps the top of its
+        // payload and is made quiet, as the F16C conversion does
+        h = u > 0x7f800000 ? 0x7e00 | ((u >> 13) & 0x3ff) : 0x7c00;
+    else if(u < 0x38800000) // below 2^-14: subnormal half, rounded by a float add
+    {
+        float a, magic;
+        uint32_t m = 0x3f000000;
+        std::memcpy(&a, &u, sizeof(a));
+        std::memcpy(&magic, &m, sizeof(magic));
+        a += magic;
+        std::memcpy(&h, &a, sizeof(h));
+        h -= m;
+    }
+    else // rebias, round to nearest even; a carry out of 65504 gives inf
+        h = (u + 0xc8000fff + ((u >> 13) & 1)) >> 13;
+    return uint16_t(h | sign);
+}
+
+// IEEE binary16 to float (exact)
+inline float floatFromHalf(uint16_t h) noexcept
+{
+    uint32_t u = uint32_t(h & 0x7fff) << 13;
+    uint32_t exponent = u & 0x0f800000;
+    u += 0x38000000;
+    float f;
+    if(exponent == 0x0f800000) // inf and NaN, made quiet as F16C does
+    {
+        u += 0x38000000;
+        if(u & 0x007fe000)
+            u |= 0x00400000;
+    }
+    else if(exponent == 0) // zero and subnormals
+    {
+        uint32_t magic = 0x38800000;
+        float m;
+        u += 0x00800000;
+        std::memcpy(&f, &u, sizeof(f));
+        std::memcpy(&m, &magic, sizeof(m));
+        f -= m;
+        std::memcpy(&u, &f, sizeof(u));
+    }
+    u |= uint32_t(h & 0x8000) << 16;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+// out[i] = binary16(in[i])
+inline void encodeHalfBatch(const float* in, uint16_t* out, size_t n)
+{
+    size_t i = 0;
+#if defined(__F16C__)
+    for(; i + 8 <= n; i += 8)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+    for(; i < n; ++i)
+        out[i] = halfFromFloat(in[i]);
+}
+
+template <class T>
+inline void encodeHalfBatch(const T* in, uint16_t* out, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+        out[i] = halfFromFloat(float(in[i]));
+}
+
+// out[i] = float(in[i])
+inline void decodeHalfBatch(const uint16_t* in, float* out, size_t n)
+{
+    size_t i = 0;
+#if defined(__F16C__)
+    for(; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))));
+#endif
+    for(; i < n; ++i)
+        out[i] = floatFromHalf(in[i]);
+}
+
+template <class T>
+inline void decodeHalfBatch(const uint16_t* in, T* out, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+        out[i] = T(floatFromHalf(in[i]));
+}
+
+/*****************************************************/
+/*                   16-bit Fixed                    */
+/*****************************************************/
+// out[i] = (in[i] - offset) * scale clamped to 0..65535 and rounded half up;
+// NaN encodes as 0
+template <class T>
+inline void quantizeU16Batch(const T* in, T offset, T scale, uint16_t* out, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        T v = (in[i] - offset)*scale;
+        v = v > T(0) ? v : T(0);
+        v = v < T(65535) ? v : T(65535);
+        out[i] = uint16_t(v + T(0.5));
+    }
+}
+
+inline void quantizeU16Batch(const float* in, float offset, float scale, uint16_t* out, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256 o = _mm256_set1_ps(offset), s = _mm256_set1_ps(scale);
+    const __m256 zero = _mm256_setzero_ps(), top = _mm256_set1_ps(65535.0f), half = _mm256_set1_ps(0.5f);
+    for(; i + 16 <= n; i += 16)
+    {
+        // max(v, 0) returns 0 for NaN, as the scalar comparison does
+        __m256 a = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i), o), s);
+        __m256 b = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i + 8), o), s);
+        a = _mm256_add_ps(_mm256_min_ps(_mm256_max_ps(a, zero), top), half);
+        b = _mm256_add_ps(_mm256_min_ps(_mm256_max_ps(b, zero), top), half);
+        __m256i q = _mm256_packus_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(q, 0xd8));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128 o = _mm_set1_ps(offset), s = _mm_set1_ps(scale);
+    const __m128 zero = _mm_setzero_ps(), top = _mm_set1_ps(65535.0f), half = _mm_set1_ps(0.5f);
+    const __m128i bias = _mm_set1_epi32(32768);
+    const __m128i flip = _mm_set1_epi16(short(0x8000));
+    for(; i + 8 <= n; i += 8)
+    {
+        __m128 a = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(in + i), o), s);
+        __m128 b = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(in + i + 4), o), s);
+        a = _mm_add_ps(_mm_min_ps(_mm_max_ps(a, zero), top), half);
+        b = _mm_add_ps(_mm_min_ps(_mm_max_ps(b, zero), top), half);
+        // SSE2 has only a signed 32 -> 16 pack: shift into -32768..32767 and back
+        __m128i qa = _mm_sub_epi32(_mm_cvttps_epi32(a), bias);
+        __m128i qb = _mm_sub_epi32(_mm_cvttps_epi32(b), bias);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_xor_si128(_mm_packs_epi32(qa, qb), flip));
+    }
+#endif
+    for(; i < n; ++i)
+    {
+        float v = (in[i] - offset)*scale;
+        v = v > 0.0f ? v : 0.0f;
+        v = v < 65535.0f ? v : 65535.0f;
+        out[i] = uint16_t(v + 0.5f);
+    }
+}
+
+// out[i] = offset + in[i] * step
+template <class T>
+inline void dequantizeU16Batch(const uint16_t* in, T offset, T step, T* out, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+        out[i] = offset + T(in[i])*step;
+}
+
+inline void dequantizeU16Batch(const uint16_t* in, float offset, float step, float* out, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i q = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        fmadd(PackF8(_mm256_cvtepi32_ps(q)), PackF8(step), PackF8(offset)).store(out + i);
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 8 <= n; i += 8)
+    {
+        __m128i q = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        fmadd(PackF4(_mm_cvtepi32_ps(_mm_unpacklo_epi16(q, zero))), PackF4(step), PackF4(offset)).store(out + i);
+        fmadd(PackF4(_mm_cvtepi32_ps(_mm_unpackhi_epi16(q, zero))), PackF4(step), PackF4(offset)).store(out + i + 4);
+    }
+#endif
+    for(; i < n; ++i)
+        fmadd(ScalarPack<float>(float(in[i])), ScalarPack<float>(step), ScalarPack<float>(offset)).store(out + i);
+}
+
+/*****************************************************/
+/*                   Octahedral                      */
+/*****************************************************/
+const size_t CODEC_BLOCK = 256;
+
+// one step of the projection at offset i: (x, y, z) to octahedron coordinates
+// (u, v) in -1..1
+template <class P, class T>
+inline void octahedralEncodeStep(const T* x, const T* y, const T* z, T* u, T* v, size_t i)
+{
+    P px = P::load(x + i), py = P::load(y + i), pz = P::load(z + i);
+    P sum = abs(px) + abs(py) + abs(pz);
+    P inv = select(sum > P(0), P(1) / sum, P(0));
+    P ou = px*inv, ov = py*inv;
+    // lower hemisphere: reflect across the diagonals |u| + |v| = 1
+    P su = select(ou >= P(0), P(1), P(-1)), sv = select(ov >= P(0), P(1), P(-1));
+    P fu = (P(1) - abs(ov))*su, fv = (P(1) - abs(ou))*sv;
+    typename P::Mask lower = pz < P(0);
+    select(lower, fu, ou).store(u + i);
+    select(lower, fv, ov).store(v + i);
+}
+
+template <class P, class T>
+inline void octahedralDecodeStep(const T* u, const T* v, T* x, T* y, T* z, size_t i)
+{
+    P pu = P::load(u + i), pv = P::load(v + i);
+    P pz = P(1) - abs(pu) - abs(pv);
+    P t = max(-pz, P(0));
+    P px = pu + select(pu >= P(0), -t, t);
+    P py = pv + select(pv >= P(0), -t, t);
+    P inv = P(1) / sqrt(fmadd(pz, pz, fmadd(py, py, px*px)));
+    (px*inv).store(x + i);
+    (py*inv).store(y + i);
+    (pz*inv).store(z + i);
+}
+
+// unit normals n[i] to two 16-bit octahedral coordinates per normal
+template <class T>
+inline void encodeOctahedralBatch(const T* x, const T* y, const T* z, uint16_t* u, uint16_t* v, size_t n)
+{
+    typedef Pack<T> P;
+    typedef ScalarPack<T> S;
+    T su[CODEC_BLOCK], sv[CODEC_BLOCK];
+    for(size_t begin = 0; begin < n; begin += CODEC_BLOCK)
+    {
+        size_t m = n - begin < CODEC_BLOCK ? n - begin : CODEC_BLOCK;
+        size_t i = 0;
+        for(; i + P::width <= m; i += P::width)
+            octahedralEncodeStep<P>(x + begin, y + begin, z + begin, su, sv, i);
+        for(; i < m; ++i)
+            octahedralEncodeStep<S>(x + begin, y + begin, z + begin, su, sv, i);
+        quantizeU16Batch(su, T(-1), T(32767), u + begin, m);
+        quantizeU16Batch(sv, T(-1), T(32767), v + begin, m);
+    }
+}
+
+// octahedral coordinates back to unit normals
+template <class T>
+inline void decodeOctahedralBatch(const uint16_t* u, const uint16_t* v, T* x, T* y, T* z, size_t n)
+{
+    typedef Pack<T> P;
+    typedef ScalarPack<T> S;
+    T su[CODEC_BLOCK], sv[CODEC_BLOCK];
+    for(size_t begin = 0; begin < n; begin += CODEC_BLOCK)
+    {
+        size_t m = n - begin < CODEC_BLOCK ? n - begin : CODEC_BLOCK;
+        dequantizeU16Batch(u + begin, T(-1), T(1) / T(32767), su, m);
+        dequantizeU16Batch(v + begin, T(-1), T(1) / T(32767), sv, m);
+        size_t i = 0;
+        for(; i + P::width <= m; i += P::width)
+            octahedralDecodeStep<P>(su, sv, x + begin, y + begin, z + begin, i);
+        for(; i < m; ++i)
+            octahedralDecodeStep<S>(su, sv, x + begin, y + begin, z + begin, i);
+    }
+}
+
+/*****************************************************/
+/*                  Compressed Arrays                */
+/*****************************************************/
+// positions as three fp16 streams
+template <class T = float>
+class HalfVector3Array
+{
+private:
+    std::vector<uint16_t> xs, ys, zs;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    HalfVector3Array()
+    {
+    }
+
+    template <class U>
+    explicit HalfVector3Array(const Vector3Array<T, U>& v)
+    {
+        encode(v.getXStream(), v.getYStream(), v.getZStream(), v.size());
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    inline void encode(const T* x, const T* y, const T* z, size_t n)
+    {
+        xs.resize(n);
+        ys.resize(n);
+        zs.resize(n);
+        encodeHalfBatch(x, xs.data(), n);
+        encodeHalfBatch(y, ys.data(), n);
+        encodeHalfBatch(z, zs.data(), n);
+    }
+
+    // writes size() positions to x, y, z
+    inline void decode(T* x, T* y, T* z) const
+    {
+        decodeHalfBatch(xs.data(), x, xs.size());
+        decodeHalfBatch(ys.data(), y, ys.size());
+        decodeHalfBatch(zs.data(), z, zs.size());
+    }
+
+    // resizes v to size() and decodes into it (colors are left as they are)
+    template <class U>
+    inline void decode(Vector3Array<T, U>& v) const
+    {
+        v.resize(size());
+        decode(v.getXStream(), v.getYStream(), v.getZStream());
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline size_t size() const
+    {
+        return xs.size();
+    }
+
+    template <class U = int>
+    inline Vector3<T, U> get(size_t i) const
+    {
+        return Vector3<T, U>(T(floatFromHalf(xs[i])), T(floatFromHalf(ys[i])), T(floatFromHalf(zs[i])));
+    }
+
+    inline const uint16_t* getXStream() const
+    {
+        return xs.data();
+    }
+
+    inline const uint16_t* getYStream() const
+    {
+        return ys.data();
+    }
+
+    inline const uint16_t* getZStream() const
+    {
+        return zs.data();
+    }
+};
+
+// positions as three 16-bit fixed-point streams relative to a bounding box
+template <class T = float>
+class QuantizedVector3Array
+{
+private:
+    std::vector<uint16_t> xs, ys, zs;
+    T lo[3], hi[3];
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    QuantizedVector3Array()
+    {
+        for(int k = 0; k < 3; ++k)
+            lo[k] = hi[k] = T(0);
+    }
+
+    // quantizes v over its own bounding box
+    template <class U>
+    explicit QuantizedVector3Array(const Vector3Array<T, U>& v)
+    {
+        encode(v.getXStream(), v.getYStream(), v.getZStream(), v.size());
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // quantizes over the bounding box of the points
+    inline void encode(const T* x, const T* y, const T* z, size_t n)
+    {
+        T l[3] = { T(0), T(0), T(0) }, h[3] = { T(0), T(0), T(0) };
+        minMaxBatch(x, n, l[0], h[0]);
+        minMaxBatch(y, n, l[1], h[1]);
+        minMaxBatch(z, n, l[2], h[2]);
+        encode(x, y, z, n, l, h);
+    }
+
+    // quantizes over the box boxLo..boxHi, clamping points outside it; a
+    // sequence of meshes sharing one box decodes to consistent positions
+    inline void encode(const T* x, const T* y, const T* z, size_t n, const T boxLo[3], const T boxHi[3])
+    {
+        const T* in[3] = { x, y, z };
+        std::vector<uint16_t>* out[3] = { &xs, &ys, &zs };
+        for(int k = 0; k < 3; ++k)
+        {
+            lo[k] = boxLo[k];
+            hi[k] = boxHi[k];
+            T extent = hi[k] - lo[k];
+            out[k]->resize(n);
+            quantizeU16Batch(in[k], lo[k], extent > T(0) ? T(65535) / extent : T(0), out[k]->data(), n);
+        }
+    }
+
+    inline void decode(T* x, T* y, T* z) const
+    {
+        dequantizeU16Batch(xs.data(), lo[0], getStep(0), x, xs.size());
+        dequantizeU16Batch(ys.data(), lo[1], getStep(1), y, ys.size());
+        dequantizeU16Batch(zs.data(), lo[2], getStep(2), z, zs.size());
+    }
+
+    template <class U>
+    inline void decode(Vector3Array<T, U>& v) const
+    {
+        v.resize(size());
+        decode(v.getXStream(), v.getYStream(), v.getZStream());
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline size_t size() const
+    {
+        return xs.size();
+    }
+
+    template <class U = int>
+    inline Vector3<T, U> get(size_t i) const
+    {
+        return Vector3<T, U>(lo[0] + T(xs[i])*getStep(0), lo[1] + T(ys[i])*getStep(1), lo[2] + T(zs[i])*getStep(2));
+    }
+
+    // spacing of the grid along axis 0..2; the error bound is half of it
+    inline T getStep(int axis) const
+    {
+        return (hi[axis] - lo[axis]) / T(65535);
+    }
+
+    inline T getMin(int axis) const
+    {
+        return lo[axis];
+    }
+
+    inline T getMax(int axis) const
+    {
+        return hi[axis];
+    }
+
+    inline const uint16_t* getXStream() const
+    {
+        return xs.data();
+    }
+
+    inline const uint16_t* getYStream() const
+    {
+        return ys.data();
+    }
+
+    inline const uint16_t* getZStream() const
+    {
+        return zs.data();
+    }
+};
+
+// unit normals as two 16-bit octahedral streams
+template <class T = float>
+class OctahedralNormalArray
+{
+private:
+    std::vector<uint16_t> us, vs;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    OctahedralNormalArray()
+    {
+    }
+
+    template <class U>
+    explicit OctahedralNormalArray(const Vector3Array<T, U>& normals)
+    {
+        encode(normals.getXStream(), normals.getYStream(), normals.getZStream(), normals.size());
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // the inputs need not be exactly unit length; only their direction is kept
+    inline void encode(const T* x, const T* y, const T* z, size_t n)
+    {
+        us.resize(n);
+        vs.resize(n);
+        encodeOctahedralBatch(x, y, z, us.data(), vs.data(), n);
+    }
+
+    inline void decode(T* x, T* y, T* z) const
+    {
+        decodeOctahedralBatch(us.data(), vs.data(), x, y, z, us.size());
+    }
+
+    template <class U>
+    inline void decode(Vector3Array<T, U>& normals) const
+    {
+        normals.resize(size());
+        decode(normals.getXStream(), normals.getYStream(), normals.getZStream());
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline size_t size() const
+    {
+        return us.size();
+    }
+
+    template <class U = int>
+    inline Vector3<T, U> get(size_t i) const
+    {
+        T x, y, z;
+        decodeOctahedralBatch(&us[i], &vs[i], &x, &y, &z, 1);
+        return Vector3<T, U>(x, y, z);
+    }
+
+    inline const uint16_t* getUStream() const
+    {
+        return us.data();
+    }
+
+    inline const uint16_t* getVStream() const
+    {
+        return vs.data();
+    }
+};
+
+#endif	/* VECTORCODEC_H */
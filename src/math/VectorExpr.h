@@ -0,0 +1,435 @@
+#ifndef VECTOREXPR_H
+#define	VECTOREXPR_H
+
+#include "Vector3.h"
+#include "Vector3Array.h"
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+// expression templates for Vector3 arithmetic
+// wrapping an operand with lazy() makes +, -, * and / build a lightweight
+// expression object instead of a Vector3 temporary; nothing is computed until
+// the expression is assigned, and then each component is evaluated in one go
+// with no intermediate vectors, e.g.
+//
+//   Vector3<> r = lazy(a) + lazy(b)*s - lazy(c);
+//   lazy(positions) = lazy(positions) + lazy(velocities)*dt;   // one loop
+//
+// operands may be single Vector3s (broadcast to every element), whole
+// std::vector<Vector3<T, U> > buffers or Vector3Arrays, const or not (only
+// non-const ones can be assigned to). buffer operands must all have the size
+// of the buffer assigned to, which is asserted on assignment. only xyz is
+// evaluated: results carry no color, and assigning into a buffer leaves the
+// destination colors untouched.
+// expressions hold references to their operands, so assign them before the
+// operands go out of scope (do not store them in auto variables)
+
+/*****************************************************/
+/*                 Expression Base                   */
+/*****************************************************/
+template <class E>
+struct Vec3Expr
+{
+    inline const E& self() const
+    {
+        return static_cast<const E&>(*this);
+    }
+};
+
+/*****************************************************/
+/*                      Leaves                       */
+/*****************************************************/
+// a single Vector3, broadcast to every element (size 0)
+template <class T, class U>
+class Vec3Ref : public Vec3Expr<Vec3Ref<T, U> >
+{
+private:
+    const Vector3<T, U>& v;
+
+public:
+    typedef T value_type;
+
+    inline explicit Vec3Ref(const Vector3<T, U>& v): v(v) {}
+
+    inline T x(size_t) const { return v.getX(); }
+    inline T y(size_t) const { return v.getY(); }
+    inline T z(size_t) const { return v.getZ(); }
+    inline size_t size() const { return 0; }
+    inline bool matches(size_t) const { return true; }
+
+    inline operator Vector3<T, U>() const
+    {
+        return v;
+    }
+};
+
+// a scalar, broadcast to every component of every element (size 0)
+template <class T>
+class Vec3Scalar : public Vec3Expr<Vec3Scalar<T> >
+{
+private:
+    T s;
+
+public:
+    typedef T value_type;
+
+    inline explicit Vec3Scalar(T s): s(s) {}
+
+    inline T x(size_t) const { return s; }
+    inline T y(size_t) const { return s; }
+    inline T z(size_t) const { return s; }
+    inline size_t size() const { return 0; }
+    inline bool matches(size_t) const { return true; }
+};
+
+// a std::vector of Vector3s (array of structures)
+template <class T, class U>
+class Vec3BufferRef : public Vec3Expr<Vec3BufferRef<T, U> >
+{
+private:
+    std::vector<Vector3<T, U> >& b;
+
+public:
+    typedef T value_type;
+
+    inline explicit Vec3BufferRef(std::vector<Vector3<T, U> >& b): b(b) {}
+
+    inline T x(size_t i) const { return b[i].getX(); }
+    inline T y(size_t i) const { return b[i].getY(); }
+    inline T z(size_t i) const { return b[i].getZ(); }
+    inline size_t size() const { return b.size(); }
+    inline bool matches(size_t n) const { return b.size() == n; }
+
+    // evaluates e for every element in a single loop
+    template <class E>
+    inline Vec3BufferRef& operator=(const Vec3Expr<E>& e)
+    {
+        const E& ex = e.self();
+        const size_t n = b.size();
+        assert(ex.matches(n));
+        for(size_t i = 0; i < n; ++i)
+        {
+            T rx = ex.x(i), ry = ex.y(i), rz = ex.z(i);
+            b[i].setX(rx);
+            b[i].setY(ry);
+            b[i].setZ(rz);
+        }
+        return *this;
+    }
+
+    // buffer to buffer; the implicit copy assignment is deleted (the leaf
+    // holds a reference) and would make this ambiguous
+    inline Vec3BufferRef& operator=(const Vec3BufferRef& e)
+    {
+        return *this = static_cast<const Vec3Expr<Vec3BufferRef>&>(e);
+    }
+
+    template <class E>
+    inline Vec3BufferRef& operator+=(const Vec3Expr<E>& e)
+    {
+        return *this = *this + e;
+    }
+
+    template <class E>
+    inline Vec3BufferRef& operator-=(const Vec3Expr<E>& e)
+    {
+        return *this = *this - e;
+    }
+};
+
+// a Vector3Array (structure of arrays)
+template <class T, class U>
+class Vec3ArrayRef : public Vec3Expr<Vec3ArrayRef<T, U> >
+{
+private:
+    Vector3Array<T, U>& a;
+    T* xs; T* ys; T* zs;
+
+public:
+    typedef T value_type;
+
+    inline explicit Vec3ArrayRef(Vector3Array<T, U>& a):
+    a(a), xs(a.getXStream()), ys(a.getYStream()), zs(a.getZStream()) {}
+
+    inline T x(size_t i) const { return xs[i]; }
+    inline T y(size_t i) const { return ys[i]; }
+    inline T z(size_t i) const { return zs[i]; }
+    inline size_t size() const { return a.size(); }
+    inline bool matches(size_t n) const { return a.size() == n; }
+
+    // evaluates e for every element in a single loop over the three streams
+    template <class E>
+    inline Vec3ArrayRef& operator=(const Vec3Expr<E>& e)
+    {
+        const E& ex = e.self();
+        const size_t n = a.size();
+        assert(ex.matches(n));
+        for(size_t i = 0; i < n; ++i)
+        {
+            T rx = ex.x(i), ry = ex.y(i), rz = ex.z(i);
+            xs[i] = rx;
+            ys[i] = ry;
+            zs[i] = rz;
+        }
+        return *this;
+    }
+
+    // buffer to buffer, as for Vec3BufferRef
+    inline Vec3ArrayRef& operator=(const Vec3ArrayRef& e)
+    {
+        return *this = static_cast<const Vec3Expr<Vec3ArrayRef>&>(e);
+    }
+
+    template <class E>
+    inline Vec3ArrayRef& operator+=(const Vec3Expr<E>& e)
+    {
+        return *this = *this + e;
+    }
+
+    template <class E>
+    inline Vec3ArrayRef& operator-=(const Vec3Expr<E>& e)
+    {
+        return *this = *this - e;
+    }
+};
+
+// a const std::vector of Vector3s, read only
+template <class T, class U>
+class Vec3ConstBufferRef : public Vec3Expr<Vec3ConstBufferRef<T, U> >
+{
+private:
+    const std::vector<Vector3<T, U> >& b;
+
+public:
+    typedef T value_type;
+
+    inline explicit Vec3ConstBufferRef(const std::vector<Vector3<T, U> >& b): b(b) {}
+
+    inline T x(size_t i) const { return b[i].getX(); }
+    inline T y(size_t i) const { return b[i].getY(); }
+    inline T z(size_t i) const { return b[i].getZ(); }
+    inline size_t size() const { return b.size(); }
+    inline bool matches(size_t n) const { return b.size() == n; }
+};
+
+// a const Vector3Array, read only
+template <class T, class U>
+class Vec3ConstArrayRef : public Vec3Expr<Vec3ConstArrayRef<T, U> >
+{
+private:
+    const T* xs; const T* ys; const T* zs;
+    size_t n;
+
+public:
+    typedef T value_type;
+
+    inline explicit Vec3ConstArrayRef(const Vector3Array<T, U>& a):
+    xs(a.getXStream()), ys(a.getYStream()), zs(a.getZStream()), n(a.size()) {}
+
+    inline T x(size_t i) const { return xs[i]; }
+    inline T y(size_t i) const { return ys[i]; }
+    inline T z(size_t i) const { return zs[i]; }
+    inline size_t size() const { return n; }
+    inline bool matches(size_t m) const { return n == m; }
+};
+
+/*****************************************************/
+/*                      Nodes                        */
+/*****************************************************/
+struct Vec3AddOp { template <class T> static inline T apply(T a, T b) { return a + b; } };
+struct Vec3SubOp { template <class T> static inline T apply(T a, T b) { return a - b; } };
+struct Vec3MulOp { template <class T> static inline T apply(T a, T b) { return a * b; } };
+struct Vec3DivOp { template <class T> static inline T apply(T a, T b) { return a / b; } };
+
+// component-wise binary operation; operands are held by value (leaves only
+// keep references, so copies are cheap)
+template <class Op, class L, class R>
+class Vec3Binary : public Vec3Expr<Vec3Binary<Op, L, R> >
+{
+private:
+    L l;
+    R r;
+
+public:
+    typedef typename L::value_type value_type;
+
+    inline Vec3Binary(const L& l, const R& r): l(l), r(r) {}
+
+    inline value_type x(size_t i) const { return Op::apply(l.x(i), r.x(i)); }
+    inline value_type y(size_t i) const { return Op::apply(l.y(i), r.y(i)); }
+    inline value_type z(size_t i) const { return Op::apply(l.z(i), r.z(i)); }
+    inline size_t size() const { return l.size() ? l.size() : r.size(); }
+    inline bool matches(size_t n) const { return l.matches(n) && r.matches(n); }
+
+    // evaluates a single-vector expression
+    template <class T, class U>
+    inline operator Vector3<T, U>() const
+    {
+        return Vector3<T, U>(x(0), y(0), z(0));
+    }
+};
+
+template <class E>
+class Vec3Negate : public Vec3Expr<Vec3Negate<E> >
+{
+private:
+    E e;
+
+public:
+    typedef typename E::value_type value_type;
+
+    inline explicit Vec3Negate(const E& e): e(e) {}
+
+    inline value_type x(size_t i) const { return -e.x(i); }
+    inline value_type y(size_t i) const { return -e.y(i); }
+    inline value_type z(size_t i) const { return -e.z(i); }
+    inline size_t size() const { return e.size(); }
+    inline bool matches(size_t n) const { return e.matches(n); }
+
+    template <class T, class U>
+    inline operator Vector3<T, U>() const
+    {
+        return Vector3<T, U>(x(0), y(0), z(0));
+    }
+};
+
+/*****************************************************/
+/*                    Factories                      */
+/*****************************************************/
+template <class T, class U>
+inline Vec3Ref<T, U> lazy(const Vector3<T, U>& v)
+{
+    return Vec3Ref<T, U>(v);
+}
+
+template <class T, class U>
+inline Vec3BufferRef<T, U> lazy(std::vector<Vector3<T, U> >& b)
+{
+    return Vec3BufferRef<T, U>(b);
+}
+
+template <class T, class U>
+inline Vec3ArrayRef<T, U> lazy(Vector3Array<T, U>& a)
+{
+    return Vec3ArrayRef<T, U>(a);
+}
+
+template <class T, class U>
+inline Vec3ConstBufferRef<T, U> lazy(const std::vector<Vector3<T, U> >& b)
+{
+    return Vec3ConstBufferRef<T, U>(b);
+}
+
+template <class T, class U>
+inline Vec3ConstArrayRef<T, U> lazy(const Vector3Array<T, U>& a)
+{
+    return Vec3ConstArrayRef<T, U>(a);
+}
+
+// evaluates a single-vector expression into a Vector3
+template <class T = float, class U = int, class E>
+inline Vector3<T, U> eval(const Vec3Expr<E>& e)
+{
+    return Vector3<T, U>(e.self().x(0), e.self().y(0), e.self().z(0));
+}
+
+/*****************************************************/
+/*                    Operators                      */
+/*****************************************************/
+// expression op expression
+template <class L, class R>
+inline Vec3Binary<Vec3AddOp, L, R> operator+(const Vec3Expr<L>& l, const Vec3Expr<R>& r)
+{
+    return Vec3Binary<Vec3AddOp, L, R>(l.self(), r.self());
+}
+
+template <class L, class R>
+inline Vec3Binary<Vec3SubOp, L, R> operator-(const Vec3Expr<L>& l, const Vec3Expr<R>& r)
+{
+    return Vec3Binary<Vec3SubOp, L, R>(l.self(), r.self());
+}
+
+// component-wise product
+template <class L, class R>
+inline Vec3Binary<Vec3MulOp, L, R> operator*(const Vec3Expr<L>& l, const Vec3Expr<R>& r)
+{
+    return Vec3Binary<Vec3MulOp, L, R>(l.self(), r.self());
+}
+
+// component-wise quotient
+template <class L, class R>
+inline Vec3Binary<Vec3DivOp, L, R> operator/(const Vec3Expr<L>& l, const Vec3Expr<R>& r)
+{
+    return Vec3Binary<Vec3DivOp, L, R>(l.self(), r.self());
+}
+
+template <class E>
+inline Vec3Negate<E> operator-(const Vec3Expr<E>& e)
+{
+    return Vec3Negate<E>(e.self());
+}
+
+// expression op Vector3 (the Vector3 is broadcast)
+template <class L, class T, class U>
+inline Vec3Binary<Vec3AddOp, L, Vec3Ref<T, U> > operator+(const Vec3Expr<L>& l, const Vector3<T, U>& r)
+{
+    return Vec3Binary<Vec3AddOp, L, Vec3Ref<T, U> >(l.self(), Vec3Ref<T, U>(r));
+}
+
+template <class T, class U, class R>
+inline Vec3Binary<Vec3AddOp, Vec3Ref<T, U>, R> operator+(const Vector3<T, U>& l, const Vec3Expr<R>& r)
+{
+    return Vec3Binary<Vec3AddOp, Vec3Ref<T, U>, R>(Vec3Ref<T, U>(l), r.self());
+}
+
+template <class L, class T, class U>
+inline Vec3Binary<Vec3SubOp, L, Vec3Ref<T, U> > operator-(const Vec3Expr<L>& l, const Vector3<T, U>& r)
+{
+    return Vec3Binary<Vec3SubOp, L, Vec3Ref<T, U> >(l.self(), Vec3Ref<T, U>(r));
+}
+
+template <class T, class U, class R>
+inline Vec3Binary<Vec3SubOp, Vec3Ref<T, U>, R> operator-(const Vector3<T, U>& l, const Vec3Expr<R>& r)
+{
+    return Vec3Binary<Vec3SubOp, Vec3Ref<T, U>, R>(Vec3Ref<T, U>(l), r.self());
+}
+
+// expression op scalar
+template <class L>
+inline Vec3Binary<Vec3AddOp, L, Vec3Scalar<typename L::value_type> >
+operator+(const Vec3Expr<L>& l, typename L::value_type s)
+{
+    return Vec3Binary<Vec3AddOp, L, Vec3Scalar<typename L::value_type> >(l.self(), Vec3Scalar<typename L::value_type>(s));
+}
+
+template <class L>
+inline Vec3Binary<Vec3SubOp, L, Vec3Scalar<typename L::value_type> >
+operator-(const Vec3Expr<L>& l, typename L::value_type s)
+{
+    return Vec3Binary<Vec3SubOp, L, Vec3Scalar<typename L::value_type> >(l.self(), Vec3Scalar<typename L::value_type>(s));
+}
+
+template <class L>
+inline Vec3Binary<Vec3MulOp, L, Vec3Scalar<typename L::value_type> >
+operator*(const Vec3Expr<L>& l, typename L::value_type s)
+{
+    return Vec3Binary<Vec3MulOp, L, Vec3Scalar<typename L::value_type> >(l.self(), Vec3Scalar<typename L::value_type>(s));
+}
+
+template <class R>
+inline Vec3Binary<Vec3MulOp, Vec3Scalar<typename R::value_type>, R>
+operator*(typename R::value_type s, const Vec3Expr<R>& r)
+{
+    return Vec3Binary<Vec3MulOp, Vec3Scalar<typename R::value_type>, R>(Vec3Scalar<typename R::value_type>(s), r.self());
+}
+
+template <class L>
+inline Vec3Binary<Vec3DivOp, L, Vec3Scalar<typename L::value_type> >
+operator/(const Vec3Expr<L>& l, typename L::value_type s)
+{
+    return Vec3Binary<Vec3DivOp, L, Vec3Scalar<typename L::value_type> >(l.self(), Vec3Scalar<typename L::value_type>(s));
+}
+
+#endif	/* VECTOREXPR_H */
+
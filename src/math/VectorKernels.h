@@ -0,0 +1,535 @@
+#ifndef VECTORKERNELS_H
+#define	VECTORKERNELS_H
+
+#include "Simd.h"
+#include "Precision.h"
+#include <cstddef>
+#include <type_traits>
+
+// batch versions of the Vector3 dot, cross, mag, normalize and dist member
+// functions over structure-of-arrays float or double buffers
+// each kernel runs Pack<T>::width lanes at a time (4/8/16 floats or 2/4/8
+// doubles for SSE2/AVX2/AVX-512) and finishes the last n % width elements with
+// the same code instantiated for a single scalar lane
+//
+// tolerance: the kernels evaluate the same expressions as the scalar member
+// functions, except that multiply-adds may be fused differently on either side
+// when the target has FMA, so
+//   dot:                |batch - scalar| <= 4 eps (|ax*bx| + |ay*by| + |az*bz|)
+//   mag, dist, squared: |batch - scalar| <= 4 eps |scalar|
+//   cross:              |batch - scalar| <= 2 eps (|ay*bz| + |az*by|) per component
+//   normalize:          |batch - scalar| <= 4 eps per component
+// with eps = 2^-24 for float and 2^-53 for double; without FMA the results are
+// bit-identical to the scalar code. inputs and outputs may alias element-wise
+
+/*****************************************************/
+/*                  Kernel Bodies                    */
+/*****************************************************/
+// one step of each kernel at offset i, for any pack width
+template <class P, class T>
+inline void dotStep(const T* ax, const T* ay, const T* az,
+                    const T* bx, const T* by, const T* bz, T* out, size_t i)
+{
+    P d = P::load(ax + i) * P::load(bx + i);
+    d = fmadd(P::load(ay + i), P::load(by + i), d);
+    d = fmadd(P::load(az + i), P::load(bz + i), d);
+    d.store(out + i);
+}
+
+template <class P, class T>
+inline void crossStep(const T* ax, const T* ay, const T* az,
+                      const T* bx, const T* by, const T* bz,
+                      T* ox, T* oy, T* oz, size_t i)
+{
+    P x0 = P::load(ax + i), y0 = P::load(ay + i), z0 = P::load(az + i);
+    P x1 = P::load(bx + i), y1 = P::load(by + i), z1 = P::load(bz + i);
+    P cx = fmsub(y0, z1, z0*y1);
+    P cy = fmsub(z0, x1, x0*z1);
+    P cz = fmsub(x0, y1, y0*x1);
+    cx.store(ox + i);
+    cy.store(oy + i);
+    cz.store(oz + i);
+}
+
+template <class P, class T>
+inline P squaredMagStep(const T* x, const T* y, const T* z, size_t i)
+{
+    P vx = P::load(x + i), vy = P::load(y + i), vz = P::load(z + i);
+    return fmadd(vz, vz, fmadd(vy, vy, vx*vx));
+}
+
+template <class P, class T>
+inline void normalizeStep(T* x, T* y, T* z, size_t i)
+{
+    P m = sqrt(squaredMagStep<P>(x, y, z, i));
+    (P::load(x + i) / m).store(x + i);
+    (P::load(y + i) / m).store(y + i);
+    (P::load(z + i) / m).store(z + i);
+}
+
+// normalize through a Fast or Approx reciprocal square root (see Precision.h)
+template <class Policy, class P, class T>
+inline void normalizePolicyStep(T* x, T* y, T* z, size_t i)
+{
+    P s = Precision<Policy>::rsqrt(squaredMagStep<P>(x, y, z, i));
+    (P::load(x + i) * s).store(x + i);
+    (P::load(y + i) * s).store(y + i);
+    (P::load(z + i) * s).store(z + i);
+}
+
+template <class P, class T>
+inline P squaredDistStep(const T* ax, const T* ay, const T* az,
+                         const T* bx, const T* by, const T* bz, size_t i)
+{
+    P dx = P::load(ax + i) - P::load(bx + i);
+    P dy = P::load(ay + i) - P::load(by + i);
+    P dz = P::load(az + i) - P::load(bz + i);
+    return fmadd(dz, dz, fmadd(dy, dy, dx*dx));
+}
+
+/*****************************************************/
+/*                  Batch Kernels                    */
+/*****************************************************/
+// out[i] = a[i] . b[i]
+template <class T>
+inline void dotBatch(const T* ax, const T* ay, const T* az,
+                     const T* bx, const T* by, const T* bz, T* out, size_t n)
+{
+    typedef Pack<T> P;
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+        dotStep<P>(ax, ay, az, bx, by, bz, out, i);
+    for(; i < n; ++i)
+        dotStep<ScalarPack<T> >(ax, ay, az, bx, by, bz, out, i);
+}
+
+// o[i] = a[i] x b[i]
+template <class T>
+inline void crossBatch(const T* ax, const T* ay, const T* az,
+                       const T* bx, const T* by, const T* bz,
+                       T* ox, T* oy, T* oz, size_t n)
+{
+    typedef Pack<T> P;
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+        crossStep<P>(ax, ay, az, bx, by, bz, ox, oy, oz, i);
+    for(; i < n; ++i)
+        crossStep<ScalarPack<T> >(ax, ay, az, bx, by, bz, ox, oy, oz, i);
+}
+
+// out[i] = |v[i]|^2
+template <class T>
+inline void squaredMagBatch(const T* x, const T* y, const T* z, T* out, size_t n)
+{
+    typedef Pack<T> P;
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+        squaredMagStep<P>(x, y, z, i).store(out + i);
+    for(; i < n; ++i)
+        squaredMagStep<ScalarPack<T> >(x, y, z, i).store(out + i);
+}
+
+// out[i] = |v[i]|, with the precision policy selecting the square root
+template <class Policy = Exact, class T>
+inline void magBatch(const T* x, const T* y, const T* z, T* out, size_t n)
+{
+    typedef Pack<T> P;
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+        Precision<Policy>::sqrt(squaredMagStep<P>(x, y, z, i)).store(out + i);
+    for(; i < n; ++i)
+        Precision<Policy>::sqrt(squaredMagStep<ScalarPack<T> >(x, y, z, i)).store(out + i);
+}
+
+// v[i] /= |v[i]| in place (zero vectors become NaN, as with Vector3::normalize)
+// Fast and Approx multiply by a refined rsqrt estimate instead of dividing
+template <class Policy = Exact, class T>
+inline void normalizeBatch(T* x, T* y, T* z, size_t n)
+{
+    typedef Pack<T> P;
+    size_t i = 0;
+    if(std::is_same<Policy, Exact>::value)
+    {
+        for(; i + P::width <= n; i += P::width)
+            normalizeStep<P>(x, y, z, i);
+        for(; i < n; ++i)
+            normalizeStep<ScalarPack<T> >(x, y, z, i);
+        return;
+    }
+    for(; i + P::width <= n; i += P::width)
+        normalizePolicyStep<Policy, P>(x, y, z, i);
+    for(; i < n; ++i)
+        normalizePolicyStep<Policy, ScalarPack<T> >(x, y, z, i);
+}
+
+// out[i] = |a[i] - b[i]|^2
+template <class T>
+inline void squaredDistBatch(const T* ax, const T* ay, const T* az,
+                             const T* bx, const T* by, const T* bz, T* out, size_t n)
+{
+    typedef Pack<T> P;
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+        squaredDistStep<P>(ax, ay, az, bx, by, bz, i).store(out + i);
+    for(; i < n; ++i)
+        squaredDistStep<ScalarPack<T> >(ax, ay, az, bx, by, bz, i).store(out + i);
+}
+
+// out[i] = |a[i] - b[i]|
+template <class T>
+inline void distBatch(const T* ax, const T* ay, const T* az,
+                      const T* bx, const T* by, const T* bz, T* out, size_t n)
+{
+    typedef Pack<T> P;
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+        sqrt(squaredDistStep<P>(ax, ay, az, bx, by, bz, i)).store(out + i);
+    for(; i < n; ++i)
+        sqrt(squaredDistStep<ScalarPack<T> >(ax, ay, az, bx, by, bz, i)).store(out + i);
+}
+
+// out[i] = |v[i] - p|^2 for a single point p = (px, py, pz)
+template <class T>
+inline void squaredDistToBatch(const T* x, const T* y, const T* z,
+                               T px, T py, T pz, T* out, size_t n)
+{
+    typedef Pack<T> P;
+    typedef ScalarPack<T> S;
+    P bx(px), by(py), bz(pz);
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+    {
+        P dx = P::load(x + i) - bx, dy = P::load(y + i) - by, dz = P::load(z + i) - bz;
+        fmadd(dz, dz, fmadd(dy, dy, dx*dx)).store(out + i);
+    }
+    for(; i < n; ++i)
+    {
+        S dx = S::load(x + i) - S(px), dy = S::load(y + i) - S(py), dz = S::load(z + i) - S(pz);
+        fmadd(dz, dz, fmadd(dy, dy, dx*dx)).store(out + i);
+    }
+}
+
+// smallest and largest of v[0, n) into lo and hi (left untouched when n is 0);
+// the result is unspecified if v holds NaNs
+template <class T>
+inline void minMaxBatch(const T* v, size_t n, T& lo, T& hi)
+{
+    typedef Pack<T> P;
+    if(n == 0)
+        return;
+    T l = v[0], h = v[0];
+    size_t i = 0;
+    if(n >= P::width)
+    {
+        P pl = P::load(v), ph = pl;
+        for(i = P::width; i + P::width <= n; i += P::width)
+        {
+            P p = P::load(v + i);
+            pl = min(p, pl);
+            ph = max(p, ph);
+        }
+        for(int k = 0; k < P::width; ++k)
+        {
+            l = pl.lane(k) < l ? pl.lane(k) : l;
+            h = h < ph.lane(k) ? ph.lane(k) : h;
+        }
+    }
+    for(; i < n; ++i)
+    {
+        l = v[i] < l ? v[i] : l;
+        h = h < v[i] ? v[i] : h;
+    }
+    lo = l;
+    hi = h;
+}
+
+/*****************************************************/
+/*                Matrix Transforms                  */
+/*****************************************************/
+template <class P, class T>
+inline void transform3x3Step(const P* m, const T* x, const T* y, const T* z,
+                             T* ox, T* oy, T* oz, size_t i)
+{
+    P vx = P::load(x + i), vy = P::load(y + i), vz = P::load(z + i);
+    P rx = fmadd(m[2], vz, fmadd(m[1], vy, m[0]*vx));
+    P ry = fmadd(m[5], vz, fmadd(m[4], vy, m[3]*vx));
+    P rz = fmadd(m[8], vz, fmadd(m[7], vy, m[6]*vx));
+    rx.store(ox + i);
+    ry.store(oy + i);
+    rz.store(oz + i);
+}
+
+// o[i] = m * v[i] for a row-major 3x3 matrix m; the nine matrix terms are
+// broadcast once and reused for the whole buffer (outputs may alias inputs)
+template <class T>
+inline void transform3x3Batch(const T* m, const T* x, const T* y, const T* z,
+                              T* ox, T* oy, T* oz, size_t n)
+{
+    typedef Pack<T> P;
+    typedef ScalarPack<T> S;
+    P pm[9];
+    S sm[9];
+    for(int k = 0; k < 9; ++k)
+    {
+        pm[k] = P(m[k]);
+        sm[k] = S(m[k]);
+    }
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+        transform3x3Step(pm, x, y, z, ox, oy, oz, i);
+    for(; i < n; ++i)
+        transform3x3Step(sm, x, y, z, ox, oy, oz, i);
+}
+
+template <class P, class T>
+inline void transformAffineStep(const P* m, const T* x, const T* y, const T* z,
+                                T* ox, T* oy, T* oz, size_t i)
+{
+    P vx = P::load(x + i), vy = P::load(y + i), vz = P::load(z + i);
+    P rx = fmadd(m[2], vz, fmadd(m[1], vy, fmadd(m[0], vx, m[3])));
+    P ry = fmadd(m[6], vz, fmadd(m[5], vy, fmadd(m[4], vx, m[7])));
+    P rz = fmadd(m[10], vz, fmadd(m[9], vy, fmadd(m[8], vx, m[11])));
+    rx.store(ox + i);
+    ry.store(oy + i);
+    rz.store(oz + i);
+}
+
+// o[i] = m * (v[i], 1) for the top three rows of a row-major 4x4 matrix m
+// (an affine transform: rotation/scale in the 3x3 block plus a translation)
+template <class T>
+inline void transformAffineBatch(const T* m, const T* x, const T* y, const T* z,
+                                 T* ox, T* oy, T* oz, size_t n)
+{
+    typedef Pack<T> P;
+    typedef ScalarPack<T> S;
+    P pm[12];
+    S sm[12];
+    for(int k = 0; k < 12; ++k)
+    {
+        pm[k] = P(m[k]);
+        sm[k] = S(m[k]);
+    }
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+        transformAffineStep(pm, x, y, z, ox, oy, oz, i);
+    for(; i < n; ++i)
+        transformAffineStep(sm, x, y, z, ox, oy, oz, i);
+}
+
+template <class P, class T>
+inline void transformProjectiveStep(const P* m, const T* x, const T* y, const T* z,
+                                    T* ox, T* oy, T* oz, size_t i)
+{
+    P vx = P::load(x + i), vy = P::load(y + i), vz = P::load(z + i);
+    P rx = fmadd(m[2], vz, fmadd(m[1], vy, fmadd(m[0], vx, m[3])));
+    P ry = fmadd(m[6], vz, fmadd(m[5], vy, fmadd(m[4], vx, m[7])));
+    P rz = fmadd(m[10], vz, fmadd(m[9], vy, fmadd(m[8], vx, m[11])));
+    P rw = fmadd(m[14], vz, fmadd(m[13], vy, fmadd(m[12], vx, m[15])));
+    (rx / rw).store(ox + i);
+    (ry / rw).store(oy + i);
+    (rz / rw).store(oz + i);
+}
+
+// o[i] = m * (v[i], 1) followed by the divide by w, for a full row-major 4x4 matrix
+template <class T>
+inline void transformProjectiveBatch(const T* m, const T* x, const T* y, const T* z,
+                                     T* ox, T* oy, T* oz, size_t n)
+{
+    typedef Pack<T> P;
+    typedef ScalarPack<T> S;
+    P pm[16];
+    S sm[16];
+    for(int k = 0; k < 16; ++k)
+    {
+        pm[k] = P(m[k]);
+        sm[k] = S(m[k]);
+    }
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+        transformProjectiveStep(pm, x, y, z, ox, oy, oz, i);
+    for(; i < n; ++i)
+        transformProjectiveStep(sm, x, y, z, ox, oy, oz, i);
+}
+
+// runs a structure-of-arrays kernel over n points whose xyz start every
+// stride scalars (3 for packed xyz, 4 for padded Point3): blocks of points are
+// staged into scratch x/y/z buffers, transformed in place by
+// kernel(x, y, z, count) and written back; only the xyz lanes are written,
+// and in and out may be the same buffer
+template <class T, class Kernel>
+inline void forEachStridedBlock(const T* in, T* out, size_t n, size_t stride, Kernel kernel)
+{
+    const size_t block = 256;
+    T x[block], y[block], z[block];
+    for(size_t i = 0; i < n; i += block)
+    {
+        size_t b = n - i < block ? n - i : block;
+        const T* src = in + stride*i;
+        for(size_t j = 0; j < b; ++j)
+        {
+            x[j] = src[stride*j];
+            y[j] = src[stride*j + 1];
+            z[j] = src[stride*j + 2];
+        }
+        kernel(x, y, z, b);
+        T* dst = out + stride*i;
+        for(size_t j = 0; j < b; ++j)
+        {
+            dst[stride*j] = x[j];
+            dst[stride*j + 1] = y[j];
+            dst[stride*j + 2] = z[j];
+        }
+    }
+}
+
+// forEachStridedBlock over n interleaved xyz points
+template <class T, class Kernel>
+inline void forEachInterleavedBlock(const T* in, T* out, size_t n, Kernel kernel)
+{
+    forEachStridedBlock(in, out, n, 3, kernel);
+}
+
+// interleaved xyz versions of the matrix kernels above
+template <class T>
+inline void transform3x3Interleaved(const T* m, const T* in, T* out, size_t n)
+{
+    forEachInterleavedBlock(in, out, n, [m](T* x, T* y, T* z, size_t b)
+    {
+        transform3x3Batch(m, x, y, z, x, y, z, b);
+    });
+}
+
+template <class T>
+inline void transformAffineInterleaved(const T* m, const T* in, T* out, size_t n)
+{
+    forEachInterleavedBlock(in, out, n, [m](T* x, T* y, T* z, size_t b)
+    {
+        transformAffineBatch(m, x, y, z, x, y, z, b);
+    });
+}
+
+template <class T>
+inline void transformProjectiveInterleaved(const T* m, const T* in, T* out, size_t n)
+{
+    forEachInterleavedBlock(in, out, n, [m](T* x, T* y, T* z, size_t b)
+    {
+        transformProjectiveBatch(m, x, y, z, x, y, z, b);
+    });
+}
+
+/*****************************************************/
+/*              Quaternion Interpolation             */
+/*****************************************************/
+// threshold on |a . b| above which slerp falls back to nlerp: the two
+// rotations then differ by less than 3.6 degrees and nlerp stays within
+// 1e-6 rad of the constant-rate rotation
+const double QUAT_NLERP_THRESHOLD = 0.9995;
+
+// slerp weights for a and b from cos(theta) = d >= 0, without acos, sin or a
+// divide by sin(theta): sin(t theta)/sin(theta) is expanded as a polynomial
+// in t^2 and (d - 1) (D. Eberly, "A Fast and Accurate Algorithm for Computing
+// SLERP", 2011), truncated after 16 terms with the last term scaled by mu to
+// absorb the tail; each weight is within 3.2e-8 of the exact value over
+// 0 <= theta <= pi/2 and exact at d = 1
+template <class P>
+inline void slerpWeights(P d, P t, P& wa, P& wb)
+{
+    typedef typename P::Scalar T;
+    const T mu = T(1.92);
+    // u[k] = 1/(k(2k+1)) and v[k] = k/(2k+1) for k = 1..16, last term times mu
+    const T u[16] = { T(1)/3, T(1)/10, T(1)/21, T(1)/36, T(1)/55, T(1)/78,
+                      T(1)/105, T(1)/136, T(1)/171, T(1)/210, T(1)/253,
+                      T(1)/300, T(1)/351, T(1)/406, T(1)/465, mu/528 };
+    const T v[16] = { T(1)/3, T(2)/5, T(3)/7, T(4)/9, T(5)/11, T(6)/13,
+                      T(7)/15, T(8)/17, T(9)/19, T(10)/21, T(11)/23,
+                      T(12)/25, T(13)/27, T(14)/29, T(15)/31, mu*16/33 };
+    P dm1 = d - P(1);
+    P s = P(1) - t;
+    P tt = t*t, ss = s*s;
+    P ft = P(1), fs = P(1);
+    for(int k = 15; k >= 0; --k)
+    {
+        ft = fmadd(fmsub(P(u[k]), tt, P(v[k])) * dm1, ft, P(1));
+        fs = fmadd(fmsub(P(u[k]), ss, P(v[k])) * dm1, fs, P(1));
+    }
+    wa = s * fs;
+    wb = t * ft;
+}
+
+// one step of the quaternion blend at offset i over SoA blocks: b is flipped
+// onto a's hemisphere (shortest path) and the result renormalized; packs
+// where every lane is within QUAT_NLERP_THRESHOLD use the nlerp weights
+template <class P, class T>
+inline void quatBlendStep(const T* const* a, const T* const* b, const T* t,
+                          T* const* o, size_t i, bool spherical)
+{
+    P ax = P::load(a[0] + i), ay = P::load(a[1] + i), az = P::load(a[2] + i), aw = P::load(a[3] + i);
+    P bx = P::load(b[0] + i), by = P::load(b[1] + i), bz = P::load(b[2] + i), bw = P::load(b[3] + i);
+    P d = fmadd(ax, bx, fmadd(ay, by, fmadd(az, bz, aw*bw)));
+    P sign = select(d < P(0), P(-1), P(1));
+    d = abs(d);
+    P tt = P::load(t + i);
+    P wa = P(1) - tt, wb = tt;
+    if(spherical && bits(d > P(T(QUAT_NLERP_THRESHOLD))) != (1 << P::width) - 1)
+        slerpWeights(d, tt, wa, wb);
+    wb = wb * sign;
+    P rx = fmadd(ax, wa, bx*wb), ry = fmadd(ay, wa, by*wb);
+    P rz = fmadd(az, wa, bz*wb), rw = fmadd(aw, wa, bw*wb);
+    P inv = P(1) / sqrt(fmadd(rx, rx, fmadd(ry, ry, fmadd(rz, rz, rw*rw))));
+    (rx*inv).store(o[0] + i);
+    (ry*inv).store(o[1] + i);
+    (rz*inv).store(o[2] + i);
+    (rw*inv).store(o[3] + i);
+}
+
+// blends n interleaved xyzw quaternion pairs a[i], b[i] at t[i] into out
+// (which may alias a or b); blocks are staged into SoA scratch buffers as in
+// forEachInterleavedBlock
+template <class T>
+inline void quatBlendBatch(const T* a, const T* b, const T* t, T* out, size_t n, bool spherical)
+{
+    typedef Pack<T> P;
+    const size_t block = 256;
+    T sa[4][block], sb[4][block], so[4][block];
+    const T* ca[4] = { sa[0], sa[1], sa[2], sa[3] };
+    const T* cb[4] = { sb[0], sb[1], sb[2], sb[3] };
+    T* co[4] = { so[0], so[1], so[2], so[3] };
+    for(size_t i = 0; i < n; i += block)
+    {
+        size_t len = n - i < block ? n - i : block;
+        const T* pa = a + 4*i;
+        const T* pb = b + 4*i;
+        for(size_t j = 0; j < len; ++j)
+            for(int c = 0; c < 4; ++c)
+            {
+                sa[c][j] = pa[4*j + c];
+                sb[c][j] = pb[4*j + c];
+            }
+        size_t j = 0;
+        for(; j + P::width <= len; j += P::width)
+            quatBlendStep<P>(ca, cb, t + i, co, j, spherical);
+        for(; j < len; ++j)
+            quatBlendStep<ScalarPack<T> >(ca, cb, t + i, co, j, spherical);
+        T* po = out + 4*i;
+        for(size_t j = 0; j < len; ++j)
+            for(int c = 0; c < 4; ++c)
+                po[4*j + c] = so[c][j];
+    }
+}
+
+// out[i] = slerp(a[i], b[i], t[i]) over interleaved xyzw quaternions
+template <class T>
+inline void slerpBatch(const T* a, const T* b, const T* t, T* out, size_t n)
+{
+    quatBlendBatch(a, b, t, out, n, true);
+}
+
+// out[i] = nlerp(a[i], b[i], t[i]) over interleaved xyzw quaternions
+template <class T>
+inline void nlerpBatch(const T* a, const T* b, const T* t, T* out, size_t n)
+{
+    quatBlendBatch(a, b, t, out, n, false);
+}
+
+#endif	/* VECTORKERNELS_H */
+
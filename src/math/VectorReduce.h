@@ -0,0 +1,567 @@
+#ifndef VECTORREDUCE_H
+#define	VECTORREDUCE_H
+
+#include "Mat3.h"
+#include "Simd.h"
+#include "Vector3.h"
+#include "Vector3Array.h"
+#include "Vector3View.h"
+#include "../util/Parallel.h"
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+// whole-buffer reductions over point sets: axis-aligned bounding box,
+// centroid, covariance and an enclosing sphere
+//
+// each chunk of parallelGrain<T>() points is reduced on one thread with
+// Pack<T>::width lane accumulators, the lanes are folded in lane order, and
+// the chunk results are combined in chunk order by parallelReduce. the
+// grouping depends only on n and the pack width, so the results are
+// bit-identical for any thread count (and differ between instruction sets
+// only through the rounding of the sums)
+//
+// every reduction takes SoA streams, a Vector3Array or Vector3View, or an
+// array of Vector3s; the latter is staged into SoA blocks chunk by chunk
+// rather than converted up front
+
+template <class T = float>
+struct BoundingBox
+{
+    T lo[3], hi[3];
+
+    // an empty box (lo > hi), the identity for extend
+    BoundingBox()
+    {
+        for(int k = 0; k < 3; ++k)
+        {
+            lo[k] = std::numeric_limits<T>::max();
+            hi[k] = -std::numeric_limits<T>::max();
+        }
+    }
+
+    inline bool empty() const
+    {
+        return hi[0] < lo[0];
+    }
+
+    inline void extend(const BoundingBox& b)
+    {
+        for(int k = 0; k < 3; ++k)
+        {
+            lo[k] = b.lo[k] < lo[k] ? b.lo[k] : lo[k];
+            hi[k] = hi[k] < b.hi[k] ? b.hi[k] : hi[k];
+        }
+    }
+
+    template <class U = int>
+    inline Vector3<T, U> getMin() const
+    {
+        return Vector3<T, U>(lo[0], lo[1], lo[2]);
+    }
+
+    template <class U = int>
+    inline Vector3<T, U> getMax() const
+    {
+        return Vector3<T, U>(hi[0], hi[1], hi[2]);
+    }
+
+    template <class U = int>
+    inline Vector3<T, U> getCenter() const
+    {
+        return Vector3<T, U>((lo[0] + hi[0])/2, (lo[1] + hi[1])/2, (lo[2] + hi[2])/2);
+    }
+};
+
+template <class T = float>
+struct BoundingSphere
+{
+    T center[3];
+    T radius;
+
+    template <class U = int>
+    inline Vector3<T, U> getCenter() const
+    {
+        return Vector3<T, U>(center[0], center[1], center[2]);
+    }
+};
+
+/*****************************************************/
+/*                  Chunk Kernels                    */
+/*****************************************************/
+// grows box over v[0, n)
+template <class T>
+inline void boundsBatch(const T* x, const T* y, const T* z, size_t n, BoundingBox<T>& box)
+{
+    typedef Pack<T> P;
+    size_t i = 0;
+    if(n >= P::width)
+    {
+        P lx = P::load(x), ly = P::load(y), lz = P::load(z);
+        P hx = lx, hy = ly, hz = lz;
+        for(i = P::width; i + P::width <= n; i += P::width)
+        {
+            P px = P::load(x + i), py = P::load(y + i), pz = P::load(z + i);
+            lx = min(px, lx); ly = min(py, ly); lz = min(pz, lz);
+            hx = max(px, hx); hy = max(py, hy); hz = max(pz, hz);
+        }
+        BoundingBox<T> b;
+        for(int k = 0; k < P::width; ++k)
+        {
+            b.lo[0] = lx.lane(k) < b.lo[0] ? lx.lane(k) : b.lo[0];
+            b.lo[1] = ly.lane(k) < b.lo[1] ? ly.lane(k) : b.lo[1];
+            b.lo[2] = lz.lane(k) < b.lo[2] ? lz.lane(k) : b.lo[2];
+            b.hi[0] = b.hi[0] < hx.lane(k) ? hx.lane(k) : b.hi[0];
+            b.hi[1] = b.hi[1] < hy.lane(k) ? hy.lane(k) : b.hi[1];
+            b.hi[2] = b.hi[2] < hz.lane(k) ? hz.lane(k) : b.hi[2];
+        }
+        box.extend(b);
+    }
+    for(; i < n; ++i)
+    {
+        const T p[3] = { x[i], y[i], z[i] };
+        for(int k = 0; k < 3; ++k)
+        {
+            box.lo[k] = p[k] < box.lo[k] ? p[k] : box.lo[k];
+            box.hi[k] = box.hi[k] < p[k] ? p[k] : box.hi[k];
+        }
+    }
+}
+
+// sum[k] += sum of coordinate k of (v[i] - c) over [0, n)
+template <class T>
+inline void sumBatch(const T* x, const T* y, const T* z, size_t n, const T c[3], T sum[3])
+{
+    typedef Pack<T> P;
+    P cx(c[0]), cy(c[1]), cz(c[2]);
+    P sx(0), sy(0), sz(0);
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+    {
+        sx = sx + (P::load(x + i) - cx);
+        sy = sy + (P::load(y + i) - cy);
+        sz = sz + (P::load(z + i) - cz);
+    }
+    T s[3] = { T(0), T(0), T(0) };
+    for(int k = 0; k < P::width; ++k)
+    {
+        s[0] += sx.lane(k);
+        s[1] += sy.lane(k);
+        s[2] += sz.lane(k);
+    }
+    for(; i < n; ++i)
+    {
+        s[0] += x[i] - c[0];
+        s[1] += y[i] - c[1];
+        s[2] += z[i] - c[2];
+    }
+    for(int k = 0; k < 3; ++k)
+        sum[k] += s[k];
+}
+
+// m[0..5] += xx, xy, xz, yy, yz, zz of (v[i] - c) over [0, n)
+template <class T>
+inline void covarianceBatch(const T* x, const T* y, const T* z, size_t n, const T c[3], T m[6])
+{
+    typedef Pack<T> P;
+    typedef ScalarPack<T> S;
+    P cx(c[0]), cy(c[1]), cz(c[2]);
+    P a[6] = { P(0), P(0), P(0), P(0), P(0), P(0) };
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+    {
+        P dx = P::load(x + i) - cx, dy = P::load(y + i) - cy, dz = P::load(z + i) - cz;
+        a[0] = fmadd(dx, dx, a[0]);
+        a[1] = fmadd(dx, dy, a[1]);
+        a[2] = fmadd(dx, dz, a[2]);
+        a[3] = fmadd(dy, dy, a[3]);
+        a[4] = fmadd(dy, dz, a[4]);
+        a[5] = fmadd(dz, dz, a[5]);
+    }
+    T s[6] = { T(0), T(0), T(0), T(0), T(0), T(0) };
+    for(int k = 0; k < P::width; ++k)
+        for(int j = 0; j < 6; ++j)
+            s[j] += a[j].lane(k);
+    for(; i < n; ++i)
+    {
+        S dx = S(x[i] - c[0]), dy = S(y[i] - c[1]), dz = S(z[i] - c[2]);
+        s[0] = fmadd(dx, dx, S(s[0])).v;
+        s[1] = fmadd(dx, dy, S(s[1])).v;
+        s[2] = fmadd(dx, dz, S(s[2])).v;
+        s[3] = fmadd(dy, dy, S(s[3])).v;
+        s[4] = fmadd(dy, dz, S(s[4])).v;
+        s[5] = fmadd(dz, dz, S(s[5])).v;
+    }
+    for(int j = 0; j < 6; ++j)
+        m[j] += s[j];
+}
+
+// largest |v[i] - p|^2 over [0, n) for each of two points p = c0, c1, folded
+// into d2[0] and d2[1]
+template <class T>
+inline void maxSquaredDistBatch(const T* x, const T* y, const T* z, size_t n,
+                                const T c0[3], const T c1[3], T d2[2])
+{
+    typedef Pack<T> P;
+    P ax(c0[0]), ay(c0[1]), az(c0[2]);
+    P bx(c1[0]), by(c1[1]), bz(c1[2]);
+    P ma(0), mb(0);
+    size_t i = 0;
+    for(; i + P::width <= n; i += P::width)
+    {
+        P px = P::load(x + i), py = P::load(y + i), pz = P::load(z + i);
+        P dx = px - ax, dy = py - ay, dz = pz - az;
+        ma = max(fmadd(dz, dz, fmadd(dy, dy, dx*dx)), ma);
+        dx = px - bx; dy = py - by; dz = pz - bz;
+        mb = max(fmadd(dz, dz, fmadd(dy, dy, dx*dx)), mb);
+    }
+    for(int k = 0; k < P::width; ++k)
+    {
+        d2[0] = d2[0] < ma.lane(k) ? ma.lane(k) : d2[0];
+        d2[1] = d2[1] < mb.lane(k) ? mb.lane(k) : d2[1];
+    }
+    for(; i < n; ++i)
+    {
+        T dx = x[i] - c0[0], dy = y[i] - c0[1], dz = z[i] - c0[2];
+        T d = dx*dx + dy*dy + dz*dz;
+        d2[0] = d2[0] < d ? d : d2[0];
+        dx = x[i] - c1[0]; dy = y[i] - c1[1]; dz = z[i] - c1[2];
+        d = dx*dx + dy*dy + dz*dz;
+        d2[1] = d2[1] < d ? d : d2[1];
+    }
+}
+
+// fixed-size partial result of the sum and max reductions
+template <class T, int N>
+struct ReduceTuple
+{
+    T v[N];
+
+    explicit ReduceTuple(T s = T(0))
+    {
+        for(int k = 0; k < N; ++k)
+            v[k] = s;
+    }
+};
+
+/*****************************************************/
+/*                   Point Sources                   */
+/*****************************************************/
+// calls kernel(x, y, z, count) over points [begin, end) of a source: SoA
+// streams are passed straight through, Vector3s are staged 256 at a time
+template <class T>
+struct StreamSource
+{
+    const T* x;
+    const T* y;
+    const T* z;
+
+    template <class Kernel>
+    inline void operator()(size_t begin, size_t end, Kernel& kernel) const
+    {
+        kernel(x + begin, y + begin, z + begin, end - begin);
+    }
+};
+
+template <class T, class U>
+struct Vector3Source
+{
+    const Vector3<T, U>* v;
+
+    template <class Kernel>
+    inline void operator()(size_t begin, size_t end, Kernel& kernel) const
+    {
+        const size_t block = 256;
+        T x[block], y[block], z[block];
+        for(size_t i = begin; i < end; i += block)
+        {
+            size_t b = end - i < block ? end - i : block;
+            for(size_t j = 0; j < b; ++j)
+            {
+                x[j] = v[i + j].getX();
+                y[j] = v[i + j].getY();
+                z[j] = v[i + j].getZ();
+            }
+            kernel(x, y, z, b);
+        }
+    }
+};
+
+/*****************************************************/
+/*                    Reductions                     */
+/*****************************************************/
+template <class T, class Source>
+inline BoundingBox<T> reduceBounds(const Source& source, size_t n, TaskScheduler& scheduler)
+{
+    return parallelReduce(n, parallelGrain<T>(), BoundingBox<T>(), [&source](size_t begin, size_t end)
+    {
+        BoundingBox<T> box;
+        auto kernel = [&box](const T* x, const T* y, const T* z, size_t m)
+        {
+            boundsBatch(x, y, z, m, box);
+        };
+        source(begin, end, kernel);
+        return box;
+    }, [](BoundingBox<T> a, const BoundingBox<T>& b)
+    {
+        a.extend(b);
+        return a;
+    }, scheduler);
+}
+
+// mean of the points; each chunk is summed relative to an origin near the
+// data (point 0) to keep the float sums small. with box set, the bounds are
+// gathered in the same pass
+template <class T, class Source>
+inline Vector3<T> reduceCentroid(const Source& source, size_t n, TaskScheduler& scheduler,
+                                 BoundingBox<T>* box = 0)
+{
+    // three sums, then the box lo and hi
+    typedef ReduceTuple<T, 9> Sum;
+    if(n == 0)
+        return Vector3<T>(T(0), T(0), T(0));
+    T origin[3] = { T(0), T(0), T(0) };
+    auto first = [&origin](const T* x, const T* y, const T* z, size_t)
+    {
+        origin[0] = x[0];
+        origin[1] = y[0];
+        origin[2] = z[0];
+    };
+    source(0, 1, first);
+    bool bounds = box != 0;
+    Sum identity;
+    for(int k = 0; k < 3; ++k)
+    {
+        identity.v[3 + k] = std::numeric_limits<T>::max();
+        identity.v[6 + k] = -std::numeric_limits<T>::max();
+    }
+    Sum s = parallelReduce(n, parallelGrain<T>(), identity, [&source, &origin, bounds](size_t begin, size_t end)
+    {
+        Sum sum;
+        BoundingBox<T> b;
+        auto kernel = [&sum, &b, &origin, bounds](const T* x, const T* y, const T* z, size_t m)
+        {
+            sumBatch(x, y, z, m, origin, sum.v);
+            if(bounds)
+                boundsBatch(x, y, z, m, b);
+        };
+        source(begin, end, kernel);
+        for(int k = 0; k < 3; ++k)
+        {
+            sum.v[3 + k] = b.lo[k];
+            sum.v[6 + k] = b.hi[k];
+        }
+        return sum;
+    }, [](Sum a, const Sum& b)
+    {
+        for(int k = 0; k < 3; ++k)
+        {
+            a.v[k] += b.v[k];
+            a.v[3 + k] = b.v[3 + k] < a.v[3 + k] ? b.v[3 + k] : a.v[3 + k];
+            a.v[6 + k] = a.v[6 + k] < b.v[6 + k] ? b.v[6 + k] : a.v[6 + k];
+        }
+        return a;
+    }, scheduler);
+    if(box)
+        for(int k = 0; k < 3; ++k)
+        {
+            box->lo[k] = s.v[3 + k];
+            box->hi[k] = s.v[6 + k];
+        }
+    return Vector3<T>(origin[0] + s.v[0]/T(n), origin[1] + s.v[1]/T(n), origin[2] + s.v[2]/T(n));
+}
+
+// population covariance (divided by n) about center
+template <class T, class Source>
+inline Mat3<T> reduceCovariance(const Source& source, size_t n, const Vector3<T>& center,
+                                TaskScheduler& scheduler)
+{
+    typedef ReduceTuple<T, 6> Sum;
+    if(n == 0)
+        return Mat3<T>(T(0), T(0), T(0), T(0), T(0), T(0), T(0), T(0), T(0));
+    const T c[3] = { center.getX(), center.getY(), center.getZ() };
+    Sum s = parallelReduce(n, parallelGrain<T>(), Sum(), [&source, &c](size_t begin, size_t end)
+    {
+        Sum sum;
+        auto kernel = [&sum, &c](const T* x, const T* y, const T* z, size_t m)
+        {
+            covarianceBatch(x, y, z, m, c, sum.v);
+        };
+        source(begin, end, kernel);
+        return sum;
+    }, [](Sum a, const Sum& b)
+    {
+        for(int k = 0; k < 6; ++k)
+            a.v[k] += b.v[k];
+        return a;
+    }, scheduler);
+    T inv = T(1) / T(n);
+    const T* m = s.v;
+    return Mat3<T>(m[0]*inv, m[1]*inv, m[2]*inv,
+                   m[1]*inv, m[3]*inv, m[4]*inv,
+                   m[2]*inv, m[4]*inv, m[5]*inv);
+}
+
+// a sphere around the box center or the centroid, whichever is smaller, with
+// the radius reaching the farthest point; it always encloses every point but
+// is not the minimal sphere (at most sqrt(3) times its radius, usually within
+// a few percent for scanned or modeled surfaces)
+template <class T, class Source>
+inline BoundingSphere<T> reduceBoundingSphere(const Source& source, size_t n, TaskScheduler& scheduler)
+{
+    typedef ReduceTuple<T, 2> Max;
+    BoundingSphere<T> sphere;
+    sphere.center[0] = sphere.center[1] = sphere.center[2] = sphere.radius = T(0);
+    if(n == 0)
+        return sphere;
+    BoundingBox<T> box;
+    Vector3<T> mean = reduceCentroid<T>(source, n, scheduler, &box);
+    const T c0[3] = { (box.lo[0] + box.hi[0])/2, (box.lo[1] + box.hi[1])/2, (box.lo[2] + box.hi[2])/2 };
+    const T c1[3] = { mean.getX(), mean.getY(), mean.getZ() };
+    Max d2 = parallelReduce(n, parallelGrain<T>(), Max(), [&source, &c0, &c1](size_t begin, size_t end)
+    {
+        Max d;
+        auto kernel = [&d, &c0, &c1](const T* x, const T* y, const T* z, size_t m)
+        {
+            maxSquaredDistBatch(x, y, z, m, c0, c1, d.v);
+        };
+        source(begin, end, kernel);
+        return d;
+    }, [](Max a, const Max& b)
+    {
+        a.v[0] = a.v[0] < b.v[0] ? b.v[0] : a.v[0];
+        a.v[1] = a.v[1] < b.v[1] ? b.v[1] : a.v[1];
+        return a;
+    }, scheduler);
+    int k = d2.v[1] < d2.v[0] ? 1 : 0;
+    const T* c = k == 0 ? c0 : c1;
+    sphere.center[0] = c[0];
+    sphere.center[1] = c[1];
+    sphere.center[2] = c[2];
+    // widened by a few ulps so rounding in the distances cannot leave the
+    // farthest point outside
+    sphere.radius = std::sqrt(d2.v[k])*(T(1) + 4*std::numeric_limits<T>::epsilon());
+    return sphere;
+}
+
+/*****************************************************/
+/*                  Public Overloads                 */
+/*****************************************************/
+template <class T>
+inline BoundingBox<T> computeBounds(const T* x, const T* y, const T* z, size_t n,
+                                    TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    StreamSource<T> s = { x, y, z };
+    return reduceBounds<T>(s, n, scheduler);
+}
+
+template <class T, class U>
+inline BoundingBox<T> computeBounds(const Vector3View<T, U>& v, TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    return computeBounds(v.getXStream(), v.getYStream(), v.getZStream(), v.size(), scheduler);
+}
+
+template <class T, class U>
+inline BoundingBox<T> computeBounds(const Vector3Array<T, U>& v, TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    return computeBounds(v.getXStream(), v.getYStream(), v.getZStream(), v.size(), scheduler);
+}
+
+template <class T, class U>
+inline BoundingBox<T> computeBounds(const Vector3<T, U>* v, size_t n,
+                                    TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    Vector3Source<T, U> s = { v };
+    return reduceBounds<T>(s, n, scheduler);
+}
+
+template <class T>
+inline Vector3<T> computeCentroid(const T* x, const T* y, const T* z, size_t n,
+                                  TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    StreamSource<T> s = { x, y, z };
+    return reduceCentroid<T>(s, n, scheduler);
+}
+
+template <class T, class U>
+inline Vector3<T> computeCentroid(const Vector3View<T, U>& v, TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    return computeCentroid(v.getXStream(), v.getYStream(), v.getZStream(), v.size(), scheduler);
+}
+
+template <class T, class U>
+inline Vector3<T> computeCentroid(const Vector3Array<T, U>& v, TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    return computeCentroid(v.getXStream(), v.getYStream(), v.getZStream(), v.size(), scheduler);
+}
+
+template <class T, class U>
+inline Vector3<T> computeCentroid(const Vector3<T, U>* v, size_t n,
+                                  TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    Vector3Source<T, U> s = { v };
+    return reduceCentroid<T>(s, n, scheduler);
+}
+
+// covariance about the centroid, the input to a PCA of the points; a second
+// pass over the data after computeCentroid, which keeps it accurate for
+// points far from the origin
+template <class T>
+inline Mat3<T> computeCovariance(const T* x, const T* y, const T* z, size_t n,
+                                 TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    StreamSource<T> s = { x, y, z };
+    return reduceCovariance<T>(s, n, reduceCentroid<T>(s, n, scheduler), scheduler);
+}
+
+template <class T, class U>
+inline Mat3<T> computeCovariance(const Vector3View<T, U>& v, TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    return computeCovariance(v.getXStream(), v.getYStream(), v.getZStream(), v.size(), scheduler);
+}
+
+template <class T, class U>
+inline Mat3<T> computeCovariance(const Vector3Array<T, U>& v, TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    return computeCovariance(v.getXStream(), v.getYStream(), v.getZStream(), v.size(), scheduler);
+}
+
+template <class T, class U>
+inline Mat3<T> computeCovariance(const Vector3<T, U>* v, size_t n,
+                                 TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    Vector3Source<T, U> s = { v };
+    return reduceCovariance<T>(s, n, reduceCentroid<T>(s, n, scheduler), scheduler);
+}
+
+template <class T>
+inline BoundingSphere<T> computeBoundingSphere(const T* x, const T* y, const T* z, size_t n,
+                                               TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    StreamSource<T> s = { x, y, z };
+    return reduceBoundingSphere<T>(s, n, scheduler);
+}
+
+template <class T, class U>
+inline BoundingSphere<T> computeBoundingSphere(const Vector3View<T, U>& v,
+                                               TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    return computeBoundingSphere(v.getXStream(), v.getYStream(), v.getZStream(), v.size(), scheduler);
+}
+
+template <class T, class U>
+inline BoundingSphere<T> computeBoundingSphere(const Vector3Array<T, U>& v,
+                                               TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    return computeBoundingSphere(v.getXStream(), v.getYStream(), v.getZStream(), v.size(), scheduler);
+}
+
+template <class T, class U>
+inline BoundingSphere<T> computeBoundingSphere(const Vector3<T, U>* v, size_t n,
+                                               TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    Vector3Source<T, U> s = { v };
+    return reduceBoundingSphere<T>(s, n, scheduler);
+}
+
+#endif	/* VECTORREDUCE_H */
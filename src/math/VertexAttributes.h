@@ -0,0 +1,223 @@
+#ifndef VERTEXATTRIBUTES_H
+#define	VERTEXATTRIBUTES_H
+
+#include "Point3.h"
+#include "Vector3.h"
+#include "VectorKernels.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// per-vertex color and normal kept apart from the positions (see Point3.h)
+// colors are packed RGBA8, one uint32_t per vertex with red in the lowest
+// byte (the byte order of an RGBA8 texture or a point-cloud color section);
+// normals are three SoA streams so the VectorKernels.h batches run on them
+// directly. either stream can be left out, and a pass over positions never
+// touches them
+//
+// per vertex this is 4 bytes of color plus 12 or 24 of normal, against the
+// 16 bytes of color and 48 of normal inside the double Vector3
+
+// packs four 0..255 channels, red in the lowest byte
+inline constexpr uint32_t packRGBA8(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) noexcept
+{
+    return uint32_t(r) | (uint32_t(g) << 8) | (uint32_t(b) << 16) | (uint32_t(a) << 24);
+}
+
+// one 0..1 channel as 0..255, clamped and rounded to nearest
+inline uint8_t rgba8Channel(float c) noexcept
+{
+    c = c < 0.0f ? 0.0f : (c > 1.0f ? 1.0f : c);
+    return uint8_t(c*255.0f + 0.5f);
+}
+
+// packs four 0..1 channels
+inline uint32_t packRGBA8f(float r, float g, float b, float a = 1.0f) noexcept
+{
+    return packRGBA8(rgba8Channel(r), rgba8Channel(g), rgba8Channel(b), rgba8Channel(a));
+}
+
+// channel 0..3 (r, g, b, a) of a packed color
+inline constexpr uint8_t unpackRGBA8(uint32_t rgba, int channel) noexcept
+{
+    return uint8_t(rgba >> (8*channel));
+}
+
+template <class T = float>
+class VertexAttributes
+{
+private:
+    std::vector<uint32_t> colors;
+    std::vector<T> nxs, nys, nzs;
+    size_t n;
+    bool color;
+    bool normals;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    VertexAttributes():
+    n(0), color(false), normals(false)
+    {
+    }
+
+    // n vertices, colors opaque white and normals zero
+    explicit VertexAttributes(size_t n, bool withColor = true, bool withNormals = true):
+    n(0), color(false), normals(false)
+    {
+        resize(n, withColor, withNormals);
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // resizes the enabled streams, filling new colors with opaque white and new
+    // normals with zero; disabling a stream releases it
+    inline void resize(size_t count, bool withColor, bool withNormals)
+    {
+        n = count;
+        color = withColor;
+        normals = withNormals;
+        if(color)
+            colors.resize(n, packRGBA8(255, 255, 255));
+        else
+            std::vector<uint32_t>().swap(colors);
+        if(normals)
+        {
+            nxs.resize(n, T(0));
+            nys.resize(n, T(0));
+            nzs.resize(n, T(0));
+        }
+        else
+        {
+            std::vector<T>().swap(nxs);
+            std::vector<T>().swap(nys);
+            std::vector<T>().swap(nzs);
+        }
+    }
+
+    // rescales every normal to unit length; P as in normalizeBatch
+    template <class P = Exact>
+    inline void normalizeNormals()
+    {
+        if(normals)
+            normalizeBatch<P>(nxs.data(), nys.data(), nzs.data(), n);
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline size_t size() const
+    {
+        return n;
+    }
+
+    inline bool hasColor() const
+    {
+        return color;
+    }
+
+    inline bool hasNormals() const
+    {
+        return normals;
+    }
+
+    // packed color of vertex i (requires hasColor())
+    inline uint32_t getColor(size_t i) const
+    {
+        return colors[i];
+    }
+
+    inline void setColor(size_t i, uint32_t rgba)
+    {
+        colors[i] = rgba;
+    }
+
+    inline void setColor(size_t i, uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255)
+    {
+        colors[i] = packRGBA8(r, g, b, a);
+    }
+
+    // normal of vertex i (requires hasNormals())
+    inline Vector3<T> getNormal(size_t i) const
+    {
+        return Vector3<T>(nxs[i], nys[i], nzs[i]);
+    }
+
+    inline void setNormal(size_t i, T x, T y, T z)
+    {
+        nxs[i] = x;
+        nys[i] = y;
+        nzs[i] = z;
+    }
+
+    template <class U>
+    inline void setNormal(size_t i, const Vector3<T, U>& v)
+    {
+        setNormal(i, v.getX(), v.getY(), v.getZ());
+    }
+
+    // raw streams, for the batch kernels and for writers
+    inline uint32_t* getColorStream()
+    {
+        return colors.data();
+    }
+
+    inline const uint32_t* getColorStream() const
+    {
+        return colors.data();
+    }
+
+    inline T* getNXStream()
+    {
+        return nxs.data();
+    }
+
+    inline const T* getNXStream() const
+    {
+        return nxs.data();
+    }
+
+    inline T* getNYStream()
+    {
+        return nys.data();
+    }
+
+    inline const T* getNYStream() const
+    {
+        return nys.data();
+    }
+
+    inline T* getNZStream()
+    {
+        return nzs.data();
+    }
+
+    inline const T* getNZStream() const
+    {
+        return nzs.data();
+    }
+};
+
+// splits n Vector3s into lean positions plus a color stream, clamping each
+// channel to 0..255; normals are left disabled since Vector3 carries none
+template <class T, class U, bool Padded>
+inline void splitVertices(const Vector3<T, U>* v, size_t n, Point3<T, Padded>* positions,
+                          VertexAttributes<T>& attributes)
+{
+    attributes.resize(n, true, false);
+    for(size_t i = 0; i < n; ++i)
+    {
+        positions[i] = Point3<T, Padded>(v[i]);
+        uint8_t c[4];
+        for(int k = 0; k < 4; ++k)
+        {
+            U u = k == 0 ? v[i].getR() : (k == 1 ? v[i].getG() : (k == 2 ? v[i].getB() : v[i].getA()));
+            c[k] = uint8_t(u < U(0) ? U(0) : (u > U(255) ? U(255) : u));
+        }
+        attributes.setColor(i, c[0], c[1], c[2], c[3]);
+    }
+}
+
+#endif	/* VERTEXATTRIBUTES_H */
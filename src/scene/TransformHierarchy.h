@@ -0,0 +1,424 @@
+#ifndef TRANSFORMHIERARCHY_H
+#define	TRANSFORMHIERARCHY_H
+
+#include "../math/Quat.h"
+#include "../math/Simd.h"
+#include "../math/Vector3.h"
+#include "../util/Parallel.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// flat transform hierarchy: a scene graph without node pointers
+//
+// each node has a local rotation, translation and uniform scale, and its world
+// transform is its parent's world transform applied to the local one:
+//   world rotation    = parent rotation * local rotation
+//   world scale       = parent scale * local scale
+//   world translation = parent translation + parent scale * parent rotation(local translation)
+// (non-uniform scale does not survive rotation in this form, so it is left to
+// the leaves' own geometry)
+//
+// local transforms are stored in SoA streams by node handle. world transforms
+// live in a separate SoA layout sorted by depth, then parent, so each level is
+// one contiguous run and the children of a node are a contiguous run of the
+// next level. update() walks the levels in order, gathering parent and local
+// transforms for a batch of nodes into scratch streams, composing them
+// Pack<T>::width nodes at a time and scattering the results. large levels are
+// split across the TaskScheduler
+//
+// setters mark a node dirty; update() recomposes only the dirty nodes and
+// their descendants, reached through the child runs, so a frame where a few
+// nodes moved costs time proportional to their subtrees, not to the scene.
+// adding nodes re-sorts the layout and recomposes everything once
+typedef uint32_t TransformNode;
+const TransformNode TRANSFORM_NONE = 0xffffffffu;
+
+template <class T = float>
+class TransformHierarchy
+{
+private:
+    enum { BLOCK = 256, PARALLEL_MIN = 4096 };
+
+    // by handle
+    std::vector<TransformNode> parents;
+    std::vector<T> lqx, lqy, lqz, lqw;  // local rotation
+    std::vector<T> ltx, lty, ltz;       // local translation
+    std::vector<T> ls;                  // local scale
+    std::vector<uint32_t> slotOf;
+
+    // by slot (depth-sorted)
+    std::vector<uint32_t> nodeOf;
+    std::vector<uint32_t> parentSlot;
+    std::vector<uint32_t> childBegin, childEnd;
+    std::vector<uint32_t> levelStart;
+    std::vector<T> wqx, wqy, wqz, wqw;  // world rotation
+    std::vector<T> wtx, wty, wtz;       // world translation
+    std::vector<T> ws;                  // world scale
+
+    // dirty tracking
+    std::vector<uint32_t> dirty;        // handles changed since the last update
+    std::vector<uint32_t> stamp;        // by slot, the update that last visited it
+    uint32_t epoch;
+    bool layoutDirty;
+    std::vector<uint32_t> current, next;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    TransformHierarchy():
+    epoch(0), layoutDirty(false)
+    {
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // adds a node with an identity local transform under parent (an existing
+    // node, or TRANSFORM_NONE for a root) and returns its handle
+    inline TransformNode add(TransformNode parent = TRANSFORM_NONE)
+    {
+        TransformNode node = TransformNode(parents.size());
+        parents.push_back(parent);
+        lqx.push_back(T(0));
+        lqy.push_back(T(0));
+        lqz.push_back(T(0));
+        lqw.push_back(T(1));
+        ltx.push_back(T(0));
+        lty.push_back(T(0));
+        ltz.push_back(T(0));
+        ls.push_back(T(1));
+        layoutDirty = true;
+        return node;
+    }
+
+    inline void clear()
+    {
+        *this = TransformHierarchy();
+    }
+
+    // recomposes the world transforms of every node changed since the last
+    // update and of their descendants
+    inline void update(TaskScheduler& scheduler = TaskScheduler::instance())
+    {
+        bool all = layoutDirty;
+        if(layoutDirty)
+            rebuildLayout();
+        else if(dirty.empty())
+            return;
+        // past a quarter of the scene, sorting the dirty list costs more than
+        // recomposing everything
+        if(all || dirty.size() >= nodeOf.size()/4)
+        {
+            current.resize(nodeOf.size());
+            for(size_t s = 0; s < current.size(); ++s)
+                current[s] = uint32_t(s);
+            for(size_t l = 0; l + 1 < levelStart.size(); ++l)
+                compose(current.data() + levelStart[l], levelStart[l + 1] - levelStart[l], scheduler);
+            dirty.clear();
+            return;
+        }
+
+        // dirty nodes in slot order, so they come up level by level
+        for(size_t i = 0; i < dirty.size(); ++i)
+            dirty[i] = slotOf[dirty[i]];
+        std::sort(dirty.begin(), dirty.end());
+        if(++epoch == 0)
+        {
+            std::fill(stamp.begin(), stamp.end(), 0);
+            epoch = 1;
+        }
+
+        size_t d = 0;
+        current.clear();
+        for(size_t l = 0; l + 1 < levelStart.size(); ++l)
+        {
+            // current holds the children of the nodes updated on the level above;
+            // add the dirty nodes of this level they do not already cover
+            for(; d < dirty.size() && dirty[d] < levelStart[l + 1]; ++d)
+                if(stamp[dirty[d]] != epoch)
+                {
+                    stamp[dirty[d]] = epoch;
+                    current.push_back(dirty[d]);
+                }
+            if(current.empty() && d == dirty.size())
+                break;
+            compose(current.data(), current.size(), scheduler);
+
+            next.clear();
+            for(size_t i = 0; i < current.size(); ++i)
+                for(uint32_t c = childBegin[current[i]]; c < childEnd[current[i]]; ++c)
+                {
+                    stamp[c] = epoch;
+                    next.push_back(c);
+                }
+            current.swap(next);
+        }
+        dirty.clear();
+    }
+
+    /*****************************************************/
+    /*                 Getters & Setters                 */
+    /*****************************************************/
+    inline size_t size() const
+    {
+        return parents.size();
+    }
+
+    inline TransformNode getParent(TransformNode node) const
+    {
+        return parents[node];
+    }
+
+    // depth levels of the last update (roots are level 0)
+    inline size_t getLevelCount() const
+    {
+        return levelStart.empty() ? 0 : levelStart.size() - 1;
+    }
+
+    inline void setLocal(TransformNode node, const Quat<T>& rotation, T tx, T ty, T tz, T scale = T(1))
+    {
+        setRotation(node, rotation);
+        setTranslation(node, tx, ty, tz);
+        setScale(node, scale);
+    }
+
+    // rotation must be a unit quaternion
+    inline void setRotation(TransformNode node, const Quat<T>& rotation)
+    {
+        lqx[node] = rotation.getX();
+        lqy[node] = rotation.getY();
+        lqz[node] = rotation.getZ();
+        lqw[node] = rotation.getW();
+        touch(node);
+    }
+
+    inline void setTranslation(TransformNode node, T x, T y, T z)
+    {
+        ltx[node] = x;
+        lty[node] = y;
+        ltz[node] = z;
+        touch(node);
+    }
+
+    template <class U>
+    inline void setTranslation(TransformNode node, const Vector3<T, U>& t)
+    {
+        setTranslation(node, t.getX(), t.getY(), t.getZ());
+    }
+
+    inline void setScale(TransformNode node, T scale)
+    {
+        ls[node] = scale;
+        touch(node);
+    }
+
+    inline Quat<T> getLocalRotation(TransformNode node) const
+    {
+        return Quat<T>(lqx[node], lqy[node], lqz[node], lqw[node]);
+    }
+
+    inline Vector3<T> getLocalTranslation(TransformNode node) const
+    {
+        return Vector3<T>(ltx[node], lty[node], ltz[node]);
+    }
+
+    inline T getLocalScale(TransformNode node) const
+    {
+        return ls[node];
+    }
+
+    // world transforms as of the last update()
+    inline Quat<T> getWorldRotation(TransformNode node) const
+    {
+        uint32_t s = slotOf[node];
+        return Quat<T>(wqx[s], wqy[s], wqz[s], wqw[s]);
+    }
+
+    inline Vector3<T> getWorldTranslation(TransformNode node) const
+    {
+        uint32_t s = slotOf[node];
+        return Vector3<T>(wtx[s], wty[s], wtz[s]);
+    }
+
+    inline T getWorldScale(TransformNode node) const
+    {
+        return ws[slotOf[node]];
+    }
+
+    // top three rows of the row-major 4x4 world matrix (see transformAffineBatch)
+    inline void getWorldMatrix(TransformNode node, T m[12]) const
+    {
+        uint32_t s = slotOf[node];
+        T r[9];
+        getWorldRotation(node).getMatrix(r);
+        for(int i = 0; i < 3; ++i)
+        {
+            m[4*i] = r[3*i]*ws[s];
+            m[4*i + 1] = r[3*i + 1]*ws[s];
+            m[4*i + 2] = r[3*i + 2]*ws[s];
+        }
+        m[3] = wtx[s];
+        m[7] = wty[s];
+        m[11] = wtz[s];
+    }
+
+private:
+    inline void touch(TransformNode node)
+    {
+        if(!layoutDirty)
+            dirty.push_back(node);
+    }
+
+    // sorts the nodes by depth, then parent slot, then handle
+    inline void rebuildLayout()
+    {
+        size_t n = parents.size();
+        std::vector<uint32_t> depth(n, 0);
+        uint32_t maxDepth = 0;
+        for(size_t i = 0; i < n; ++i)
+        {
+            // a parent always has a smaller handle than its children
+            depth[i] = parents[i] == TRANSFORM_NONE ? 0 : depth[parents[i]] + 1;
+            maxDepth = std::max(maxDepth, depth[i]);
+        }
+
+        levelStart.assign(n ? maxDepth + 2 : 1, 0);
+        slotOf.assign(n, 0);
+        nodeOf.assign(n, 0);
+        parentSlot.assign(n, TRANSFORM_NONE);
+        childBegin.assign(n, 0);
+        childEnd.assign(n, 0);
+
+        // counting sort by depth keeps handle order within a level; each level
+        // below the roots is then ordered by its parents' slots
+        for(size_t i = 0; i < n; ++i)
+            ++levelStart[depth[i] + 1];
+        for(size_t l = 1; l < levelStart.size(); ++l)
+            levelStart[l] += levelStart[l - 1];
+        std::vector<uint32_t> byDepth(n);
+        std::vector<uint32_t> fill(levelStart.begin(), levelStart.end() - 1);
+        for(size_t i = 0; i < n; ++i)
+            byDepth[fill[depth[i]]++] = uint32_t(i);
+
+        for(size_t l = 0; l + 1 < levelStart.size(); ++l)
+        {
+            std::vector<uint32_t>::iterator first = byDepth.begin() + levelStart[l];
+            std::vector<uint32_t>::iterator last = byDepth.begin() + levelStart[l + 1];
+            if(l > 0)
+                std::stable_sort(first, last, [this](uint32_t a, uint32_t b)
+                {
+                    return slotOf[parents[a]] < slotOf[parents[b]];
+                });
+            for(uint32_t slot = levelStart[l]; slot < levelStart[l + 1]; ++slot)
+            {
+                uint32_t node = byDepth[slot];
+                slotOf[node] = slot;
+                nodeOf[slot] = node;
+                if(l == 0)
+                    continue;
+                uint32_t ps = slotOf[parents[node]];
+                parentSlot[slot] = ps;
+                if(childEnd[ps] == 0)
+                    childBegin[ps] = slot;
+                childEnd[ps] = slot + 1;
+            }
+        }
+
+        wqx.resize(n); wqy.resize(n); wqz.resize(n); wqw.resize(n);
+        wtx.resize(n); wty.resize(n); wtz.resize(n);
+        ws.resize(n);
+        stamp.assign(n, 0);
+        epoch = 0;
+        layoutDirty = false;
+    }
+
+    // recomposes the world transforms of the m slots in list, all on one level
+    inline void compose(const uint32_t* list, size_t m, TaskScheduler& scheduler)
+    {
+        if(m < PARALLEL_MIN)
+            composeRange(list, m);
+        else
+            parallelFor(m, PARALLEL_MIN/2, [this, list](size_t begin, size_t end)
+            {
+                composeRange(list + begin, end - begin);
+            }, scheduler);
+    }
+
+    inline void composeRange(const uint32_t* list, size_t m)
+    {
+        typedef Pack<T> P;
+        typedef ScalarPack<T> S;
+        // 0-7 parent rotation, translation, scale; 8-15 local; 16-23 world
+        T stage[24][BLOCK];
+        for(size_t begin = 0; begin < m; begin += BLOCK)
+        {
+            size_t b = m - begin < BLOCK ? m - begin : size_t(BLOCK);
+            for(size_t j = 0; j < b; ++j)
+            {
+                uint32_t s = list[begin + j];
+                uint32_t p = parentSlot[s];
+                uint32_t node = nodeOf[s];
+                if(p == TRANSFORM_NONE)
+                {
+                    stage[0][j] = stage[1][j] = stage[2][j] = T(0);
+                    stage[3][j] = T(1);
+                    stage[4][j] = stage[5][j] = stage[6][j] = T(0);
+                    stage[7][j] = T(1);
+                }
+                else
+                {
+                    stage[0][j] = wqx[p]; stage[1][j] = wqy[p]; stage[2][j] = wqz[p]; stage[3][j] = wqw[p];
+                    stage[4][j] = wtx[p]; stage[5][j] = wty[p]; stage[6][j] = wtz[p]; stage[7][j] = ws[p];
+                }
+                stage[8][j] = lqx[node]; stage[9][j] = lqy[node]; stage[10][j] = lqz[node]; stage[11][j] = lqw[node];
+                stage[12][j] = ltx[node]; stage[13][j] = lty[node]; stage[14][j] = ltz[node]; stage[15][j] = ls[node];
+            }
+
+            size_t i = 0;
+            for(; i + P::width <= b; i += P::width)
+                composeStep<P>(stage, i);
+            for(; i < b; ++i)
+                composeStep<S>(stage, i);
+
+            for(size_t j = 0; j < b; ++j)
+            {
+                uint32_t s = list[begin + j];
+                wqx[s] = stage[16][j]; wqy[s] = stage[17][j]; wqz[s] = stage[18][j]; wqw[s] = stage[19][j];
+                wtx[s] = stage[20][j]; wty[s] = stage[21][j]; wtz[s] = stage[22][j]; ws[s] = stage[23][j];
+            }
+        }
+    }
+
+    template <class P>
+    static inline void composeStep(T (*stage)[BLOCK], size_t i)
+    {
+        P px = P::load(stage[0] + i), py = P::load(stage[1] + i), pz = P::load(stage[2] + i), pw = P::load(stage[3] + i);
+        P tx = P::load(stage[4] + i), ty = P::load(stage[5] + i), tz = P::load(stage[6] + i), sp = P::load(stage[7] + i);
+        P lx = P::load(stage[8] + i), ly = P::load(stage[9] + i), lz = P::load(stage[10] + i), lw = P::load(stage[11] + i);
+        P ux = P::load(stage[12] + i), uy = P::load(stage[13] + i), uz = P::load(stage[14] + i), sl = P::load(stage[15] + i);
+
+        // Hamilton product parent * local, as in Quat::mult
+        fmadd(pw, lx, fmadd(px, lw, fmsub(py, lz, pz*ly))).store(stage[16] + i);
+        fmadd(pw, ly, fmadd(py, lw, fmsub(pz, lx, px*lz))).store(stage[17] + i);
+        fmadd(pw, lz, fmadd(pz, lw, fmsub(px, ly, py*lx))).store(stage[18] + i);
+        fmsub(pw, lw, fmadd(px, lx, fmadd(py, ly, pz*lz))).store(stage[19] + i);
+
+        // parent rotation applied to the local translation: u + 2 p x (p x u + w u)
+        P cx = fmadd(pw, ux, fmsub(py, uz, pz*uy));
+        P cy = fmadd(pw, uy, fmsub(pz, ux, px*uz));
+        P cz = fmadd(pw, uz, fmsub(px, uy, py*ux));
+        P two(2);
+        P rx = fmadd(two, fmsub(py, cz, pz*cy), ux);
+        P ry = fmadd(two, fmsub(pz, cx, px*cz), uy);
+        P rz = fmadd(two, fmsub(px, cy, py*cx), uz);
+        fmadd(sp, rx, tx).store(stage[20] + i);
+        fmadd(sp, ry, ty).store(stage[21] + i);
+        fmadd(sp, rz, tz).store(stage[22] + i);
+        (sp*sl).store(stage[23] + i);
+    }
+};
+
+#endif	/* TRANSFORMHIERARCHY_H */
@@ -0,0 +1,235 @@
+#ifndef INSTRUMENT_H
+#define	INSTRUMENT_H
+
+// opt-in instrumentation of the vector hot paths
+//
+// build with -DVECTOR_INSTRUMENT to count constructions, copies and calls of
+// the instrumented operations; add -DVECTOR_INSTRUMENT_TIMERS to also time
+// them with scoped steady_clock timers (which cost far more than the
+// operations themselves, so compare timed builds only with each other)
+//
+// counters live in a thread-local block that only its own thread writes, so
+// counting is a plain increment with no locking or shared cache line; blocks
+// of exiting threads are folded into a process total. at exit the totals are
+// written as JSON to the file named by VECTOR_INSTRUMENT_FILE, or to stderr
+//
+// without VECTOR_INSTRUMENT the macros expand to nothing, Vector3 keeps its
+// trivial copies and nothing here is compiled, so the cost is zero. with it,
+// instrumented constructors are no longer usable in constant expressions
+
+#ifdef VECTOR_INSTRUMENT
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+enum InstrumentCounter
+{
+    INSTRUMENT_CONSTRUCT,
+    INSTRUMENT_COPY,
+    INSTRUMENT_DOT,
+    INSTRUMENT_CROSS,
+    INSTRUMENT_MAG,
+    INSTRUMENT_NORMALIZE,
+    INSTRUMENT_ROTATE,
+    INSTRUMENT_QUAT_MULT,
+    INSTRUMENT_QUAT_SLERP,
+    INSTRUMENT_QUAT_NLERP,
+    INSTRUMENT_COUNTERS
+};
+
+inline const char* instrumentName(int counter)
+{
+    static const char* const names[INSTRUMENT_COUNTERS] =
+    {
+        "construct", "copy", "dot", "cross", "mag", "normalize", "rotate",
+        "quat_mult", "quat_slerp", "quat_nlerp"
+    };
+    return names[counter];
+}
+
+// one thread's counts; written only by that thread, read by the dump
+struct InstrumentBlock
+{
+    std::atomic<uint64_t> calls[INSTRUMENT_COUNTERS];
+    std::atomic<uint64_t> timedCalls[INSTRUMENT_COUNTERS];
+    std::atomic<uint64_t> nanos[INSTRUMENT_COUNTERS];
+
+    InstrumentBlock()
+    {
+        for(int c = 0; c < INSTRUMENT_COUNTERS; ++c)
+        {
+            calls[c].store(0, std::memory_order_relaxed);
+            timedCalls[c].store(0, std::memory_order_relaxed);
+            nanos[c].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // single-writer increment: a plain add, not a locked read-modify-write
+    static inline void add(std::atomic<uint64_t>& v, uint64_t n)
+    {
+        v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+// process-wide registry of the thread blocks; never destroyed, so threads
+// that outlive static destruction (scheduler workers) can still retire
+class Instrument
+{
+private:
+    std::mutex lock;
+    std::vector<const InstrumentBlock*> live;
+    uint64_t retired[3][INSTRUMENT_COUNTERS];
+    size_t threads;
+
+    Instrument():
+    threads(0)
+    {
+        for(int c = 0; c < INSTRUMENT_COUNTERS; ++c)
+            retired[0][c] = retired[1][c] = retired[2][c] = 0;
+        std::atexit(dumpAtExit);
+    }
+
+    static void dumpAtExit()
+    {
+        const char* path = std::getenv("VECTOR_INSTRUMENT_FILE");
+        FILE* out = path ? std::fopen(path, "w") : 0;
+        instance().dump(out ? out : stderr);
+        if(out)
+            std::fclose(out);
+    }
+
+public:
+    static inline Instrument& instance()
+    {
+        static Instrument* registry = new Instrument();
+        return *registry;
+    }
+
+    inline void attach(const InstrumentBlock* block)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        live.push_back(block);
+        ++threads;
+    }
+
+    // folds an exiting thread's counts into the totals
+    inline void retire(const InstrumentBlock* block)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        fold(*block, retired);
+        for(size_t i = 0; i < live.size(); ++i)
+            if(live[i] == block)
+            {
+                live[i] = live.back();
+                live.pop_back();
+                break;
+            }
+    }
+
+    // writes the totals over every thread seen so far as JSON
+    inline void dump(FILE* out)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        uint64_t total[3][INSTRUMENT_COUNTERS];
+        for(int c = 0; c < INSTRUMENT_COUNTERS; ++c)
+        {
+            total[0][c] = retired[0][c];
+            total[1][c] = retired[1][c];
+            total[2][c] = retired[2][c];
+        }
+        for(size_t i = 0; i < live.size(); ++i)
+            fold(*live[i], total);
+
+        std::fprintf(out, "{\n  \"threads\": %zu,\n  \"counters\": {\n", threads);
+        for(int c = 0; c < INSTRUMENT_COUNTERS; ++c)
+            std::fprintf(out, "    \"%s\": { \"calls\": %llu, \"timed_calls\": %llu, \"total_ns\": %llu }%s\n",
+                         instrumentName(c), (unsigned long long)total[0][c],
+                         (unsigned long long)total[1][c], (unsigned long long)total[2][c],
+                         c + 1 < INSTRUMENT_COUNTERS ? "," : "");
+        std::fprintf(out, "  }\n}\n");
+        std::fflush(out);
+    }
+
+private:
+    static inline void fold(const InstrumentBlock& b, uint64_t (&to)[3][INSTRUMENT_COUNTERS])
+    {
+        for(int c = 0; c < INSTRUMENT_COUNTERS; ++c)
+        {
+            to[0][c] += b.calls[c].load(std::memory_order_relaxed);
+            to[1][c] += b.timedCalls[c].load(std::memory_order_relaxed);
+            to[2][c] += b.nanos[c].load(std::memory_order_relaxed);
+        }
+    }
+};
+
+// the calling thread's block, registered on first use and retired at thread exit
+struct InstrumentThread
+{
+    InstrumentBlock block;
+
+    InstrumentThread()
+    {
+        Instrument::instance().attach(&block);
+    }
+
+    ~InstrumentThread()
+    {
+        Instrument::instance().retire(&block);
+    }
+};
+
+inline InstrumentBlock& instrumentLocal()
+{
+    thread_local InstrumentThread t;
+    return t.block;
+}
+
+inline void instrumentCount(InstrumentCounter c)
+{
+    InstrumentBlock::add(instrumentLocal().calls[c], 1);
+}
+
+// times its scope into counter c
+class InstrumentTimer
+{
+private:
+    InstrumentCounter counter;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit InstrumentTimer(InstrumentCounter c):
+    counter(c), start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~InstrumentTimer()
+    {
+        uint64_t ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now() - start).count());
+        InstrumentBlock& b = instrumentLocal();
+        InstrumentBlock::add(b.timedCalls[counter], 1);
+        InstrumentBlock::add(b.nanos[counter], ns);
+    }
+};
+
+#define VECTOR_COUNT(counter) instrumentCount(INSTRUMENT_##counter)
+
+#ifdef VECTOR_INSTRUMENT_TIMERS
+#define VECTOR_TIME(counter) InstrumentTimer vectorInstrumentTimer(INSTRUMENT_##counter)
+#else
+#define VECTOR_TIME(counter) ((void)0)
+#endif
+
+#else
+
+#define VECTOR_COUNT(counter) ((void)0)
+#define VECTOR_TIME(counter) ((void)0)
+
+#endif	/* VECTOR_INSTRUMENT */
+
+#endif	/* INSTRUMENT_H */
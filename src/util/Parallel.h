@@ -0,0 +1,181 @@
+#ifndef PARALLEL_H
+#define	PARALLEL_H
+
+#include "TaskScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// data-parallel loops on top of TaskScheduler
+// a range of n elements is cut into fixed chunks of grain elements (the last
+// one may be shorter); the chunks are handed out by recursive halving, so idle
+// threads steal large pieces first. chunk boundaries depend only on n and
+// grain, never on the thread count, which is what makes parallelReduce
+// deterministic: every chunk is reduced alone and the partial results are
+// combined in chunk order
+//
+// the default grain keeps a chunk of input within PARALLEL_CHUNK_BYTES, so each
+// task streams through a cache-sized piece of the buffer
+
+const size_t PARALLEL_CHUNK_BYTES = 64 << 10;
+
+// default chunk length for buffers of T
+template <class T>
+inline size_t parallelGrain()
+{
+    return sizeof(T) >= PARALLEL_CHUNK_BYTES ? 1 : PARALLEL_CHUNK_BYTES / sizeof(T);
+}
+
+/*****************************************************/
+/*                   Parallel For                    */
+/*****************************************************/
+// calls body(begin, end) once per chunk of [0, n), in parallel; body must not
+// throw and must be safe to run concurrently on disjoint ranges
+template <class Body>
+inline void parallelFor(size_t n, size_t grain, const Body& body,
+                        TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    if(grain == 0)
+        grain = 1;
+    size_t chunks = (n + grain - 1) / grain;
+    if(chunks <= 1 || scheduler.size() <= 1)
+    {
+        for(size_t c = 0; c < chunks; ++c)
+            body(c*grain, c + 1 == chunks ? n : (c + 1)*grain);
+        return;
+    }
+
+    std::atomic<size_t> pending(0);
+    // runs chunks [c0, c1): spawns the upper halves and keeps the lowest chunk
+    std::function<void(size_t, size_t)> split = [&](size_t c0, size_t c1)
+    {
+        while(c1 - c0 > 1)
+        {
+            size_t mid = c0 + (c1 - c0)/2;
+            pending.fetch_add(1, std::memory_order_relaxed);
+            scheduler.spawn([&split, &pending, mid, c1]()
+            {
+                split(mid, c1);
+                pending.fetch_sub(1, std::memory_order_release);
+            });
+            c1 = mid;
+        }
+        body(c0*grain, c0 + 1 == chunks ? n : (c0 + 1)*grain);
+    };
+    split(0, chunks);
+    scheduler.wait(pending);
+}
+
+/*****************************************************/
+/*                Parallel Transform                 */
+/*****************************************************/
+// out[i] = op(in[i]) for i in [0, n); out may be in
+template <class In, class Out, class Op>
+inline void parallelTransform(const In* in, Out* out, size_t n, const Op& op,
+                              size_t grain = parallelGrain<In>(),
+                              TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    parallelFor(n, grain, [in, out, &op](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; ++i)
+            out[i] = op(in[i]);
+    }, scheduler);
+}
+
+// in-place variant: op(v[i]) modifies each element
+template <class T, class Op>
+inline void parallelTransform(T* v, size_t n, const Op& op,
+                              size_t grain = parallelGrain<T>(),
+                              TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    parallelFor(n, grain, [v, &op](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; ++i)
+            op(v[i]);
+    }, scheduler);
+}
+
+/*****************************************************/
+/*                 Parallel Reduce                   */
+/*****************************************************/
+// returns combine(...combine(combine(identity, map(chunk 0)), map(chunk 1))...)
+// where map(begin, end) reduces one chunk; the order of operations is fixed
+// by n and grain alone, so floating point results are bit-identical for any
+// thread count (but depend on grain)
+template <class R, class Map, class Combine>
+inline R parallelReduce(size_t n, size_t grain, const R& identity,
+                        const Map& map, const Combine& combine,
+                        TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    if(grain == 0)
+        grain = 1;
+    size_t chunks = (n + grain - 1) / grain;
+    std::vector<R> partial(chunks, identity);
+    parallelFor(n, grain, [&partial, &map, grain](size_t begin, size_t end)
+    {
+        partial[begin / grain] = map(begin, end);
+    }, scheduler);
+
+    R result = identity;
+    for(size_t c = 0; c < chunks; ++c)
+        result = combine(result, partial[c]);
+    return result;
+}
+
+/*****************************************************/
+/*                 Parallel Gather                   */
+/*****************************************************/
+// collects a variable number of items for each of m queries into one flat
+// list: query(i, scratch, out) appends the items of query i to out, and they
+// end up in items[offsets[i], offsets[i + 1]), in query order. each chunk of
+// grain queries fills its own list with a Scratch of its own (reused across
+// its queries), then the counts are prefix-summed and the lists copied into
+// place, so the output does not depend on the thread count
+template <class Scratch, class V, class Query>
+inline void parallelGather(size_t m, size_t grain, std::vector<V>& items, std::vector<size_t>& offsets,
+                           const Query& query, TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    if(grain == 0)
+        grain = 1;
+    size_t chunks = (m + grain - 1) / grain;
+    std::vector<std::vector<V> > found(chunks);
+    offsets.assign(m + 1, 0);
+    parallelFor(m, grain, [&](size_t begin, size_t end)
+    {
+        Scratch scratch;
+        std::vector<V>& out = found[begin / grain];
+        for(size_t i = begin; i < end; ++i)
+        {
+            size_t before = out.size();
+            query(i, scratch, out);
+            offsets[i + 1] = out.size() - before;
+        }
+    }, scheduler);
+
+    for(size_t i = 0; i < m; ++i)
+        offsets[i + 1] += offsets[i];
+    items.resize(offsets[m]);
+    parallelFor(chunks, 1, [&](size_t begin, size_t end)
+    {
+        for(size_t c = begin; c < end; ++c)
+            std::copy(found[c].begin(), found[c].end(), items.begin() + offsets[c*grain]);
+    }, scheduler);
+}
+
+// the same for queries that need no scratch: query(i, out)
+struct NoGatherScratch {};
+
+template <class V, class Query>
+inline void parallelGather(size_t m, size_t grain, std::vector<V>& items, std::vector<size_t>& offsets,
+                           const Query& query, TaskScheduler& scheduler = TaskScheduler::instance())
+{
+    parallelGather<NoGatherScratch>(m, grain, items, offsets,
+                                    [&query](size_t i, NoGatherScratch&, std::vector<V>& out)
+                                    {
+                                        query(i, out);
+                                    }, scheduler);
+}
+
+#endif	/* PARALLEL_H */
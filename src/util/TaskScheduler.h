@@ -0,0 +1,189 @@
+#ifndef TASKSCHEDULER_H
+#define	TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// small work-stealing task scheduler
+// every worker owns a deque: it pushes and pops its own tasks at the back
+// (newest first, which keeps recursive splits cache-warm) and steals from
+// the front of the other deques when it runs dry. threads outside the pool
+// share one extra deque, and a thread waiting on tasks runs queued work
+// instead of blocking, so nested parallel calls cannot deadlock
+//
+// tasks must not throw
+class TaskScheduler
+{
+public:
+    typedef std::function<void()> Task;
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued;
+    std::atomic<bool> stopping;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+
+public:
+    /*****************************************************/
+    /*                  Constructors                     */
+    /*****************************************************/
+    // starts threads - 1 workers (the calling thread is the last one); 0 picks
+    // one thread per hardware thread
+    explicit TaskScheduler(unsigned threads = 0):
+    queued(0), stopping(false)
+    {
+        if(threads == 0)
+            threads = std::thread::hardware_concurrency();
+        if(threads == 0)
+            threads = 1;
+
+        // one deque per worker plus one shared by outside threads
+        for(unsigned i = 0; i < threads; ++i)
+            queues.push_back(std::unique_ptr<Queue>(new Queue()));
+        for(unsigned i = 0; i + 1 < threads; ++i)
+            workers.push_back(std::thread(&TaskScheduler::workerLoop, this, i));
+    }
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    // finishes the queued tasks and joins the workers
+    ~TaskScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lk(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for(size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+    }
+
+    // process-wide scheduler with one thread per hardware thread
+    static inline TaskScheduler& instance()
+    {
+        static TaskScheduler scheduler;
+        return scheduler;
+    }
+
+    /*****************************************************/
+    /*                 Member Functions                  */
+    /*****************************************************/
+    // number of threads that run tasks, counting the thread that waits
+    inline size_t size() const
+    {
+        return queues.size();
+    }
+
+    // queues a task on the calling worker's deque (or the shared one)
+    inline void spawn(Task task)
+    {
+        Queue& q = *queues[self()];
+        {
+            std::lock_guard<std::mutex> lk(q.lock);
+            q.tasks.push_back(std::move(task));
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        // taking sleepLock orders this push against a worker about to sleep
+        {
+            std::lock_guard<std::mutex> lk(sleepLock);
+        }
+        wake.notify_one();
+    }
+
+    // runs queued tasks on the calling thread until pending reaches zero
+    inline void wait(const std::atomic<size_t>& pending)
+    {
+        size_t me = self();
+        while(pending.load(std::memory_order_acquire) != 0)
+        {
+            if(!runOne(me))
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    // index of the calling thread's deque in this scheduler
+    inline size_t self() const
+    {
+        const Worker& w = current();
+        return w.scheduler == this ? w.index : queues.size() - 1;
+    }
+
+    struct Worker
+    {
+        const TaskScheduler* scheduler;
+        size_t index;
+    };
+
+    static inline Worker& current()
+    {
+        static thread_local Worker w = { 0, 0 };
+        return w;
+    }
+
+    // pops the newest local task, or steals the oldest task of another deque
+    inline bool runOne(size_t me)
+    {
+        Task task;
+        size_t n = queues.size();
+        for(size_t k = 0; k < n && !task; ++k)
+        {
+            Queue& q = *queues[(me + k) % n];
+            std::lock_guard<std::mutex> lk(q.lock);
+            if(q.tasks.empty())
+                continue;
+            if(k == 0)
+            {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+        }
+        if(!task)
+            return false;
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        task();
+        return true;
+    }
+
+    inline void workerLoop(size_t index)
+    {
+        Worker& w = current();
+        w.scheduler = this;
+        w.index = index;
+        for(;;)
+        {
+            if(runOne(index))
+                continue;
+            std::unique_lock<std::mutex> lk(sleepLock);
+            wake.wait(lk, [this]()
+            {
+                return stopping || queued.load(std::memory_order_acquire) != 0;
+            });
+            if(stopping && queued.load(std::memory_order_acquire) == 0)
+                return;
+        }
+    }
+};
+
+#endif	/* TASKSCHEDULER_H */